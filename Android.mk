@@ -33,6 +33,7 @@ LOCAL_SRC_FILES := \
     twrpTar.cpp \
 	twrpDU.cpp \
     twrpDigest.cpp \
+    twrpProgress.cpp \
     find_file.cpp
 
 LOCAL_SRC_FILES += \
@@ -42,7 +43,8 @@ LOCAL_SRC_FILES += \
     twinstall.cpp \
     twrp-functions.cpp \
     openrecoveryscript.cpp \
-    tarWrite.c
+    tarWrite.c \
+    twtrace.c
 
 ifeq ($(BUILD_SAFESTRAP), true)
 LOCAL_SRC_FILES += \
@@ -71,6 +71,7 @@ map<string, DataManager::TStrIntPair>   DataManager::mValues;
 map<string, string>                     DataManager::mConstValues;
 string                                  DataManager::mBackingFile;
 int                                     DataManager::mInitialized = 0;
+pthread_rwlock_t                        DataManager::mLock = PTHREAD_RWLOCK_INITIALIZER;
 #ifndef TW_NO_SCREEN_TIMEOUT
 extern blanktimer blankTimer;
 #endif
@@ -98,7 +99,7 @@ void DataManager::sanitize_device_id(char* device_id) {
 #define CPUINFO_HARDWARE		"Hardware"
 #define CPUINFO_HARDWARE_LEN	(strlen(CPUINFO_HARDWARE))
 
-void DataManager::get_device_id(void) {
+string DataManager::get_device_id(void) {
 	FILE *fp;
 	char line[2048];
 	char hardware_id[32], device_id[64];
@@ -124,9 +125,8 @@ void DataManager::get_device_id(void) {
 			strcat(device_id, hardware_id);
 		}
 		sanitize_device_id((char *)device_id);
-		mConstValues.insert(make_pair("device_id", device_id));
 		LOGINFO("=> using device id: '%s'\n", device_id);
-		return;
+		return device_id;
 	}
 #endif
 
@@ -151,8 +151,7 @@ void DataManager::get_device_id(void) {
 				// We found the serial number!
 				strcpy(device_id, token + CMDLINE_SERIALNO_LEN);
 				sanitize_device_id((char *)device_id);
-				mConstValues.insert(make_pair("device_id", device_id));
-				return;
+				return device_id;
 			}
 			token = strtok(NULL, " ");
 		}
@@ -179,8 +178,7 @@ void DataManager::get_device_id(void) {
 					LOGINFO("=> serial from cpuinfo: '%s'\n", device_id);
 					fclose(fp);
 					sanitize_device_id((char *)device_id);
-					mConstValues.insert(make_pair("device_id", device_id));
-					return;
+					return device_id;
 				}
 			} else if (memcmp(line, CPUINFO_HARDWARE, CPUINFO_HARDWARE_LEN) == 0) {// We're also going to look for the hardware line in cpuinfo and save it for later in case we don't find the device ID
 				// We found the hardware ID
@@ -205,21 +203,17 @@ void DataManager::get_device_id(void) {
 		LOGINFO("\nusing hardware id for device id: '%s'\n", hardware_id);
 		strcpy(device_id, hardware_id);
 		sanitize_device_id((char *)device_id);
-		mConstValues.insert(make_pair("device_id", device_id));
-		return;
+		return device_id;
 	}
 
 	strcpy(device_id, "serialno");
 	LOGERR("=> device id not found, using '%s'.", device_id);
-	mConstValues.insert(make_pair("device_id", device_id));
-	return;
+	return device_id;
 }
 
 int DataManager::ResetDefaults()
 {
-	mValues.clear();
-	mConstValues.clear();
-	SetDefaultValues();
+	Set_Default_Values(true);
 	return 0;
 }
 
@@ -266,6 +260,7 @@ int DataManager::LoadValues(const string filename)
 
 		map<string, TStrIntPair>::iterator pos;
 
+		pthread_rwlock_wrlock(&mLock);
 		pos = mValues.find(Name);
 		if (pos != mValues.end())
 		{
@@ -274,6 +269,7 @@ int DataManager::LoadValues(const string filename)
 		}
 		else
 			mValues.insert(TNameValuePair(Name, TStrIntPair(Value, 1)));
+		pthread_rwlock_unlock(&mLock);
 #ifndef TW_NO_SCREEN_TIMEOUT
 		if (Name == "tw_screen_timeout_secs")
 			blankTimer.setTime(atoi(Value.c_str()));
@@ -315,6 +311,7 @@ int DataManager::SaveValues()
 	int file_version = FILE_VERSION;
 	fwrite(&file_version, 1, sizeof(int), out);
 
+	pthread_rwlock_rdlock(&mLock);
 	map<string, TStrIntPair>::iterator iter;
 	for (iter = mValues.begin(); iter != mValues.end(); ++iter)
 	{
@@ -329,47 +326,50 @@ int DataManager::SaveValues()
 			fwrite(iter->second.first.c_str(), 1, length, out);
 		}
 	}
+	pthread_rwlock_unlock(&mLock);
 	fclose(out);
 #endif // ifdef TW_OEM_BUILD
 	return 0;
 }
 
-int DataManager::GetValue(const string varName, string& value)
+int DataManager::GetValue(const string& varName, string& value)
 {
-	string localStr = varName;
-
 	if (!mInitialized)
 		SetDefaultValues();
 
 	// Strip off leading and trailing '%' if provided
-	if (localStr.length() > 2 && localStr[0] == '%' && localStr[localStr.length()-1] == '%')
+	string stripped;
+	const string* localStr = &varName;
+	if (varName.length() > 2 && varName[0] == '%' && varName[varName.length()-1] == '%')
 	{
-		localStr.erase(0, 1);
-		localStr.erase(localStr.length() - 1, 1);
+		stripped = varName.substr(1, varName.length() - 2);
+		localStr = &stripped;
 	}
 
 	// Handle magic values
-	if (GetMagicValue(localStr, value) == 0)
+	if (GetMagicValue(*localStr, value) == 0)
 		return 0;
 
+	int ret = 0;
+	pthread_rwlock_rdlock(&mLock);
 	map<string, string>::iterator constPos;
-	constPos = mConstValues.find(localStr);
+	constPos = mConstValues.find(*localStr);
 	if (constPos != mConstValues.end())
-	{
 		value = constPos->second;
-		return 0;
+	else
+	{
+		map<string, TStrIntPair>::iterator pos;
+		pos = mValues.find(*localStr);
+		if (pos == mValues.end())
+			ret = -1;
+		else
+			value = pos->second.first;
 	}
-
-	map<string, TStrIntPair>::iterator pos;
-	pos = mValues.find(localStr);
-	if (pos == mValues.end())
-		return -1;
-
-	value = pos->second.first;
-	return 0;
+	pthread_rwlock_unlock(&mLock);
+	return ret;
 }
 
-int DataManager::GetValue(const string varName, int& value)
+int DataManager::GetValue(const string& varName, int& value)
 {
 	string data;
 
@@ -380,7 +380,7 @@ int DataManager::GetValue(const string varName, int& value)
 	return 0;
 }
 
-int DataManager::GetValue(const string varName, float& value)
+int DataManager::GetValue(const string& varName, float& value)
 {
 	string data;
 
@@ -391,7 +391,7 @@ int DataManager::GetValue(const string varName, float& value)
 	return 0;
 }
 
-unsigned long long DataManager::GetValue(const string varName, unsigned long long& value)
+unsigned long long DataManager::GetValue(const string& varName, unsigned long long& value)
 {
 	string data;
 
@@ -403,26 +403,31 @@ unsigned long long DataManager::GetValue(const string varName, unsigned long lon
 }
 
 // This is a dangerous function. It will create the value if it doesn't exist so it has a valid c_str
-string& DataManager::GetValueRef(const string varName)
+string& DataManager::GetValueRef(const string& varName)
 {
 	if (!mInitialized)
 		SetDefaultValues();
 
+	pthread_rwlock_wrlock(&mLock);
 	map<string, string>::iterator constPos;
 	constPos = mConstValues.find(varName);
 	if (constPos != mConstValues.end())
+	{
+		pthread_rwlock_unlock(&mLock);
 		return constPos->second;
+	}
 
 	map<string, TStrIntPair>::iterator pos;
 	pos = mValues.find(varName);
 	if (pos == mValues.end())
 		pos = (mValues.insert(TNameValuePair(varName, TStrIntPair("", 0)))).first;
+	pthread_rwlock_unlock(&mLock);
 
 	return pos->second.first;
 }
 
 // This function will return an empty string if the value doesn't exist
-string DataManager::GetStrValue(const string varName)
+string DataManager::GetStrValue(const string& varName)
 {
 	string retVal;
 
@@ -431,7 +436,7 @@ string DataManager::GetStrValue(const string varName)
 }
 
 // This function will return 0 if the value doesn't exist
-int DataManager::GetIntValue(const string varName)
+int DataManager::GetIntValue(const string& varName)
 {
 	string retVal;
 
@@ -439,7 +444,7 @@ int DataManager::GetIntValue(const string varName)
 	return atoi(retVal.c_str());
 }
 
-int DataManager::SetValue(const string varName, string value, int persist /* = 0 */)
+int DataManager::SetValue(const string& varName, const string& value, int persist /* = 0 */)
 {
 	if (!mInitialized)
 		SetDefaultValues();
@@ -448,10 +453,14 @@ int DataManager::SetValue(const string varName, string value, int persist /* = 0
 	if (varName.empty() || (varName[0] >= '0' && varName[0] <= '9'))
 		return -1;
 
+	pthread_rwlock_wrlock(&mLock);
 	map<string, string>::iterator constChk;
 	constChk = mConstValues.find(varName);
 	if (constChk != mConstValues.end())
+	{
+		pthread_rwlock_unlock(&mLock);
 		return -1;
+	}
 
 	map<string, TStrIntPair>::iterator pos;
 	pos = mValues.find(varName);
@@ -459,8 +468,10 @@ int DataManager::SetValue(const string varName, string value, int persist /* = 0
 		pos = (mValues.insert(TNameValuePair(varName, TStrIntPair(value, persist)))).first;
 	else
 		pos->second.first = value;
+	int persisted = pos->second.second;
+	pthread_rwlock_unlock(&mLock);
 
-	if (pos->second.second != 0)
+	if (persisted != 0)
 		SaveValues();
 
 #ifndef TW_NO_SCREEN_TIMEOUT
@@ -480,10 +491,10 @@ int DataManager::SetValue(const string varName, string value, int persist /* = 0
 	return 0;
 }
 
-int DataManager::SetValue(const string varName, int value, int persist /* = 0 */)
+int DataManager::SetValue(const string& varName, int value, int persist /* = 0 */)
 {
-	ostringstream valStr;
-	valStr << value;
+	char valStr[16];
+	snprintf(valStr, sizeof(valStr), "%d", value);
 	if (varName == "tw_use_external_storage") {
 		string str;
 
@@ -500,21 +511,21 @@ int DataManager::SetValue(const string varName, int value, int persist /* = 0 */
 
 		SetValue("tw_storage_path", str);
 	}
-	return SetValue(varName, valStr.str(), persist);
+	return SetValue(varName, valStr, persist);
 }
 
-int DataManager::SetValue(const string varName, float value, int persist /* = 0 */)
+int DataManager::SetValue(const string& varName, float value, int persist /* = 0 */)
 {
 	ostringstream valStr;
 	valStr << value;
 	return SetValue(varName, valStr.str(), persist);;
 }
 
-int DataManager::SetValue(const string varName, unsigned long long value, int persist /* = 0 */)
+int DataManager::SetValue(const string& varName, unsigned long long value, int persist /* = 0 */)
 {
-	ostringstream valStr;
-	valStr << value;
-	return SetValue(varName, valStr.str(), persist);
+	char valStr[32];
+	snprintf(valStr, sizeof(valStr), "%llu", value);
+	return SetValue(varName, valStr, persist);
 }
 
 int DataManager::SetProgress(float Fraction) {
@@ -536,8 +547,10 @@ void DataManager::DumpValues()
 {
 	map<string, TStrIntPair>::iterator iter;
 	gui_print("Data Manager dump - Values with leading X are persisted.\n");
+	pthread_rwlock_rdlock(&mLock);
 	for (iter = mValues.begin(); iter != mValues.end(); ++iter)
 		gui_print("%c %s=%s\n", iter->second.second ? 'X' : ' ', iter->first.c_str(), iter->second.first.c_str());
+	pthread_rwlock_unlock(&mLock);
 }
 
 void DataManager::update_tz_environment_variables(void)
@@ -615,28 +628,59 @@ void DataManager::LoadBootslotVar(void) {
 }
 #endif
 
+void DataManager::Set_Default(map<string, TStrIntPair>& values, const string& varName, const string& value, int persist)
+{
+	map<string, TStrIntPair>::iterator pos = values.find(varName);
+
+	if (pos == values.end())
+		values.insert(TNameValuePair(varName, TStrIntPair(value, persist)));
+	else
+		pos->second.first = value;
+}
+
+string DataManager::Get_Default(map<string, TStrIntPair>& values, map<string, string>& constValues, const string& varName)
+{
+	map<string, string>::iterator constPos = constValues.find(varName);
+	if (constPos != constValues.end())
+		return constPos->second;
+
+	map<string, TStrIntPair>::iterator pos = values.find(varName);
+	if (pos != values.end())
+		return pos->second.first;
+	return "";
+}
+
 void DataManager::SetDefaultValues()
 {
+	Set_Default_Values(false);
+}
+
+// The defaults are collected in local maps and published under the lock in
+// one step, so that readers never see an empty or half-filled store
+void DataManager::Set_Default_Values(bool Reset)
+{
+	map<string, TStrIntPair> values;
+	map<string, string> constValues;
 #ifdef BUILD_SAFESTRAP
 	string datamedia_mount = EXPAND(TW_SS_DATAMEDIA_MOUNT);
 #endif
 	string str, path;
 
-	get_device_id();
+	constValues.insert(make_pair("device_id", get_device_id()));
 
 	mInitialized = 1;
 
-	mConstValues.insert(make_pair("true", "1"));
-	mConstValues.insert(make_pair("false", "0"));
+	constValues.insert(make_pair("true", "1"));
+	constValues.insert(make_pair("false", "0"));
 
-	mConstValues.insert(make_pair(TW_VERSION_VAR, TW_VERSION_STR));
-	mValues.insert(make_pair("tw_button_vibrate", make_pair("80", 1)));
-	mValues.insert(make_pair("tw_keyboard_vibrate", make_pair("40", 1)));
-	mValues.insert(make_pair("tw_action_vibrate", make_pair("160", 1)));
+	constValues.insert(make_pair(TW_VERSION_VAR, TW_VERSION_STR));
+	values.insert(make_pair("tw_button_vibrate", make_pair("80", 1)));
+	values.insert(make_pair("tw_keyboard_vibrate", make_pair("40", 1)));
+	values.insert(make_pair("tw_action_vibrate", make_pair("160", 1)));
 
 #ifdef BUILD_SAFESTRAP
 	// Safestrap
-	mConstValues.insert(make_pair(SS_VERSION_VAR, SS_VERSION_STR));
+	constValues.insert(make_pair(SS_VERSION_VAR, SS_VERSION_STR));
 	fprintf(stderr, "TW_SS_DEFAULT_VIRT_SYSTEM_SIZE == %s\n", DEFAULT_VIRT_SYSTEM_SIZE);
 	fprintf(stderr, "TW_SS_DEFAULT_VIRT_SYSTEM_MIN_SIZE == %s\n", DEFAULT_VIRT_SYSTEM_MIN_SIZE);
 	fprintf(stderr, "TW_SS_DEFAULT_VIRT_SYSTEM_MAX_SIZE == %s\n", DEFAULT_VIRT_SYSTEM_MAX_SIZE);
@@ -646,21 +690,21 @@ void DataManager::SetDefaultValues()
 	fprintf(stderr, "TW_SS_DEFAULT_VIRT_CACHE_SIZE == %s\n", DEFAULT_VIRT_CACHE_SIZE);
 	fprintf(stderr, "TW_SS_DEFAULT_VIRT_CACHE_MIN_SIZE == %s\n", DEFAULT_VIRT_CACHE_MIN_SIZE);
 	fprintf(stderr, "TW_SS_DEFAULT_VIRT_CACHE_MAX_SIZE == %s\n", DEFAULT_VIRT_CACHE_MAX_SIZE);
-	mConstValues.insert(make_pair(TW_SS_DEFAULT_VIRT_SYSTEM_SIZE, DEFAULT_VIRT_SYSTEM_SIZE));
-	mConstValues.insert(make_pair(TW_SS_DEFAULT_VIRT_SYSTEM_MIN_SIZE, DEFAULT_VIRT_SYSTEM_MIN_SIZE));
-	mConstValues.insert(make_pair(TW_SS_DEFAULT_VIRT_SYSTEM_MAX_SIZE, DEFAULT_VIRT_SYSTEM_MAX_SIZE));
-	mConstValues.insert(make_pair(TW_SS_DEFAULT_VIRT_DATA_SIZE, DEFAULT_VIRT_DATA_SIZE));
-	mConstValues.insert(make_pair(TW_SS_DEFAULT_VIRT_DATA_MIN_SIZE, DEFAULT_VIRT_DATA_MIN_SIZE));
-	mConstValues.insert(make_pair(TW_SS_DEFAULT_VIRT_DATA_MAX_SIZE, DEFAULT_VIRT_DATA_MAX_SIZE));
-	mConstValues.insert(make_pair(TW_SS_DEFAULT_VIRT_CACHE_SIZE, DEFAULT_VIRT_CACHE_SIZE));
-	mConstValues.insert(make_pair(TW_SS_DEFAULT_VIRT_CACHE_MIN_SIZE, DEFAULT_VIRT_CACHE_MIN_SIZE));
-	mConstValues.insert(make_pair(TW_SS_DEFAULT_VIRT_CACHE_MAX_SIZE, DEFAULT_VIRT_CACHE_MAX_SIZE));
+	constValues.insert(make_pair(TW_SS_DEFAULT_VIRT_SYSTEM_SIZE, DEFAULT_VIRT_SYSTEM_SIZE));
+	constValues.insert(make_pair(TW_SS_DEFAULT_VIRT_SYSTEM_MIN_SIZE, DEFAULT_VIRT_SYSTEM_MIN_SIZE));
+	constValues.insert(make_pair(TW_SS_DEFAULT_VIRT_SYSTEM_MAX_SIZE, DEFAULT_VIRT_SYSTEM_MAX_SIZE));
+	constValues.insert(make_pair(TW_SS_DEFAULT_VIRT_DATA_SIZE, DEFAULT_VIRT_DATA_SIZE));
+	constValues.insert(make_pair(TW_SS_DEFAULT_VIRT_DATA_MIN_SIZE, DEFAULT_VIRT_DATA_MIN_SIZE));
+	constValues.insert(make_pair(TW_SS_DEFAULT_VIRT_DATA_MAX_SIZE, DEFAULT_VIRT_DATA_MAX_SIZE));
+	constValues.insert(make_pair(TW_SS_DEFAULT_VIRT_CACHE_SIZE, DEFAULT_VIRT_CACHE_SIZE));
+	constValues.insert(make_pair(TW_SS_DEFAULT_VIRT_CACHE_MIN_SIZE, DEFAULT_VIRT_CACHE_MIN_SIZE));
+	constValues.insert(make_pair(TW_SS_DEFAULT_VIRT_CACHE_MAX_SIZE, DEFAULT_VIRT_CACHE_MAX_SIZE));
 #endif
 	TWPartition *store = PartitionManager.Get_Default_Storage_Partition();
 	if(store)
-		mValues.insert(make_pair("tw_storage_path", make_pair(store->Storage_Path.c_str(), 1)));
+		values.insert(make_pair("tw_storage_path", make_pair(store->Storage_Path.c_str(), 1)));
 	else
-		mValues.insert(make_pair("tw_storage_path", make_pair("/", 1)));
+		values.insert(make_pair("tw_storage_path", make_pair("/", 1)));
 
 #ifdef TW_FORCE_CPUINFO_FOR_DEVICE_ID
 	printf("TW_FORCE_CPUINFO_FOR_DEVICE_ID := true\n");
@@ -668,237 +712,238 @@ void DataManager::SetDefaultValues()
 
 #ifdef BOARD_HAS_NO_REAL_SDCARD
 	printf("BOARD_HAS_NO_REAL_SDCARD := true\n");
-	mConstValues.insert(make_pair(TW_ALLOW_PARTITION_SDCARD, "0"));
+	constValues.insert(make_pair(TW_ALLOW_PARTITION_SDCARD, "0"));
 #else
-	mConstValues.insert(make_pair(TW_ALLOW_PARTITION_SDCARD, "1"));
+	constValues.insert(make_pair(TW_ALLOW_PARTITION_SDCARD, "1"));
 #endif
 
 #ifdef TW_INCLUDE_DUMLOCK
 	printf("TW_INCLUDE_DUMLOCK := true\n");
-	mConstValues.insert(make_pair(TW_SHOW_DUMLOCK, "1"));
+	constValues.insert(make_pair(TW_SHOW_DUMLOCK, "1"));
 #else
-	mConstValues.insert(make_pair(TW_SHOW_DUMLOCK, "0"));
+	constValues.insert(make_pair(TW_SHOW_DUMLOCK, "0"));
 #endif
 
 #ifdef TW_INTERNAL_STORAGE_PATH
 	LOGINFO("Internal path defined: '%s'\n", EXPAND(TW_INTERNAL_STORAGE_PATH));
-	mValues.insert(make_pair(TW_USE_EXTERNAL_STORAGE, make_pair("0", 1)));
-	mConstValues.insert(make_pair(TW_HAS_INTERNAL, "1"));
-	mValues.insert(make_pair(TW_INTERNAL_PATH, make_pair(EXPAND(TW_INTERNAL_STORAGE_PATH), 0)));
-	mConstValues.insert(make_pair(TW_INTERNAL_LABEL, EXPAND(TW_INTERNAL_STORAGE_MOUNT_POINT)));
+	values.insert(make_pair(TW_USE_EXTERNAL_STORAGE, make_pair("0", 1)));
+	constValues.insert(make_pair(TW_HAS_INTERNAL, "1"));
+	values.insert(make_pair(TW_INTERNAL_PATH, make_pair(EXPAND(TW_INTERNAL_STORAGE_PATH), 0)));
+	constValues.insert(make_pair(TW_INTERNAL_LABEL, EXPAND(TW_INTERNAL_STORAGE_MOUNT_POINT)));
 	path.clear();
 	path = "/";
 	path += EXPAND(TW_INTERNAL_STORAGE_MOUNT_POINT);
-	mConstValues.insert(make_pair(TW_INTERNAL_MOUNT, path));
+	constValues.insert(make_pair(TW_INTERNAL_MOUNT, path));
 	#ifdef TW_EXTERNAL_STORAGE_PATH
 		LOGINFO("External path defined: '%s'\n", EXPAND(TW_EXTERNAL_STORAGE_PATH));
 		// Device has dual storage
-		mConstValues.insert(make_pair(TW_HAS_DUAL_STORAGE, "1"));
-		mConstValues.insert(make_pair(TW_HAS_EXTERNAL, "1"));
-		mConstValues.insert(make_pair(TW_EXTERNAL_PATH, EXPAND(TW_EXTERNAL_STORAGE_PATH)));
-		mConstValues.insert(make_pair(TW_EXTERNAL_LABEL, EXPAND(TW_EXTERNAL_STORAGE_MOUNT_POINT)));
-		mValues.insert(make_pair(TW_ZIP_EXTERNAL_VAR, make_pair(EXPAND(TW_EXTERNAL_STORAGE_PATH), 1)));
+		constValues.insert(make_pair(TW_HAS_DUAL_STORAGE, "1"));
+		constValues.insert(make_pair(TW_HAS_EXTERNAL, "1"));
+		constValues.insert(make_pair(TW_EXTERNAL_PATH, EXPAND(TW_EXTERNAL_STORAGE_PATH)));
+		constValues.insert(make_pair(TW_EXTERNAL_LABEL, EXPAND(TW_EXTERNAL_STORAGE_MOUNT_POINT)));
+		values.insert(make_pair(TW_ZIP_EXTERNAL_VAR, make_pair(EXPAND(TW_EXTERNAL_STORAGE_PATH), 1)));
 		path.clear();
 		path = "/";
 		path += EXPAND(TW_EXTERNAL_STORAGE_MOUNT_POINT);
-		mConstValues.insert(make_pair(TW_EXTERNAL_MOUNT, path));
+		constValues.insert(make_pair(TW_EXTERNAL_MOUNT, path));
 		if (strcmp(EXPAND(TW_EXTERNAL_STORAGE_PATH), "/sdcard") == 0) {
-			mValues.insert(make_pair(TW_ZIP_INTERNAL_VAR, make_pair("/emmc", 1)));
+			values.insert(make_pair(TW_ZIP_INTERNAL_VAR, make_pair("/emmc", 1)));
 		} else {
-			mValues.insert(make_pair(TW_ZIP_INTERNAL_VAR, make_pair("/sdcard", 1)));
+			values.insert(make_pair(TW_ZIP_INTERNAL_VAR, make_pair("/sdcard", 1)));
 		}
 	#else
 		LOGINFO("Just has internal storage.\n");
 		// Just has internal storage
-		mValues.insert(make_pair(TW_ZIP_INTERNAL_VAR, make_pair("/sdcard", 1)));
-		mConstValues.insert(make_pair(TW_HAS_DUAL_STORAGE, "0"));
-		mConstValues.insert(make_pair(TW_HAS_EXTERNAL, "0"));
-		mConstValues.insert(make_pair(TW_EXTERNAL_PATH, "0"));
-		mConstValues.insert(make_pair(TW_EXTERNAL_MOUNT, "0"));
-		mConstValues.insert(make_pair(TW_EXTERNAL_LABEL, "0"));
+		values.insert(make_pair(TW_ZIP_INTERNAL_VAR, make_pair("/sdcard", 1)));
+		constValues.insert(make_pair(TW_HAS_DUAL_STORAGE, "0"));
+		constValues.insert(make_pair(TW_HAS_EXTERNAL, "0"));
+		constValues.insert(make_pair(TW_EXTERNAL_PATH, "0"));
+		constValues.insert(make_pair(TW_EXTERNAL_MOUNT, "0"));
+		constValues.insert(make_pair(TW_EXTERNAL_LABEL, "0"));
 	#endif
 #else
 	#ifdef RECOVERY_SDCARD_ON_DATA
 		#ifdef TW_EXTERNAL_STORAGE_PATH
 			LOGINFO("Has /data/media + external storage in '%s'\n", EXPAND(TW_EXTERNAL_STORAGE_PATH));
 			// Device has /data/media + external storage
-			mConstValues.insert(make_pair(TW_HAS_DUAL_STORAGE, "1"));
+			constValues.insert(make_pair(TW_HAS_DUAL_STORAGE, "1"));
 		#else
 			LOGINFO("Single storage only -- data/media.\n");
 			// Device just has external storage
-			mConstValues.insert(make_pair(TW_HAS_DUAL_STORAGE, "0"));
-			mConstValues.insert(make_pair(TW_HAS_EXTERNAL, "0"));
+			constValues.insert(make_pair(TW_HAS_DUAL_STORAGE, "0"));
+			constValues.insert(make_pair(TW_HAS_EXTERNAL, "0"));
 		#endif
 	#else
 		LOGINFO("Single storage only.\n");
 		// Device just has external storage
-		mConstValues.insert(make_pair(TW_HAS_DUAL_STORAGE, "0"));
+		constValues.insert(make_pair(TW_HAS_DUAL_STORAGE, "0"));
 	#endif
 	#ifdef RECOVERY_SDCARD_ON_DATA
 		LOGINFO("Device has /data/media defined.\n");
 		// Device has /data/media
-		mConstValues.insert(make_pair(TW_USE_EXTERNAL_STORAGE, "0"));
-		mConstValues.insert(make_pair(TW_HAS_INTERNAL, "1"));
+		constValues.insert(make_pair(TW_USE_EXTERNAL_STORAGE, "0"));
+		constValues.insert(make_pair(TW_HAS_INTERNAL, "1"));
 #ifdef BUILD_SAFESTRAP
-		mValues.insert(make_pair(TW_INTERNAL_PATH, make_pair(datamedia_mount + "/media", 0)));
-		mConstValues.insert(make_pair(TW_INTERNAL_MOUNT, datamedia_mount));
-		mConstValues.insert(make_pair(TW_INTERNAL_LABEL, "datamedia"));
+		values.insert(make_pair(TW_INTERNAL_PATH, make_pair(datamedia_mount + "/media", 0)));
+		constValues.insert(make_pair(TW_INTERNAL_MOUNT, datamedia_mount));
+		constValues.insert(make_pair(TW_INTERNAL_LABEL, "datamedia"));
 #else
-		mValues.insert(make_pair(TW_INTERNAL_PATH, make_pair("/data/media", 0)));
-		mConstValues.insert(make_pair(TW_INTERNAL_MOUNT, "/data"));
-		mConstValues.insert(make_pair(TW_INTERNAL_LABEL, "data"));
+		values.insert(make_pair(TW_INTERNAL_PATH, make_pair("/data/media", 0)));
+		constValues.insert(make_pair(TW_INTERNAL_MOUNT, "/data"));
+		constValues.insert(make_pair(TW_INTERNAL_LABEL, "data"));
 #endif
 		#ifdef TW_EXTERNAL_STORAGE_PATH
 			if (strcmp(EXPAND(TW_EXTERNAL_STORAGE_PATH), "/sdcard") == 0) {
-				mValues.insert(make_pair(TW_ZIP_INTERNAL_VAR, make_pair("/emmc", 1)));
+				values.insert(make_pair(TW_ZIP_INTERNAL_VAR, make_pair("/emmc", 1)));
 			} else {
-				mValues.insert(make_pair(TW_ZIP_INTERNAL_VAR, make_pair("/sdcard", 1)));
+				values.insert(make_pair(TW_ZIP_INTERNAL_VAR, make_pair("/sdcard", 1)));
 			}
 		#else
-			mValues.insert(make_pair(TW_ZIP_INTERNAL_VAR, make_pair("/sdcard", 1)));
+			values.insert(make_pair(TW_ZIP_INTERNAL_VAR, make_pair("/sdcard", 1)));
 		#endif
 	#else
 		LOGINFO("No internal storage defined.\n");
 		// Device has no internal storage
-		mConstValues.insert(make_pair(TW_USE_EXTERNAL_STORAGE, "1"));
-		mConstValues.insert(make_pair(TW_HAS_INTERNAL, "0"));
-		mValues.insert(make_pair(TW_INTERNAL_PATH, make_pair("0", 0)));
-		mConstValues.insert(make_pair(TW_INTERNAL_MOUNT, "0"));
-		mConstValues.insert(make_pair(TW_INTERNAL_LABEL, "0"));
+		constValues.insert(make_pair(TW_USE_EXTERNAL_STORAGE, "1"));
+		constValues.insert(make_pair(TW_HAS_INTERNAL, "0"));
+		values.insert(make_pair(TW_INTERNAL_PATH, make_pair("0", 0)));
+		constValues.insert(make_pair(TW_INTERNAL_MOUNT, "0"));
+		constValues.insert(make_pair(TW_INTERNAL_LABEL, "0"));
 	#endif
 	#ifdef TW_EXTERNAL_STORAGE_PATH
 		LOGINFO("Only external path defined: '%s'\n", EXPAND(TW_EXTERNAL_STORAGE_PATH));
 		// External has custom definition
-		mConstValues.insert(make_pair(TW_HAS_EXTERNAL, "1"));
-		mConstValues.insert(make_pair(TW_EXTERNAL_PATH, EXPAND(TW_EXTERNAL_STORAGE_PATH)));
-		mConstValues.insert(make_pair(TW_EXTERNAL_LABEL, EXPAND(TW_EXTERNAL_STORAGE_MOUNT_POINT)));
-		mValues.insert(make_pair(TW_ZIP_EXTERNAL_VAR, make_pair(EXPAND(TW_EXTERNAL_STORAGE_PATH), 1)));
+		constValues.insert(make_pair(TW_HAS_EXTERNAL, "1"));
+		constValues.insert(make_pair(TW_EXTERNAL_PATH, EXPAND(TW_EXTERNAL_STORAGE_PATH)));
+		constValues.insert(make_pair(TW_EXTERNAL_LABEL, EXPAND(TW_EXTERNAL_STORAGE_MOUNT_POINT)));
+		values.insert(make_pair(TW_ZIP_EXTERNAL_VAR, make_pair(EXPAND(TW_EXTERNAL_STORAGE_PATH), 1)));
 		path.clear();
 		path = "/";
 		path += EXPAND(TW_EXTERNAL_STORAGE_MOUNT_POINT);
-		mConstValues.insert(make_pair(TW_EXTERNAL_MOUNT, path));
+		constValues.insert(make_pair(TW_EXTERNAL_MOUNT, path));
 	#else
 		#ifndef RECOVERY_SDCARD_ON_DATA
 			LOGINFO("No storage defined, defaulting to /sdcard.\n");
 			// Standard external definition
-			mConstValues.insert(make_pair(TW_HAS_EXTERNAL, "1"));
-			mConstValues.insert(make_pair(TW_EXTERNAL_PATH, "/sdcard"));
-			mConstValues.insert(make_pair(TW_EXTERNAL_MOUNT, "/sdcard"));
-			mConstValues.insert(make_pair(TW_EXTERNAL_LABEL, "sdcard"));
-			mValues.insert(make_pair(TW_ZIP_EXTERNAL_VAR, make_pair("/sdcard", 1)));
+			constValues.insert(make_pair(TW_HAS_EXTERNAL, "1"));
+			constValues.insert(make_pair(TW_EXTERNAL_PATH, "/sdcard"));
+			constValues.insert(make_pair(TW_EXTERNAL_MOUNT, "/sdcard"));
+			constValues.insert(make_pair(TW_EXTERNAL_LABEL, "sdcard"));
+			values.insert(make_pair(TW_ZIP_EXTERNAL_VAR, make_pair("/sdcard", 1)));
 		#endif
 	#endif
 #endif
 
 #ifdef TW_DEFAULT_EXTERNAL_STORAGE
-	SetValue(TW_USE_EXTERNAL_STORAGE, 1);
+	Set_Default(values, TW_USE_EXTERNAL_STORAGE, "1");
+	// Follow it with the storage path as SetValue would, the zip location
+	// and backup folder below are derived from it
+	if (Get_Default(values, constValues, TW_HAS_DUAL_STORAGE) == "1" || Get_Default(values, constValues, TW_HAS_INTERNAL) != "1")
+		Set_Default(values, "tw_storage_path", Get_Default(values, constValues, TW_EXTERNAL_PATH), 1);
 	printf("TW_DEFAULT_EXTERNAL_STORAGE := true\n");
 #endif
 
 #ifdef RECOVERY_SDCARD_ON_DATA
 #ifdef BUILD_SAFESTRAP
 	if (PartitionManager.Mount_By_Path(datamedia_mount, false) && TWFunc::Path_Exists(datamedia_mount + "/media/0"))
-		SetValue(TW_INTERNAL_PATH, datamedia_mount + "/media/0");
+		Set_Default(values, TW_INTERNAL_PATH, datamedia_mount + "/media/0");
 #else
 	if (PartitionManager.Mount_By_Path("/data", false) && TWFunc::Path_Exists("/data/media/0"))
-		SetValue(TW_INTERNAL_PATH, "/data/media/0");
+		Set_Default(values, TW_INTERNAL_PATH, "/data/media/0");
 #endif
 #endif
-	str = GetCurrentStoragePath();
+	str = Get_Default(values, constValues, "tw_storage_path");
 #ifdef RECOVERY_SDCARD_ON_DATA
 	#ifndef TW_EXTERNAL_STORAGE_PATH
-		SetValue(TW_ZIP_LOCATION_VAR, "/sdcard", 1);
+		Set_Default(values, TW_ZIP_LOCATION_VAR, "/sdcard", 1);
 	#else
 		if (strcmp(EXPAND(TW_EXTERNAL_STORAGE_PATH), "/sdcard") == 0) {
-			SetValue(TW_ZIP_LOCATION_VAR, "/emmc", 1);
+			Set_Default(values, TW_ZIP_LOCATION_VAR, "/emmc", 1);
 		} else {
-			SetValue(TW_ZIP_LOCATION_VAR, "/sdcard", 1);
+			Set_Default(values, TW_ZIP_LOCATION_VAR, "/sdcard", 1);
 		}
 	#endif
 #else
-	SetValue(TW_ZIP_LOCATION_VAR, str.c_str(), 1);
+	Set_Default(values, TW_ZIP_LOCATION_VAR, str.c_str(), 1);
 #endif
 	str += "/TWRP/BACKUPS/";
 
-	string dev_id;
-	GetValue("device_id", dev_id);
-
-	str += dev_id;
-	SetValue(TW_BACKUPS_FOLDER_VAR, str, 0);
+	str += Get_Default(values, constValues, "device_id");
+	Set_Default(values, TW_BACKUPS_FOLDER_VAR, str, 0);
 
 #ifdef SP1_DISPLAY_NAME
 	printf("SP1_DISPLAY_NAME := %s\n", EXPAND(SP1_DISPLAY_NAME));
-	if (strlen(EXPAND(SP1_DISPLAY_NAME))) mConstValues.insert(make_pair(TW_SP1_PARTITION_NAME_VAR, EXPAND(SP1_DISPLAY_NAME)));
+	if (strlen(EXPAND(SP1_DISPLAY_NAME))) constValues.insert(make_pair(TW_SP1_PARTITION_NAME_VAR, EXPAND(SP1_DISPLAY_NAME)));
 #else
 	#ifdef SP1_NAME
 		printf("SP1_NAME := %s\n", EXPAND(SP1_NAME));
-		if (strlen(EXPAND(SP1_NAME))) mConstValues.insert(make_pair(TW_SP1_PARTITION_NAME_VAR, EXPAND(SP1_NAME)));
+		if (strlen(EXPAND(SP1_NAME))) constValues.insert(make_pair(TW_SP1_PARTITION_NAME_VAR, EXPAND(SP1_NAME)));
 	#endif
 #endif
 #ifdef SP2_DISPLAY_NAME
 	printf("SP2_DISPLAY_NAME := %s\n", EXPAND(SP2_DISPLAY_NAME));
-	if (strlen(EXPAND(SP2_DISPLAY_NAME))) mConstValues.insert(make_pair(TW_SP2_PARTITION_NAME_VAR, EXPAND(SP2_DISPLAY_NAME)));
+	if (strlen(EXPAND(SP2_DISPLAY_NAME))) constValues.insert(make_pair(TW_SP2_PARTITION_NAME_VAR, EXPAND(SP2_DISPLAY_NAME)));
 #else
 	#ifdef SP2_NAME
 		printf("SP2_NAME := %s\n", EXPAND(SP2_NAME));
-		if (strlen(EXPAND(SP2_NAME))) mConstValues.insert(make_pair(TW_SP2_PARTITION_NAME_VAR, EXPAND(SP2_NAME)));
+		if (strlen(EXPAND(SP2_NAME))) constValues.insert(make_pair(TW_SP2_PARTITION_NAME_VAR, EXPAND(SP2_NAME)));
 	#endif
 #endif
 #ifdef SP3_DISPLAY_NAME
 	printf("SP3_DISPLAY_NAME := %s\n", EXPAND(SP3_DISPLAY_NAME));
-	if (strlen(EXPAND(SP3_DISPLAY_NAME))) mConstValues.insert(make_pair(TW_SP3_PARTITION_NAME_VAR, EXPAND(SP3_DISPLAY_NAME)));
+	if (strlen(EXPAND(SP3_DISPLAY_NAME))) constValues.insert(make_pair(TW_SP3_PARTITION_NAME_VAR, EXPAND(SP3_DISPLAY_NAME)));
 #else
 	#ifdef SP3_NAME
 		printf("SP3_NAME := %s\n", EXPAND(SP3_NAME));
-		if (strlen(EXPAND(SP3_NAME))) mConstValues.insert(make_pair(TW_SP3_PARTITION_NAME_VAR, EXPAND(SP3_NAME)));
+		if (strlen(EXPAND(SP3_NAME))) constValues.insert(make_pair(TW_SP3_PARTITION_NAME_VAR, EXPAND(SP3_NAME)));
 	#endif
 #endif
 
-	mConstValues.insert(make_pair(TW_REBOOT_SYSTEM, "1"));
+	constValues.insert(make_pair(TW_REBOOT_SYSTEM, "1"));
 #ifdef TW_NO_REBOOT_RECOVERY
 	printf("TW_NO_REBOOT_RECOVERY := true\n");
-	mConstValues.insert(make_pair(TW_REBOOT_RECOVERY, "0"));
+	constValues.insert(make_pair(TW_REBOOT_RECOVERY, "0"));
 #else
-	mConstValues.insert(make_pair(TW_REBOOT_RECOVERY, "1"));
+	constValues.insert(make_pair(TW_REBOOT_RECOVERY, "1"));
 #endif
-	mConstValues.insert(make_pair(TW_REBOOT_POWEROFF, "1"));
+	constValues.insert(make_pair(TW_REBOOT_POWEROFF, "1"));
 #ifdef TW_NO_REBOOT_BOOTLOADER
 	printf("TW_NO_REBOOT_BOOTLOADER := true\n");
-	mConstValues.insert(make_pair(TW_REBOOT_BOOTLOADER, "0"));
+	constValues.insert(make_pair(TW_REBOOT_BOOTLOADER, "0"));
 #else
-	mConstValues.insert(make_pair(TW_REBOOT_BOOTLOADER, "1"));
+	constValues.insert(make_pair(TW_REBOOT_BOOTLOADER, "1"));
 #endif
 #ifdef RECOVERY_SDCARD_ON_DATA
 	printf("RECOVERY_SDCARD_ON_DATA := true\n");
-	mConstValues.insert(make_pair(TW_HAS_DATA_MEDIA, "1"));
+	constValues.insert(make_pair(TW_HAS_DATA_MEDIA, "1"));
 #else
-	mConstValues.insert(make_pair(TW_HAS_DATA_MEDIA, "0"));
+	constValues.insert(make_pair(TW_HAS_DATA_MEDIA, "0"));
 #endif
 #ifdef TW_NO_BATT_PERCENT
 	printf("TW_NO_BATT_PERCENT := true\n");
-	mConstValues.insert(make_pair(TW_NO_BATTERY_PERCENT, "1"));
+	constValues.insert(make_pair(TW_NO_BATTERY_PERCENT, "1"));
 #else
-	mConstValues.insert(make_pair(TW_NO_BATTERY_PERCENT, "0"));
+	constValues.insert(make_pair(TW_NO_BATTERY_PERCENT, "0"));
 #endif
 #ifdef TW_CUSTOM_POWER_BUTTON
 	printf("TW_POWER_BUTTON := %s\n", EXPAND(TW_CUSTOM_POWER_BUTTON));
-	mConstValues.insert(make_pair(TW_POWER_BUTTON, EXPAND(TW_CUSTOM_POWER_BUTTON)));
+	constValues.insert(make_pair(TW_POWER_BUTTON, EXPAND(TW_CUSTOM_POWER_BUTTON)));
 #else
-	mConstValues.insert(make_pair(TW_POWER_BUTTON, "0"));
+	constValues.insert(make_pair(TW_POWER_BUTTON, "0"));
 #endif
 #ifdef TW_ALWAYS_RMRF
 	printf("TW_ALWAYS_RMRF := true\n");
-	mConstValues.insert(make_pair(TW_RM_RF_VAR, "1"));
+	constValues.insert(make_pair(TW_RM_RF_VAR, "1"));
 #endif
 #ifdef TW_NEVER_UNMOUNT_SYSTEM
 	printf("TW_NEVER_UNMOUNT_SYSTEM := true\n");
-	mConstValues.insert(make_pair(TW_DONT_UNMOUNT_SYSTEM, "1"));
+	constValues.insert(make_pair(TW_DONT_UNMOUNT_SYSTEM, "1"));
 #else
-	mConstValues.insert(make_pair(TW_DONT_UNMOUNT_SYSTEM, "0"));
+	constValues.insert(make_pair(TW_DONT_UNMOUNT_SYSTEM, "0"));
 #endif
 #ifdef TW_NO_USB_STORAGE
 	printf("TW_NO_USB_STORAGE := true\n");
-	mConstValues.insert(make_pair(TW_HAS_USB_STORAGE, "0"));
+	constValues.insert(make_pair(TW_HAS_USB_STORAGE, "0"));
 #else
 	char lun_file[255];
 	string Lun_File_str = CUSTOM_LUN_FILE;
@@ -909,120 +954,125 @@ void DataManager::SetDefaultValues()
 	}
 	if (!TWFunc::Path_Exists(Lun_File_str)) {
 		LOGINFO("Lun file '%s' does not exist, USB storage mode disabled\n", Lun_File_str.c_str());
-		mConstValues.insert(make_pair(TW_HAS_USB_STORAGE, "0"));
+		constValues.insert(make_pair(TW_HAS_USB_STORAGE, "0"));
 	} else {
 		LOGINFO("Lun file '%s'\n", Lun_File_str.c_str());
-		mConstValues.insert(make_pair(TW_HAS_USB_STORAGE, "1"));
+		constValues.insert(make_pair(TW_HAS_USB_STORAGE, "1"));
 	}
 #endif
 #ifdef TW_INCLUDE_INJECTTWRP
 	printf("TW_INCLUDE_INJECTTWRP := true\n");
-	mConstValues.insert(make_pair(TW_HAS_INJECTTWRP, "1"));
-	mValues.insert(make_pair(TW_INJECT_AFTER_ZIP, make_pair("1", 1)));
+	constValues.insert(make_pair(TW_HAS_INJECTTWRP, "1"));
+	values.insert(make_pair(TW_INJECT_AFTER_ZIP, make_pair("1", 1)));
 #else
-	mConstValues.insert(make_pair(TW_HAS_INJECTTWRP, "0"));
-	mValues.insert(make_pair(TW_INJECT_AFTER_ZIP, make_pair("0", 1)));
+	constValues.insert(make_pair(TW_HAS_INJECTTWRP, "0"));
+	values.insert(make_pair(TW_INJECT_AFTER_ZIP, make_pair("0", 1)));
 #endif
 #ifdef TW_HAS_DOWNLOAD_MODE
 	printf("TW_HAS_DOWNLOAD_MODE := true\n");
-	mConstValues.insert(make_pair(TW_DOWNLOAD_MODE, "1"));
+	constValues.insert(make_pair(TW_DOWNLOAD_MODE, "1"));
 #endif
 #ifdef TW_INCLUDE_CRYPTO
-	mConstValues.insert(make_pair(TW_HAS_CRYPTO, "1"));
+	constValues.insert(make_pair(TW_HAS_CRYPTO, "1"));
 	printf("TW_INCLUDE_CRYPTO := true\n");
 #endif
 #ifdef TW_SDEXT_NO_EXT4
 	printf("TW_SDEXT_NO_EXT4 := true\n");
-	mConstValues.insert(make_pair(TW_SDEXT_DISABLE_EXT4, "1"));
+	constValues.insert(make_pair(TW_SDEXT_DISABLE_EXT4, "1"));
 #else
-	mConstValues.insert(make_pair(TW_SDEXT_DISABLE_EXT4, "0"));
+	constValues.insert(make_pair(TW_SDEXT_DISABLE_EXT4, "0"));
 #endif
 
 #ifdef TW_HAS_NO_BOOT_PARTITION
-	mValues.insert(make_pair("tw_backup_list", make_pair("/system;/data;", 1)));
+	values.insert(make_pair("tw_backup_list", make_pair("/system;/data;", 1)));
 #else
-	mValues.insert(make_pair("tw_backup_list", make_pair("/system;/data;/boot;", 1)));
+	values.insert(make_pair("tw_backup_list", make_pair("/system;/data;/boot;", 1)));
 #endif
-	mConstValues.insert(make_pair(TW_MIN_SYSTEM_VAR, TW_MIN_SYSTEM_SIZE));
-	mValues.insert(make_pair(TW_BACKUP_NAME, make_pair("(Auto Generate)", 0)));
-	mValues.insert(make_pair(TW_BACKUP_SYSTEM_VAR, make_pair("1", 1)));
-	mValues.insert(make_pair(TW_BACKUP_DATA_VAR, make_pair("1", 1)));
-	mValues.insert(make_pair(TW_BACKUP_BOOT_VAR, make_pair("1", 1)));
-	mValues.insert(make_pair(TW_BACKUP_RECOVERY_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_BACKUP_CACHE_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_BACKUP_SP1_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_BACKUP_SP2_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_BACKUP_SP3_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_BACKUP_ANDSEC_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_BACKUP_SDEXT_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_BACKUP_SYSTEM_SIZE, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_BACKUP_DATA_SIZE, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_BACKUP_BOOT_SIZE, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_BACKUP_RECOVERY_SIZE, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_BACKUP_CACHE_SIZE, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_BACKUP_ANDSEC_SIZE, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_BACKUP_SDEXT_SIZE, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_BACKUP_SP1_SIZE, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_BACKUP_SP2_SIZE, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_BACKUP_SP3_SIZE, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_STORAGE_FREE_SIZE, make_pair("0", 0)));
+	constValues.insert(make_pair(TW_MIN_SYSTEM_VAR, TW_MIN_SYSTEM_SIZE));
+	values.insert(make_pair(TW_BACKUP_NAME, make_pair("(Auto Generate)", 0)));
+	values.insert(make_pair(TW_BACKUP_SYSTEM_VAR, make_pair("1", 1)));
+	values.insert(make_pair(TW_BACKUP_DATA_VAR, make_pair("1", 1)));
+	values.insert(make_pair(TW_BACKUP_BOOT_VAR, make_pair("1", 1)));
+	values.insert(make_pair(TW_BACKUP_RECOVERY_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_BACKUP_CACHE_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_BACKUP_SP1_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_BACKUP_SP2_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_BACKUP_SP3_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_BACKUP_ANDSEC_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_BACKUP_SDEXT_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_BACKUP_SYSTEM_SIZE, make_pair("0", 0)));
+	values.insert(make_pair(TW_BACKUP_DATA_SIZE, make_pair("0", 0)));
+	values.insert(make_pair(TW_BACKUP_BOOT_SIZE, make_pair("0", 0)));
+	values.insert(make_pair(TW_BACKUP_RECOVERY_SIZE, make_pair("0", 0)));
+	values.insert(make_pair(TW_BACKUP_CACHE_SIZE, make_pair("0", 0)));
+	values.insert(make_pair(TW_BACKUP_ANDSEC_SIZE, make_pair("0", 0)));
+	values.insert(make_pair(TW_BACKUP_SDEXT_SIZE, make_pair("0", 0)));
+	values.insert(make_pair(TW_BACKUP_SP1_SIZE, make_pair("0", 0)));
+	values.insert(make_pair(TW_BACKUP_SP2_SIZE, make_pair("0", 0)));
+	values.insert(make_pair(TW_BACKUP_SP3_SIZE, make_pair("0", 0)));
+	values.insert(make_pair(TW_STORAGE_FREE_SIZE, make_pair("0", 0)));
 #ifdef BUILD_SAFESTRAP
-	mValues.insert(make_pair(TW_SS_STORAGE_FREE_SIZE, make_pair("0", 0)));
+	values.insert(make_pair(TW_SS_STORAGE_FREE_SIZE, make_pair("0", 0)));
 #endif
 
-	mValues.insert(make_pair(TW_REBOOT_AFTER_FLASH_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_SIGNED_ZIP_VERIFY_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_FORCE_MD5_CHECK_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_COLOR_THEME_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_USE_COMPRESSION_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_SHOW_SPAM_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_TIME_ZONE_VAR, make_pair("CST6CDT", 1)));
-	mValues.insert(make_pair(TW_SORT_FILES_BY_DATE_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_GUI_SORT_ORDER, make_pair("1", 1)));
-	mValues.insert(make_pair(TW_RM_RF_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_SKIP_MD5_CHECK_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_SKIP_MD5_GENERATE_VAR, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_SDEXT_SIZE, make_pair("512", 1)));
-	mValues.insert(make_pair(TW_SWAP_SIZE, make_pair("32", 1)));
-	mValues.insert(make_pair(TW_SDPART_FILE_SYSTEM, make_pair("ext3", 1)));
-	mValues.insert(make_pair(TW_TIME_ZONE_GUISEL, make_pair("CST6;CDT", 1)));
-	mValues.insert(make_pair(TW_TIME_ZONE_GUIOFFSET, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_TIME_ZONE_GUIDST, make_pair("1", 1)));
-	mValues.insert(make_pair(TW_ACTION_BUSY, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_BACKUP_AVG_IMG_RATE, make_pair("15000000", 1)));
-	mValues.insert(make_pair(TW_BACKUP_AVG_FILE_RATE, make_pair("3000000", 1)));
-	mValues.insert(make_pair(TW_BACKUP_AVG_FILE_COMP_RATE, make_pair("2000000", 1)));
-	mValues.insert(make_pair(TW_RESTORE_AVG_IMG_RATE, make_pair("15000000", 1)));
-	mValues.insert(make_pair(TW_RESTORE_AVG_FILE_RATE, make_pair("3000000", 1)));
-	mValues.insert(make_pair(TW_RESTORE_AVG_FILE_COMP_RATE, make_pair("2000000", 1)));
-	mValues.insert(make_pair("tw_wipe_cache", make_pair("0", 0)));
-	mValues.insert(make_pair("tw_wipe_dalvik", make_pair("0", 0)));
-	if (GetIntValue(TW_HAS_INTERNAL) == 1 && GetIntValue(TW_HAS_DATA_MEDIA) == 1 && GetIntValue(TW_HAS_EXTERNAL) == 0)
-		SetValue(TW_HAS_USB_STORAGE, 0, 0);
+	values.insert(make_pair(TW_REBOOT_AFTER_FLASH_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_SIGNED_ZIP_VERIFY_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_FORCE_MD5_CHECK_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_COLOR_THEME_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_USE_COMPRESSION_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_SHOW_SPAM_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_TIME_ZONE_VAR, make_pair("CST6CDT", 1)));
+	values.insert(make_pair(TW_SORT_FILES_BY_DATE_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_GUI_SORT_ORDER, make_pair("1", 1)));
+	values.insert(make_pair(TW_RM_RF_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_SKIP_MD5_CHECK_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_SKIP_MD5_GENERATE_VAR, make_pair("0", 1)));
+	values.insert(make_pair(TW_SDEXT_SIZE, make_pair("512", 1)));
+	values.insert(make_pair(TW_SWAP_SIZE, make_pair("32", 1)));
+	values.insert(make_pair(TW_SDPART_FILE_SYSTEM, make_pair("ext3", 1)));
+	values.insert(make_pair(TW_TIME_ZONE_GUISEL, make_pair("CST6;CDT", 1)));
+	values.insert(make_pair(TW_TIME_ZONE_GUIOFFSET, make_pair("0", 1)));
+	values.insert(make_pair(TW_TIME_ZONE_GUIDST, make_pair("1", 1)));
+	values.insert(make_pair(TW_ACTION_BUSY, make_pair("0", 0)));
+	values.insert(make_pair(TW_BACKUP_AVG_IMG_RATE, make_pair("15000000", 1)));
+	values.insert(make_pair(TW_BACKUP_AVG_FILE_RATE, make_pair("3000000", 1)));
+	values.insert(make_pair(TW_BACKUP_AVG_FILE_COMP_RATE, make_pair("2000000", 1)));
+	values.insert(make_pair(TW_RESTORE_AVG_IMG_RATE, make_pair("15000000", 1)));
+	values.insert(make_pair(TW_RESTORE_AVG_FILE_RATE, make_pair("3000000", 1)));
+	values.insert(make_pair(TW_RESTORE_AVG_FILE_COMP_RATE, make_pair("2000000", 1)));
+	values.insert(make_pair(TW_BACKUP_AVG_COMP_RATIO, make_pair("60", 1)));
+	values.insert(make_pair(TW_MD5_AVG_RATE, make_pair("20000000", 1)));
+	values.insert(make_pair(TW_INSTALL_AVG_RATE, make_pair("5000000", 1)));
+	values.insert(make_pair(TW_OPERATION_ETA, make_pair("0", 0)));
+	values.insert(make_pair(TW_OPERATION_ETA_TEXT, make_pair("", 0)));
+	values.insert(make_pair("tw_wipe_cache", make_pair("0", 0)));
+	values.insert(make_pair("tw_wipe_dalvik", make_pair("0", 0)));
+	if (Get_Default(values, constValues, TW_HAS_INTERNAL) == "1" && Get_Default(values, constValues, TW_HAS_DATA_MEDIA) == "1" && Get_Default(values, constValues, TW_HAS_EXTERNAL) == "0")
+		Set_Default(values, TW_HAS_USB_STORAGE, "0", 0);
 	else
-		SetValue(TW_HAS_USB_STORAGE, 1, 0);
-	mValues.insert(make_pair(TW_ZIP_INDEX, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_ZIP_QUEUE_COUNT, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_FILENAME, make_pair("/sdcard", 0)));
-	mValues.insert(make_pair(TW_SIMULATE_ACTIONS, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_SIMULATE_FAIL, make_pair("0", 1)));
-	mValues.insert(make_pair(TW_IS_ENCRYPTED, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_IS_DECRYPTED, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_CRYPTO_PASSWORD, make_pair("0", 0)));
-	mValues.insert(make_pair(TW_DATA_BLK_DEVICE, make_pair("0", 0)));
-	mValues.insert(make_pair("tw_terminal_state", make_pair("0", 0)));
-	mValues.insert(make_pair("tw_background_thread_running", make_pair("0", 0)));
-	mValues.insert(make_pair(TW_RESTORE_FILE_DATE, make_pair("0", 0)));
-	mValues.insert(make_pair("tw_military_time", make_pair("0", 1)));
+		Set_Default(values, TW_HAS_USB_STORAGE, "1", 0);
+	values.insert(make_pair(TW_ZIP_INDEX, make_pair("0", 0)));
+	values.insert(make_pair(TW_ZIP_QUEUE_COUNT, make_pair("0", 0)));
+	values.insert(make_pair(TW_FILENAME, make_pair("/sdcard", 0)));
+	values.insert(make_pair(TW_SIMULATE_ACTIONS, make_pair("0", 1)));
+	values.insert(make_pair(TW_SIMULATE_FAIL, make_pair("0", 1)));
+	values.insert(make_pair(TW_IS_ENCRYPTED, make_pair("0", 0)));
+	values.insert(make_pair(TW_IS_DECRYPTED, make_pair("0", 0)));
+	values.insert(make_pair(TW_CRYPTO_PASSWORD, make_pair("0", 0)));
+	values.insert(make_pair(TW_DATA_BLK_DEVICE, make_pair("0", 0)));
+	values.insert(make_pair("tw_terminal_state", make_pair("0", 0)));
+	values.insert(make_pair("tw_background_thread_running", make_pair("0", 0)));
+	values.insert(make_pair(TW_RESTORE_FILE_DATE, make_pair("0", 0)));
+	values.insert(make_pair("tw_military_time", make_pair("0", 1)));
 #ifdef TW_NO_SCREEN_TIMEOUT
-	mValues.insert(make_pair("tw_screen_timeout_secs", make_pair("0", 1)));
-	mValues.insert(make_pair("tw_no_screen_timeout", make_pair("1", 1)));
+	values.insert(make_pair("tw_screen_timeout_secs", make_pair("0", 1)));
+	values.insert(make_pair("tw_no_screen_timeout", make_pair("1", 1)));
 #else
-	mValues.insert(make_pair("tw_screen_timeout_secs", make_pair("60", 1)));
-	mValues.insert(make_pair("tw_no_screen_timeout", make_pair("0", 1)));
+	values.insert(make_pair("tw_screen_timeout_secs", make_pair("60", 1)));
+	values.insert(make_pair("tw_no_screen_timeout", make_pair("0", 1)));
 #endif
-	mValues.insert(make_pair("tw_gui_done", make_pair("0", 0)));
-	mValues.insert(make_pair("tw_encrypt_backup", make_pair("0", 0)));
+	values.insert(make_pair("tw_gui_done", make_pair("0", 0)));
+	values.insert(make_pair("tw_encrypt_backup", make_pair("0", 0)));
 #ifdef TW_BRIGHTNESS_PATH
 #ifndef TW_MAX_BRIGHTNESS
 #define TW_MAX_BRIGHTNESS 255
@@ -1043,36 +1093,49 @@ void DataManager::SetDefaultValues()
 	}
 	if (findbright.empty()) {
 		LOGINFO("Unable to locate brightness file\n");
-		mConstValues.insert(make_pair("tw_has_brightnesss_file", "0"));
+		constValues.insert(make_pair("tw_has_brightnesss_file", "0"));
 	} else {
 		LOGINFO("Found brightness file at '%s'\n", findbright.c_str());
-		mConstValues.insert(make_pair("tw_has_brightnesss_file", "1"));
-		mConstValues.insert(make_pair("tw_brightness_file", findbright));
+		constValues.insert(make_pair("tw_has_brightnesss_file", "1"));
+		constValues.insert(make_pair("tw_brightness_file", findbright));
 		ostringstream maxVal;
 		maxVal << TW_MAX_BRIGHTNESS;
-		mConstValues.insert(make_pair("tw_brightness_max", maxVal.str()));
-		mValues.insert(make_pair("tw_brightness", make_pair(maxVal.str(), 1)));
-		mValues.insert(make_pair("tw_brightness_pct", make_pair("100", 1)));
+		constValues.insert(make_pair("tw_brightness_max", maxVal.str()));
+		values.insert(make_pair("tw_brightness", make_pair(maxVal.str(), 1)));
+		values.insert(make_pair("tw_brightness_pct", make_pair("100", 1)));
 	}
 #endif
-	mValues.insert(make_pair(TW_MILITARY_TIME, make_pair("0", 1)));
+	values.insert(make_pair(TW_MILITARY_TIME, make_pair("0", 1)));
 #ifdef BUILD_SAFESTRAP
-	mValues.insert(make_pair("tw_rom-slot1_name", make_pair("XXXXXXXXXX", 0)));
-	mValues.insert(make_pair("tw_rom-slot2_name", make_pair("XXXXXXXXXX", 0)));
-	mValues.insert(make_pair("tw_rom-slot3_name", make_pair("XXXXXXXXXX", 0)));
-	mValues.insert(make_pair("tw_rom-slot4_name", make_pair("XXXXXXXXXX", 0)));
-	LoadBootslotVar();
+	values.insert(make_pair("tw_rom-slot1_name", make_pair("XXXXXXXXXX", 0)));
+	values.insert(make_pair("tw_rom-slot2_name", make_pair("XXXXXXXXXX", 0)));
+	values.insert(make_pair("tw_rom-slot3_name", make_pair("XXXXXXXXXX", 0)));
+	values.insert(make_pair("tw_rom-slot4_name", make_pair("XXXXXXXXXX", 0)));
 #endif
 #ifndef TW_EXCLUDE_ENCRYPTED_BACKUPS
-	mValues.insert(make_pair("tw_include_encrypted_backup", make_pair("1", 0)));
+	values.insert(make_pair("tw_include_encrypted_backup", make_pair("1", 0)));
 #else
 	LOGINFO("TW_EXCLUDE_ENCRYPTED_BACKUPS := true\n");
-	mValues.insert(make_pair("tw_include_encrypted_backup", make_pair("0", 0)));
+	values.insert(make_pair("tw_include_encrypted_backup", make_pair("0", 0)));
+#endif
+
+	pthread_rwlock_wrlock(&mLock);
+	if (Reset) {
+		mValues.swap(values);
+		mConstValues.swap(constValues);
+	} else {
+		// Anything set before the defaults were loaded takes precedence
+		mValues.insert(values.begin(), values.end());
+		mConstValues.insert(constValues.begin(), constValues.end());
+	}
+	pthread_rwlock_unlock(&mLock);
+#ifdef BUILD_SAFESTRAP
+	LoadBootslotVar();
 #endif
 }
 
 // Magic Values
-int DataManager::GetMagicValue(const string varName, string& value)
+int DataManager::GetMagicValue(const string& varName, string& value)
 {
 	// Handle special dynamic cases
 	if (varName == "tw_time")
@@ -1351,7 +1414,7 @@ extern "C" void DataManager_ReadSettingsFile(void)
 {
 	return DataManager::ReadSettingsFile();
 }
-void DataManager::Vibrate(const string varName)
+void DataManager::Vibrate(const string& varName)
 {
 	int vib_value = 0;
 	GetValue(varName, vib_value);
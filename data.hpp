@@ -22,6 +22,7 @@
 #include <string>
 #include <utility>
 #include <map>
+#include <pthread.h>
 
 using namespace std;
 
@@ -33,29 +34,29 @@ public:
 	static int Flush();
 
 	// Core get routines
-	static int GetValue(const string varName, string& value);
-	static int GetValue(const string varName, int& value);
-	static int GetValue(const string varName, float& value);
-	static unsigned long long GetValue(const string varName, unsigned long long& value);
+	static int GetValue(const string& varName, string& value);
+	static int GetValue(const string& varName, int& value);
+	static int GetValue(const string& varName, float& value);
+	static unsigned long long GetValue(const string& varName, unsigned long long& value);
 
 	// This is a dangerous function. It will create the value if it doesn't exist so it has a valid c_str
-	static string& GetValueRef(const string varName);
+	static string& GetValueRef(const string& varName);
 
 	// Helper functions
-	static string GetStrValue(const string varName);
-	static int GetIntValue(const string varName);
+	static string GetStrValue(const string& varName);
+	static int GetIntValue(const string& varName);
 
 	// Core set routines
-	static int SetValue(const string varName, string value, int persist = 0);
-	static int SetValue(const string varName, int value, int persist = 0);
-	static int SetValue(const string varName, float value, int persist = 0);
-	static int SetValue(const string varName, unsigned long long value, int persist = 0);
+	static int SetValue(const string& varName, const string& value, int persist = 0);
+	static int SetValue(const string& varName, int value, int persist = 0);
+	static int SetValue(const string& varName, float value, int persist = 0);
+	static int SetValue(const string& varName, unsigned long long value, int persist = 0);
 	static int SetProgress(float Fraction);
 	static int ShowProgress(float Portion, float Seconds);
 
 	static void DumpValues();
 	static void update_tz_environment_variables();
-	static void Vibrate(const string varName);
+	static void Vibrate(const string& varName);
 	static void SetBackupFolder();
 	static void SetDefaultValues();
 	static void Output_Version(void); // Outputs the version to a file in the TWRP folder
@@ -80,14 +81,21 @@ protected:
 
 	static map<string, string> mConstValues;
 
+	// Guards mValues and mConstValues, worker threads set values while the
+	// GUI thread reads them
+	static pthread_rwlock_t mLock;
+
 protected:
 	static int SaveValues();
 
-	static int GetMagicValue(string varName, string& value);
+	static int GetMagicValue(const string& varName, string& value);
 
 private:
 	static void sanitize_device_id(char* device_id);
-	static void get_device_id(void);
+	static string get_device_id(void);
+	static void Set_Default_Values(bool Reset);
+	static void Set_Default(map<string, TStrIntPair>& values, const string& varName, const string& value, int persist = 0);
+	static string Get_Default(map<string, TStrIntPair>& values, map<string, string>& constValues, const string& varName);
 
 };
 
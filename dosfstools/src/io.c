@@ -45,14 +45,24 @@
 #include "common.h"
 #include "io.h"
 
+/* Pending changes never overlap and adjacent ones are merged, so they form a
+   sorted map of extents. It is kept in a skip list to make lookups by
+   position logarithmic even when repairs queue hundreds of thousands of
+   small writes. */
+
+#define CHANGE_LEVELS 24
+
 typedef struct _change {
     void *data;
     loff_t pos;
     int size;
-    struct _change *next;
+    int alloced;		/* size of data */
+    int levels;
+    struct _change *next[1];	/* actually LEVELS entries */
 } CHANGE;
 
-static CHANGE *changes, *last;
+static CHANGE *changes[CHANGE_LEVELS];
+static unsigned long long change_seed = 1;
 static int fd, did_change = 0;
 
 unsigned device_no;
@@ -85,7 +95,7 @@ void fs_open(char *path, int rw)
 	perror("open");
 	exit(6);
     }
-    changes = last = NULL;
+    memset(changes, 0, sizeof(changes));
     did_change = 0;
 
 #ifndef _DJGPP_
@@ -108,6 +118,93 @@ void fs_open(char *path, int rw)
 #endif
 }
 
+/* Stores in PREV[i] the last change at level i that starts before POS, or
+   NULL if there is none, and returns the first change that starts at or
+   after POS. */
+
+static CHANGE *change_find(loff_t pos, CHANGE ** prev)
+{
+    CHANGE *walk = NULL, *next;
+    int i;
+
+    for (i = CHANGE_LEVELS - 1; i >= 0; i--) {
+	while ((next = walk ? walk->next[i] : changes[i]) && next->pos < pos)
+	    walk = next;
+	prev[i] = walk;
+    }
+    return walk ? walk->next[0] : changes[0];
+}
+
+static CHANGE **change_link(CHANGE * prev, int level)
+{
+    return prev ? &prev->next[level] : &changes[level];
+}
+
+static void change_insert(CHANGE * this, CHANGE ** prev)
+{
+    int i;
+
+    for (i = 0; i < this->levels; i++) {
+	this->next[i] = *change_link(prev[i], i);
+	*change_link(prev[i], i) = this;
+    }
+}
+
+/* Unlinks THIS, which must directly follow the changes in PREV. */
+
+static void change_remove(CHANGE * this, CHANGE ** prev)
+{
+    int i;
+
+    for (i = 0; i < this->levels; i++)
+	*change_link(prev[i], i) = this->next[i];
+    free(this->data);
+    free(this);
+}
+
+static CHANGE *change_new(loff_t pos, int size)
+{
+    CHANGE *new;
+    int levels = 1;
+
+    /* each level holds about a quarter of the changes of the one below.
+       The low bits of an LCG repeat quickly, so take two bits per level
+       from bit 16 up; 16 + 2 * CHANGE_LEVELS stays below 64. */
+    change_seed = change_seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    while (levels < CHANGE_LEVELS && !((change_seed >> (16 + 2 * levels)) & 3))
+	levels++;
+    new = alloc(sizeof(CHANGE) + (levels - 1) * sizeof(CHANGE *));
+    new->pos = pos;
+    new->data = alloc(new->alloced = new->size = size);
+    new->levels = levels;
+    return new;
+}
+
+/* Makes room for SIZE bytes of data in THIS. It grows geometrically, as
+   FAT entries and directories are often written in order. */
+
+static void change_reserve(CHANGE * this, int size)
+{
+    if (size <= this->alloced)
+	return;
+    this->alloced = size * 2;
+    if (!(this->data = realloc(this->data, this->alloced)))
+	pdie("realloc");
+}
+
+/* Copies the part of THIS that overlaps [POS, POS + SIZE) into DATA. */
+
+static void change_copy(CHANGE * this, loff_t pos, int size, void *data)
+{
+    loff_t from = this->pos > pos ? this->pos : pos;
+    loff_t to = this->pos + this->size < pos + size ?
+	this->pos + this->size : pos + size;
+
+    if (from < to)
+	memcpy((char *)data + (from - pos),
+	       (char *)this->data + (from - this->pos), to - from);
+}
+
 /**
  * Read data from the partition, accounting for any pending updates that are
  * queued for writing.
@@ -119,7 +216,7 @@ void fs_open(char *path, int rw)
  */
 void fs_read(loff_t pos, int size, void *data)
 {
-    CHANGE *walk;
+    CHANGE *prev[CHANGE_LEVELS], *walk;
     int got;
 
     if (llseek(fd, pos, 0) != pos)
@@ -128,18 +225,12 @@ void fs_read(loff_t pos, int size, void *data)
 	pdie("Read %d bytes at %lld", size, pos);
     if (got != size)
 	die("Got %d bytes instead of %d at %lld", got, size, pos);
-    for (walk = changes; walk; walk = walk->next) {
-	if (walk->pos < pos + size && walk->pos + walk->size > pos) {
-	    if (walk->pos < pos)
-		memcpy(data, (char *)walk->data + pos - walk->pos, min(size,
-								       walk->size
-								       - pos +
-								       walk->pos));
-	    else
-		memcpy((char *)data + walk->pos - pos, walk->data,
-		       min(walk->size, size + pos - walk->pos));
-	}
-    }
+    walk = change_find(pos, prev);
+    /* the change starting before POS may still reach into it */
+    if (prev[0])
+	change_copy(prev[0], pos, size, data);
+    for (; walk && walk->pos < pos + size; walk = walk->next[0])
+	change_copy(walk, pos, size, data);
 }
 
 int fs_test(loff_t pos, int size)
@@ -157,8 +248,9 @@ int fs_test(loff_t pos, int size)
 
 void fs_write(loff_t pos, int size, void *data)
 {
-    CHANGE *new;
-    int did;
+    CHANGE *prev[CHANGE_LEVELS], *this, *walk;
+    loff_t end = pos + size;
+    int did, i;
 
     if (write_immed) {
 	did_change = 1;
@@ -170,15 +262,35 @@ void fs_write(loff_t pos, int size, void *data)
 	    pdie("Write %d bytes at %lld", size, pos);
 	die("Wrote %d bytes instead of %d at %lld", did, size, pos);
     }
-    new = alloc(sizeof(CHANGE));
-    new->pos = pos;
-    memcpy(new->data = alloc(new->size = size), data, size);
-    new->next = NULL;
-    if (last)
-	last->next = new;
-    else
-	changes = new;
-    last = new;
+    change_find(pos, prev);
+    this = prev[0];
+    if (this && this->pos + this->size >= pos) {
+	/* extend the change that starts before and touches the new data */
+	if (this->pos + this->size >= end) {
+	    memcpy((char *)this->data + (pos - this->pos), data, size);
+	    return;
+	}
+    } else {
+	this = change_new(pos, size);
+	this->size = 0;
+	change_insert(this, prev);
+	for (i = 0; i < this->levels; i++)
+	    prev[i] = this;
+    }
+
+    /* absorb the changes that overlap or adjoin the new data */
+    while ((walk = this->next[0]) && walk->pos <= end) {
+	if (walk->pos + walk->size > end)
+	    end = walk->pos + walk->size;
+	change_reserve(this, end - this->pos);
+	memcpy((char *)this->data + (walk->pos - this->pos), walk->data,
+	       walk->size);
+	change_remove(walk, prev);
+    }
+    change_reserve(this, end - this->pos);
+    if (end - this->pos > this->size)
+	this->size = end - this->pos;
+    memcpy((char *)this->data + (pos - this->pos), data, size);
 }
 
 static void fs_flush(void)
@@ -186,9 +298,11 @@ static void fs_flush(void)
     CHANGE *this;
     int size;
 
-    while (changes) {
-	this = changes;
-	changes = changes->next;
+    /* changes are sorted and already merged, so the writes are as large
+       and as sequential as they can be */
+    while (changes[0]) {
+	this = changes[0];
+	changes[0] = this->next[0];
 	if (llseek(fd, this->pos, 0) != this->pos)
 	    fprintf(stderr,
 		    "Seek to %lld failed: %s\n  Did not write %d bytes.\n",
@@ -202,6 +316,7 @@ static void fs_flush(void)
 	free(this->data);
 	free(this);
     }
+    memset(changes, 0, sizeof(changes));
 }
 
 int fs_close(int write)
@@ -209,16 +324,18 @@ int fs_close(int write)
     CHANGE *next;
     int changed;
 
-    changed = ! !changes;
+    changed = ! !changes[0];
     if (write)
 	fs_flush();
-    else
-	while (changes) {
-	    next = changes->next;
-	    free(changes->data);
-	    free(changes);
-	    changes = next;
+    else {
+	while (changes[0]) {
+	    next = changes[0]->next[0];
+	    free(changes[0]->data);
+	    free(changes[0]);
+	    changes[0] = next;
 	}
+	memset(changes, 0, sizeof(changes));
+    }
     if (close(fd) < 0)
 	pdie("closing file system");
     return changed || did_change;
@@ -226,5 +343,5 @@ int fs_close(int write)
 
 int fs_changed(void)
 {
-    return ! !changes || did_change;
+    return ! !changes[0] || did_change;
 }
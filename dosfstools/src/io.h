@@ -50,8 +50,8 @@ int fs_test(loff_t pos, int size);
 void fs_write(loff_t pos, int size, void *data);
 
 /* If write_immed is non-zero, SIZE bytes are written from DATA to the disk,
-   starting at POS. If write_immed is zero, the change is added to a list in
-   memory. */
+   starting at POS. If write_immed is zero, the change is merged into the
+   sorted map of pending changes kept in memory. */
 
 int fs_close(int write);
 
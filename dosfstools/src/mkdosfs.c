@@ -108,6 +108,19 @@
 #define TEST_BUFFER_BLOCKS 16
 #define HARD_SECTOR_SIZE   512
 #define SECTORS_PER_BLOCK ( BLOCK_SIZE / HARD_SECTOR_SIZE )
+#define BLANK_SIZE (1024 * 1024)	/* Zeroes written per call, a multiple of any sector size */
+
+/* Not all C libraries export these */
+
+#ifndef BLKDISCARD
+#define BLKDISCARD _IO(0x12,119)
+#endif
+#ifndef BLKFLSBUF
+#define BLKFLSBUF _IO(0x12,97)
+#endif
+#ifndef BLKZEROOUT
+#define BLKZEROOUT _IO(0x12,127)
+#endif
 
 /* Macro definitions */
 
@@ -305,7 +318,7 @@ static struct msdos_dir_entry *root_dir;	/* Root directory */
 static int size_root_dir;	/* Size of the root directory in bytes */
 static int sectors_per_cluster = 0;	/* Number of sectors per disk cluster */
 static int root_dir_entries = 0;	/* Number of root directory entries */
-static char *blank_sector;	/* Blank sector - all zeros */
+static char *blank_sector;	/* BLANK_SIZE bytes of zeros */
 static int hidden_sectors = 0;	/* Number of hidden sectors */
 static int malloc_entire_fat = FALSE;	/* Whether we should malloc() the entire FAT or not */
 static int align_structures = TRUE;	/* Whether to enforce alignment */
@@ -1291,9 +1304,9 @@ static void setup_tables(void)
 	*(__u16 *) (info_sector + 0x1fe) = CT_LE_W(BOOT_SIGN);
     }
 
-    if (!(blank_sector = malloc(sector_size)))
+    if (!(blank_sector = malloc(BLANK_SIZE)))
 	die("Out of memory");
-    memset(blank_sector, 0, sector_size);
+    memset(blank_sector, 0, BLANK_SIZE);
 }
 
 /* Write the new filesystem's data tables to wherever they're going to end up! */
@@ -1320,6 +1333,60 @@ static void setup_tables(void)
 	error ("failed whilst writing " errstr);	\
   } while(0)
 
+/* BLKDISCARD and BLKZEROOUT bypass the buffer cache, which older kernels
+   leave as it was.  Write back what is dirty and drop the rest, so that
+   neither stale nor partially written blocks land on the erased range */
+
+static void flush_device(void)
+{
+    fsync(dev);
+    ioctl(dev, BLKFLSBUF, 0);
+}
+
+/* Tell a block device that the whole new filesystem is unused, which lets
+   flash media start from clean erase blocks.  This is only a hint: the
+   discarded range is not trusted to read back as zeros */
+
+static void discard_device(void)
+{
+    struct stat statbuf;
+    unsigned long long range[2];
+
+    if (fstat(dev, &statbuf) < 0 || !S_ISBLK(statbuf.st_mode))
+	return;
+    range[0] = 0;
+    range[1] = blocks * BLOCK_SIZE;
+    flush_device();
+    if (ioctl(dev, BLKDISCARD, &range) >= 0)
+	flush_device();
+}
+
+/* Zero SIZE bytes from the current position, letting the device do it
+   itself when it can */
+
+static int write_blank(loff_t size)
+{
+    loff_t pos = llseek(dev, 0, SEEK_CUR);
+    unsigned long long range[2];
+    int chunk;
+
+    range[0] = pos;
+    range[1] = size;
+    if (pos >= 0 && pos % 512 == 0 && size % 512 == 0) {
+	flush_device();
+	if (ioctl(dev, BLKZEROOUT, &range) >= 0) {
+	    flush_device();
+	    return llseek(dev, pos + size, SEEK_SET) == pos + size ? 0 : -1;
+	}
+    }
+    for (; size > 0; size -= chunk) {
+	chunk = size < BLANK_SIZE ? size : BLANK_SIZE;
+	if (write(dev, blank_sector, chunk) != chunk)
+	    return -1;
+    }
+    return 0;
+}
+
 static void write_tables(void)
 {
     int x;
@@ -1328,10 +1395,11 @@ static void write_tables(void)
     fat_length = (size_fat == 32) ?
 	CF_LE_L(bs.fat32.fat32_length) : CF_LE_W(bs.fat_length);
 
+    discard_device();
     seekto(0, "start of device");
     /* clear all reserved sectors */
-    for (x = 0; x < reserved_sectors; ++x)
-	writebuf(blank_sector, sector_size, "reserved sector");
+    if (write_blank((loff_t)reserved_sectors * sector_size) < 0)
+	error("failed whilst writing reserved sector");
     /* seek back to sector 0 and write the boot sector */
     seekto(0, "boot sector");
     writebuf((char *)&bs, sizeof(struct msdos_boot_sector), "boot sector");
@@ -1348,11 +1416,10 @@ static void write_tables(void)
     /* seek to start of FATS and write them all */
     seekto(reserved_sectors * sector_size, "first FAT");
     for (x = 1; x <= nr_fats; x++) {
-	int y;
 	int blank_fat_length = fat_length - alloced_fat_length;
 	writebuf(fat, alloced_fat_length * sector_size, "FAT");
-	for (y = 0; y < blank_fat_length; y++)
-	    writebuf(blank_sector, sector_size, "FAT");
+	if (write_blank((loff_t)blank_fat_length * sector_size) < 0)
+	    error("failed whilst writing FAT");
     }
     /* Write the root directory directly after the last FAT. This is the root
      * dir area on FAT12/16, and the first cluster on FAT32. */
@@ -32,6 +32,7 @@
 #include <limits.h>
 #include <sys/types.h>
 #include <pwd.h>
+#include <pthread.h>
 #include <unistd.h>
 
 #define exfat_debug(format, ...)
@@ -45,6 +46,17 @@ const char* default_options = "ro_fallback,allow_other,blkdev,big_writes,"
 
 struct exfat ef;
 
+/*
+   Requests are served by several threads. Everything that looks up, creates
+   or removes nodes takes ef_lock, which protects the node tree and reference
+   counters. Reads and writes of an open file take only that node's lock, so
+   transfers to different files run in parallel. Metadata operations that may
+   touch an open node take its lock after ef_lock; nothing else ever holds
+   more than one node lock. libexfat serializes the cluster allocator and the
+   FAT cache internally.
+*/
+static pthread_mutex_t ef_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static struct exfat_node* get_node(const struct fuse_file_info* fi)
 {
 	return (struct exfat_node*) (size_t) fi->fh;
@@ -62,13 +74,17 @@ static int fuse_exfat_getattr(const char* path, struct stat* stbuf)
 
 	exfat_debug("[%s] %s", __func__, path);
 
+	pthread_mutex_lock(&ef_lock);
 	rc = exfat_lookup(&ef, &node, path);
-	if (rc != 0)
-		return rc;
-
-	exfat_stat(&ef, node, stbuf);
-	exfat_put_node(&ef, node);
-	return 0;
+	if (rc == 0)
+	{
+		pthread_mutex_lock(&node->lock);
+		exfat_stat(&ef, node, stbuf);
+		pthread_mutex_unlock(&node->lock);
+		exfat_put_node(&ef, node);
+	}
+	pthread_mutex_unlock(&ef_lock);
+	return rc;
 }
 
 static int fuse_exfat_truncate(const char* path, off64_t size)
@@ -78,12 +94,16 @@ static int fuse_exfat_truncate(const char* path, off64_t size)
 
 	exfat_debug("[%s] %s, %"PRId64, __func__, path, size);
 
+	pthread_mutex_lock(&ef_lock);
 	rc = exfat_lookup(&ef, &node, path);
-	if (rc != 0)
-		return rc;
-
-	rc = exfat_truncate(&ef, node, size, true);
-	exfat_put_node(&ef, node);
+	if (rc == 0)
+	{
+		pthread_mutex_lock(&node->lock);
+		rc = exfat_truncate(&ef, node, size, true);
+		pthread_mutex_unlock(&node->lock);
+		exfat_put_node(&ef, node);
+	}
+	pthread_mutex_unlock(&ef_lock);
 	return rc;
 }
 
@@ -98,12 +118,17 @@ static int fuse_exfat_readdir(const char* path, void* buffer,
 
 	exfat_debug("[%s] %s", __func__, path);
 
+	pthread_mutex_lock(&ef_lock);
 	rc = exfat_lookup(&ef, &parent, path);
 	if (rc != 0)
+	{
+		pthread_mutex_unlock(&ef_lock);
 		return rc;
+	}
 	if (!(parent->flags & EXFAT_ATTRIB_DIR))
 	{
 		exfat_put_node(&ef, parent);
+		pthread_mutex_unlock(&ef_lock);
 		exfat_error("`%s' is not a directory (0x%x)", path, parent->flags);
 		return -ENOTDIR;
 	}
@@ -115,6 +140,7 @@ static int fuse_exfat_readdir(const char* path, void* buffer,
 	if (rc != 0)
 	{
 		exfat_put_node(&ef, parent);
+		pthread_mutex_unlock(&ef_lock);
 		exfat_error("failed to open directory `%s'", path);
 		return rc;
 	}
@@ -129,6 +155,7 @@ static int fuse_exfat_readdir(const char* path, void* buffer,
 	}
 	exfat_closedir(&ef, &it);
 	exfat_put_node(&ef, parent);
+	pthread_mutex_unlock(&ef_lock);
 	return 0;
 }
 
@@ -139,7 +166,9 @@ static int fuse_exfat_open(const char* path, struct fuse_file_info* fi)
 
 	exfat_debug("[%s] %s", __func__, path);
 
+	pthread_mutex_lock(&ef_lock);
 	rc = exfat_lookup(&ef, &node, path);
+	pthread_mutex_unlock(&ef_lock);
 	if (rc != 0)
 		return rc;
 	set_node(fi, node);
@@ -150,20 +179,27 @@ static int fuse_exfat_open(const char* path, struct fuse_file_info* fi)
 static int fuse_exfat_release(const char* path, struct fuse_file_info* fi)
 {
 	exfat_debug("[%s] %s", __func__, path);
+	/* the last reference is dropped only when no I/O is left on the node */
+	pthread_mutex_lock(&ef_lock);
 	exfat_put_node(&ef, get_node(fi));
+	pthread_mutex_unlock(&ef_lock);
 	return 0;
 }
 
 static int fuse_exfat_fsync(const char* path, int datasync,
 		struct fuse_file_info *fi)
 {
+	struct exfat_node* node = get_node(fi);
 	int rc;
 
 	exfat_debug("[%s] %s", __func__, path);
-	rc = exfat_flush_node(&ef, get_node(fi));
-	if (rc != 0)
-		return rc;
-	rc = exfat_flush(&ef);
+	pthread_mutex_lock(&ef_lock);
+	pthread_mutex_lock(&node->lock);
+	rc = exfat_flush_node(&ef, node);
+	pthread_mutex_unlock(&node->lock);
+	if (rc == 0)
+		rc = exfat_flush(&ef);
+	pthread_mutex_unlock(&ef_lock);
 	if (rc != 0)
 		return rc;
 	return exfat_fsync(ef.dev);
@@ -172,10 +208,13 @@ static int fuse_exfat_fsync(const char* path, int datasync,
 static int fuse_exfat_read(const char* path, char* buffer, size_t size,
 		off64_t offset, struct fuse_file_info* fi)
 {
+	struct exfat_node* node = get_node(fi);
 	ssize_t ret;
 
 	exfat_debug("[%s] %s (%zu bytes)", __func__, path, size);
-	ret = exfat_generic_pread(&ef, get_node(fi), buffer, size, offset);
+	pthread_mutex_lock(&node->lock);
+	ret = exfat_generic_pread(&ef, node, buffer, size, offset);
+	pthread_mutex_unlock(&node->lock);
 	if (ret < 0)
 		return -EIO;
 	return ret;
@@ -184,10 +223,13 @@ static int fuse_exfat_read(const char* path, char* buffer, size_t size,
 static int fuse_exfat_write(const char* path, const char* buffer, size_t size,
 		off64_t offset, struct fuse_file_info* fi)
 {
+	struct exfat_node* node = get_node(fi);
 	ssize_t ret;
 
 	exfat_debug("[%s] %s (%zu bytes)", __func__, path, size);
-	ret = exfat_generic_pwrite(&ef, get_node(fi), buffer, size, offset);
+	pthread_mutex_lock(&node->lock);
+	ret = exfat_generic_pwrite(&ef, node, buffer, size, offset);
+	pthread_mutex_unlock(&node->lock);
 	if (ret < 0)
 		return -EIO;
 	return ret;
@@ -200,12 +242,16 @@ static int fuse_exfat_unlink(const char* path)
 
 	exfat_debug("[%s] %s", __func__, path);
 
+	pthread_mutex_lock(&ef_lock);
 	rc = exfat_lookup(&ef, &node, path);
-	if (rc != 0)
-		return rc;
-
-	rc = exfat_unlink(&ef, node);
-	exfat_put_node(&ef, node);
+	if (rc == 0)
+	{
+		pthread_mutex_lock(&node->lock);
+		rc = exfat_unlink(&ef, node);
+		pthread_mutex_unlock(&node->lock);
+		exfat_put_node(&ef, node);
+	}
+	pthread_mutex_unlock(&ef_lock);
 	return rc;
 }
 
@@ -216,31 +262,77 @@ static int fuse_exfat_rmdir(const char* path)
 
 	exfat_debug("[%s] %s", __func__, path);
 
+	pthread_mutex_lock(&ef_lock);
 	rc = exfat_lookup(&ef, &node, path);
-	if (rc != 0)
-		return rc;
-
-	rc = exfat_rmdir(&ef, node);
-	exfat_put_node(&ef, node);
+	if (rc == 0)
+	{
+		pthread_mutex_lock(&node->lock);
+		rc = exfat_rmdir(&ef, node);
+		pthread_mutex_unlock(&node->lock);
+		exfat_put_node(&ef, node);
+	}
+	pthread_mutex_unlock(&ef_lock);
 	return rc;
 }
 
 static int fuse_exfat_mknod(const char* path, mode_t mode, dev_t dev)
 {
+	int rc;
+
 	exfat_debug("[%s] %s 0%ho", __func__, path, mode);
-	return exfat_mknod(&ef, path);
+	pthread_mutex_lock(&ef_lock);
+	rc = exfat_mknod(&ef, path);
+	pthread_mutex_unlock(&ef_lock);
+	return rc;
 }
 
 static int fuse_exfat_mkdir(const char* path, mode_t mode)
 {
+	int rc;
+
 	exfat_debug("[%s] %s 0%ho", __func__, path, mode);
-	return exfat_mkdir(&ef, path);
+	pthread_mutex_lock(&ef_lock);
+	rc = exfat_mkdir(&ef, path);
+	pthread_mutex_unlock(&ef_lock);
+	return rc;
 }
 
 static int fuse_exfat_rename(const char* old_path, const char* new_path)
 {
+	struct exfat_node* node;
+	struct exfat_node* existing = NULL;
+	int rc;
+
 	exfat_debug("[%s] %s => %s", __func__, old_path, new_path);
-	return exfat_rename(&ef, old_path, new_path);
+
+	/* rename rewrites the entries of both nodes from their in-memory state */
+	pthread_mutex_lock(&ef_lock);
+	rc = exfat_lookup(&ef, &node, old_path);
+	if (rc != 0)
+	{
+		pthread_mutex_unlock(&ef_lock);
+		return rc;
+	}
+	if (exfat_lookup(&ef, &existing, new_path) != 0)
+		existing = NULL;
+	else if (existing == node)
+	{
+		exfat_put_node(&ef, existing);
+		existing = NULL;
+	}
+	pthread_mutex_lock(&node->lock);
+	if (existing != NULL)
+		pthread_mutex_lock(&existing->lock);
+	rc = exfat_rename(&ef, old_path, new_path);
+	if (existing != NULL)
+	{
+		pthread_mutex_unlock(&existing->lock);
+		exfat_put_node(&ef, existing);
+	}
+	pthread_mutex_unlock(&node->lock);
+	exfat_put_node(&ef, node);
+	pthread_mutex_unlock(&ef_lock);
+	return rc;
 }
 
 static int fuse_exfat_utimens(const char* path, const struct timespec tv[2])
@@ -250,13 +342,17 @@ static int fuse_exfat_utimens(const char* path, const struct timespec tv[2])
 
 	exfat_debug("[%s] %s", __func__, path);
 
+	pthread_mutex_lock(&ef_lock);
 	rc = exfat_lookup(&ef, &node, path);
-	if (rc != 0)
-		return rc;
-
-	exfat_utimes(node, tv);
-	exfat_put_node(&ef, node);
-	return 0;
+	if (rc == 0)
+	{
+		pthread_mutex_lock(&node->lock);
+		exfat_utimes(node, tv);
+		pthread_mutex_unlock(&node->lock);
+		exfat_put_node(&ef, node);
+	}
+	pthread_mutex_unlock(&ef_lock);
+	return rc;
 }
 
 static int fuse_exfat_chmod(const char* path, mode_t mode)
@@ -550,7 +646,7 @@ int main(int argc, char* argv[])
 	   main loop */
 	if (fuse_daemonize(debug) == 0)
 	{
-		if (fuse_loop(fh) != 0)
+		if (fuse_loop_mt(fh) != 0)
 			exfat_error("FUSE loop failure");
 	}
 	else
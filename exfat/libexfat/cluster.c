@@ -70,10 +70,149 @@ static uint32_t bytes2clusters(const struct exfat* ef, uint64_t bytes)
 	return (bytes + cluster_size - 1) / cluster_size;
 }
 
+/*
+ * FAT cache: the FAT is read in pages which are kept in a small LRU set,
+ * so following a fragmented chain does not cost a device read per hop.
+ * FAT updates go through set_next_cluster(), which writes them through to
+ * any cached page. The cache has its own lock as it is shared by every
+ * node being read or written.
+ */
+#define FAT_CACHE_PAGES 16
+#define FAT_CACHE_PAGE_SIZE 32768
+#define FAT_CACHE_PAGE_ENTRIES (FAT_CACHE_PAGE_SIZE / sizeof(cluster_t))
+
+struct exfat_fat_page
+{
+	uint32_t index;				/* page number within the FAT */
+	uint32_t stamp;				/* last use, for LRU eviction */
+	le32_t* entries;			/* NULL while the slot is unused */
+};
+
+struct exfat_fat_cache
+{
+	pthread_mutex_t lock;
+	struct exfat_fat_page pages[FAT_CACHE_PAGES];
+	uint32_t stamp;
+	uint64_t fat_size;			/* in bytes */
+};
+
+void exfat_init_fat_cache(struct exfat* ef)
+{
+	ef->fat_cache = calloc(1, sizeof(struct exfat_fat_cache));
+	if (ef->fat_cache == NULL)
+	{
+		exfat_warn("failed to allocate FAT cache");
+		return;
+	}
+	ef->fat_cache->fat_size = s2o(ef, le32_to_cpu(ef->sb->fat_sector_count));
+	pthread_mutex_init(&ef->fat_cache->lock, NULL);
+}
+
+void exfat_free_fat_cache(struct exfat* ef)
+{
+	int i;
+
+	if (ef->fat_cache == NULL)
+		return;
+	for (i = 0; i < FAT_CACHE_PAGES; i++)
+		free(ef->fat_cache->pages[i].entries);
+	free(ef->fat_cache);
+	ef->fat_cache = NULL;
+}
+
+static struct exfat_fat_page* find_fat_page(const struct exfat* ef,
+		cluster_t cluster)
+{
+	struct exfat_fat_cache* fc = ef->fat_cache;
+	const uint32_t index = cluster / FAT_CACHE_PAGE_ENTRIES;
+	int i;
+
+	for (i = 0; i < FAT_CACHE_PAGES; i++)
+		if (fc->pages[i].entries != NULL && fc->pages[i].index == index)
+			return &fc->pages[i];
+	return NULL;
+}
+
+static struct exfat_fat_page* load_fat_page(const struct exfat* ef,
+		cluster_t cluster)
+{
+	struct exfat_fat_cache* fc = ef->fat_cache;
+	struct exfat_fat_page* page = &fc->pages[0];
+	const uint32_t index = cluster / FAT_CACHE_PAGE_ENTRIES;
+	const uint64_t start = (uint64_t) index * FAT_CACHE_PAGE_SIZE;
+	int i;
+
+	if (start >= fc->fat_size)
+		return NULL;
+	/* take an unused slot or the least recently used one */
+	for (i = 0; i < FAT_CACHE_PAGES; i++)
+	{
+		if (fc->pages[i].entries == NULL)
+		{
+			page = &fc->pages[i];
+			break;
+		}
+		if (fc->pages[i].stamp < page->stamp)
+			page = &fc->pages[i];
+	}
+	if (page->entries == NULL)
+	{
+		page->entries = malloc(FAT_CACHE_PAGE_SIZE);
+		if (page->entries == NULL)
+			return NULL;
+	}
+	memset(page->entries, 0, FAT_CACHE_PAGE_SIZE);
+	if (exfat_pread(ef->dev, page->entries,
+			MIN(FAT_CACHE_PAGE_SIZE, fc->fat_size - start),
+			s2o(ef, le32_to_cpu(ef->sb->fat_sector_start)) + start) < 0)
+	{
+		free(page->entries);
+		page->entries = NULL;
+		return NULL;
+	}
+	page->index = index;
+	return page;
+}
+
+static bool get_cached_next(const struct exfat* ef, cluster_t cluster,
+		cluster_t* next)
+{
+	struct exfat_fat_page* page;
+
+	if (ef->fat_cache == NULL)
+		return false;
+	pthread_mutex_lock(&ef->fat_cache->lock);
+	page = find_fat_page(ef, cluster);
+	if (page == NULL)
+		page = load_fat_page(ef, cluster);
+	if (page != NULL)
+	{
+		page->stamp = ++ef->fat_cache->stamp;
+		*next = le32_to_cpu(page->entries[cluster % FAT_CACHE_PAGE_ENTRIES]);
+	}
+	pthread_mutex_unlock(&ef->fat_cache->lock);
+	return page != NULL;
+}
+
+static void set_cached_next(const struct exfat* ef, cluster_t current,
+		cluster_t next)
+{
+	struct exfat_fat_page* page;
+
+	if (ef->fat_cache == NULL)
+		return;
+	pthread_mutex_lock(&ef->fat_cache->lock);
+	page = find_fat_page(ef, current);
+	if (page != NULL)
+		page->entries[current % FAT_CACHE_PAGE_ENTRIES] = cpu_to_le32(next);
+	pthread_mutex_unlock(&ef->fat_cache->lock);
+}
+
 cluster_t exfat_next_cluster(const struct exfat* ef,
 		const struct exfat_node* node, cluster_t cluster)
 {
 	le32_t next;
+	cluster_t cached;
 	off64_t fat_offset;
 
 	if (cluster < EXFAT_FIRST_DATA_CLUSTER)
@@ -81,6 +220,8 @@ cluster_t exfat_next_cluster(const struct exfat* ef,
 
 	if (IS_CONTIGUOUS(*node))
 		return cluster + 1;
+	if (get_cached_next(ef, cluster, &cached))
+		return cached;
 	fat_offset = s2o(ef, le32_to_cpu(ef->sb->fat_sector_start))
 		+ cluster * sizeof(cluster_t);
 	/* FIXME handle I/O error */
@@ -89,55 +230,179 @@ cluster_t exfat_next_cluster(const struct exfat* ef,
 	return le32_to_cpu(next);
 }
 
+/*
+ * Extent map: the part of a fragmented file's chain that has been walked
+ * is remembered as runs of consecutive clusters, so seeking anywhere
+ * within it is a binary search instead of a walk from the first cluster.
+ * It only ever describes a prefix of the chain and is dropped when the
+ * file shrinks.
+ */
+void exfat_free_extents(struct exfat_node* node)
+{
+	free(node->extents);
+	node->extents = NULL;
+	node->extents_count = 0;
+	node->extents_size = 0;
+	node->extents_mapped = 0;
+}
+
+static bool add_extent(struct exfat_node* node, uint32_t index,
+		cluster_t cluster)
+{
+	struct exfat_extent* last = NULL;
+
+	if (node->extents_count != 0)
+		last = &node->extents[node->extents_count - 1];
+	if (last != NULL && last->cluster + last->count == cluster)
+	{
+		last->count++;
+		node->extents_mapped++;
+		return true;
+	}
+	if (node->extents_count == node->extents_size)
+	{
+		uint32_t size = node->extents_size ? node->extents_size * 2 : 8;
+		struct exfat_extent* extents = realloc(node->extents,
+				size * sizeof(struct exfat_extent));
+
+		if (extents == NULL)
+			return false;
+		node->extents = extents;
+		node->extents_size = size;
+	}
+	last = &node->extents[node->extents_count++];
+	last->index = index;
+	last->cluster = cluster;
+	last->count = 1;
+	node->extents_mapped++;
+	return true;
+}
+
+static cluster_t lookup_extent(const struct exfat_node* node, uint32_t index)
+{
+	uint32_t lo = 0, hi = node->extents_count;
+
+	while (hi - lo > 1)
+	{
+		uint32_t mid = (lo + hi) / 2;
+		if (node->extents[mid].index <= index)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return node->extents[lo].cluster + (index - node->extents[lo].index);
+}
+
 cluster_t exfat_advance_cluster(const struct exfat* ef,
 		struct exfat_node* node, uint32_t count)
 {
 	uint32_t i;
+	cluster_t cluster;
+	bool mapping = true;
+
+	if (IS_CONTIGUOUS(*node) || count == 0
+			|| CLUSTER_INVALID(node->start_cluster))
+	{
+		if (node->fptr_index > count)
+		{
+			node->fptr_index = 0;
+			node->fptr_cluster = node->start_cluster;
+		}
+
+		for (i = node->fptr_index; i < count; i++)
+		{
+			node->fptr_cluster = exfat_next_cluster(ef, node,
+					node->fptr_cluster);
+			if (CLUSTER_INVALID(node->fptr_cluster))
+				break; /* the caller should handle this and print appropriate
+				          error message */
+		}
+		node->fptr_index = count;
+		return node->fptr_cluster;
+	}
 
-	if (node->fptr_index > count)
+	if (node->extents_mapped == 0)
+		mapping = add_extent(node, 0, node->start_cluster);
+	if (mapping && count < node->extents_mapped)
 	{
-		node->fptr_index = 0;
-		node->fptr_cluster = node->start_cluster;
+		node->fptr_cluster = lookup_extent(node, count);
+		node->fptr_index = count;
+		return node->fptr_cluster;
 	}
 
-	for (i = node->fptr_index; i < count; i++)
+	/* continue from the end of the map (or the closest known position if
+	   the map could not be grown) */
+	if (mapping)
+	{
+		i = node->extents_mapped - 1;
+		cluster = lookup_extent(node, i);
+	}
+	else if (node->fptr_index <= count)
 	{
-		node->fptr_cluster = exfat_next_cluster(ef, node, node->fptr_cluster);
-		if (CLUSTER_INVALID(node->fptr_cluster))
-			break; /* the caller should handle this and print appropriate 
+		i = node->fptr_index;
+		cluster = node->fptr_cluster;
+	}
+	else
+	{
+		i = 0;
+		cluster = node->start_cluster;
+	}
+	for (; i < count; i++)
+	{
+		cluster = exfat_next_cluster(ef, node, cluster);
+		if (CLUSTER_INVALID(cluster))
+			break; /* the caller should handle this and print appropriate
 			          error message */
+		if (mapping)
+			mapping = add_extent(node, i + 1, cluster);
 	}
 	node->fptr_index = count;
-	return node->fptr_cluster;
+	node->fptr_cluster = cluster;
+	return cluster;
 }
 
-static cluster_t find_bit_and_set(bitmap_t* bitmap, size_t start, size_t end)
+#define BMAP_BITS (sizeof(bitmap_t) * 8)
+
+/*
+ * Returns the index of the first bit in [start, end) that is set (or clear
+ * if value is false), or end if there is none. Whole words are tested at
+ * once and the bit is located with count-trailing-zeros.
+ */
+static size_t find_bit(const bitmap_t* bitmap, size_t start, size_t end,
+		bool value)
 {
-	const size_t start_index = start / sizeof(bitmap_t) / 8;
-	const size_t end_index = DIV_ROUND_UP(end, sizeof(bitmap_t) * 8);
 	size_t i;
-	size_t start_bitindex;
-	size_t end_bitindex;
-	size_t c;
-
-	for (i = start_index; i < end_index; i++)
+	bitmap_t word;
+
+	if (start >= end)
+		return end;
+	i = start / BMAP_BITS;
+	word = (value ? bitmap[i] : ~bitmap[i]) &
+			(~(bitmap_t) 0 << (start % BMAP_BITS));
+	while (word == 0)
 	{
-		if (bitmap[i] == ~((bitmap_t) 0))
-			continue;
-		start_bitindex = MAX(i * sizeof(bitmap_t) * 8, start);
-		end_bitindex = MIN((i + 1) * sizeof(bitmap_t) * 8, end);
-		for (c = start_bitindex; c < end_bitindex; c++)
-			if (BMAP_GET(bitmap, c) == 0)
-			{
-				BMAP_SET(bitmap, c);
-				return c + EXFAT_FIRST_DATA_CLUSTER;
-			}
+		if (++i * BMAP_BITS >= end)
+			return end;
+		word = value ? bitmap[i] : ~bitmap[i];
 	}
-	return EXFAT_CLUSTER_END;
+	return MIN(i * BMAP_BITS + __builtin_ctzl(word), end);
+}
+
+static cluster_t find_bit_and_set(bitmap_t* bitmap, size_t start, size_t end)
+{
+	const size_t c = find_bit(bitmap, start, end, false);
+
+	if (c >= end)
+		return EXFAT_CLUSTER_END;
+	BMAP_SET(bitmap, c);
+	return c + EXFAT_FIRST_DATA_CLUSTER;
 }
 
 int exfat_flush(struct exfat* ef)
 {
+	int rc = 0;
+
+	pthread_mutex_lock(&ef->cmap.lock);
 	if (ef->cmap.dirty)
 	{
 		if (exfat_pwrite(ef->dev, ef->cmap.chunk,
@@ -145,11 +410,13 @@ int exfat_flush(struct exfat* ef)
 				exfat_c2o(ef, ef->cmap.start_cluster)) < 0)
 		{
 			exfat_error("failed to write clusters bitmap");
-			return -EIO;
+			rc = -EIO;
 		}
-		ef->cmap.dirty = false;
+		else
+			ef->cmap.dirty = false;
 	}
-	return 0;
+	pthread_mutex_unlock(&ef->cmap.lock);
+	return rc;
 }
 
 static bool set_next_cluster(const struct exfat* ef, bool contiguous,
@@ -169,6 +436,7 @@ static bool set_next_cluster(const struct exfat* ef, bool contiguous,
 				current);
 		return false;
 	}
+	set_cached_next(ef, current, next);
 	return true;
 }
 
@@ -193,6 +461,32 @@ static cluster_t allocate_cluster(struct exfat* ef, cluster_t hint)
 	return cluster;
 }
 
+/*
+ * Allocates the first free cluster at or after hint and up to count - 1
+ * free clusters immediately following it. Returns the first cluster and
+ * stores the length of the run in *allocated.
+ */
+static cluster_t allocate_clusters(struct exfat* ef, cluster_t hint,
+		uint32_t count, uint32_t* allocated)
+{
+	cluster_t cluster;
+	size_t first, end;
+
+	*allocated = 0;
+	pthread_mutex_lock(&ef->cmap.lock);
+	cluster = allocate_cluster(ef, hint);
+	if (!CLUSTER_INVALID(cluster))
+	{
+		first = cluster - EXFAT_FIRST_DATA_CLUSTER;
+		end = find_bit(ef->cmap.chunk, first + 1,
+				MIN(first + count, ef->cmap.chunk_size), true);
+		for (*allocated = 1; first + *allocated < end; (*allocated)++)
+			BMAP_SET(ef->cmap.chunk, first + *allocated);
+	}
+	pthread_mutex_unlock(&ef->cmap.lock);
+	return cluster;
+}
+
 static void free_cluster(struct exfat* ef, cluster_t cluster)
 {
 	if (CLUSTER_INVALID(cluster))
@@ -201,18 +495,38 @@ static void free_cluster(struct exfat* ef, cluster_t cluster)
 		exfat_bug("freeing non-existing cluster 0x%x (0x%x)", cluster,
 				ef->cmap.size);
 
+	pthread_mutex_lock(&ef->cmap.lock);
 	BMAP_CLR(ef->cmap.chunk, cluster - EXFAT_FIRST_DATA_CLUSTER);
 	ef->cmap.dirty = true;
+	pthread_mutex_unlock(&ef->cmap.lock);
 }
 
+/*
+ * Chains clusters first..last one after another in the FAT, writing the
+ * entries in blocks rather than one at a time.
+ */
 static bool make_noncontiguous(const struct exfat* ef, cluster_t first,
 		cluster_t last)
 {
+	le32_t entries[1024];
+	const off64_t fat_start = s2o(ef, le32_to_cpu(ef->sb->fat_sector_start));
 	cluster_t c;
+	uint32_t i, n;
 
-	for (c = first; c < last; c++)
-		if (!set_next_cluster(ef, false, c, c + 1))
+	for (c = first; c < last; c += n)
+	{
+		n = MIN(last - c, sizeof(entries) / sizeof(entries[0]));
+		for (i = 0; i < n; i++)
+			entries[i] = cpu_to_le32(c + i + 1);
+		if (exfat_pwrite(ef->dev, entries, n * sizeof(le32_t),
+				fat_start + (off64_t) c * sizeof(cluster_t)) < 0)
+		{
+			exfat_error("failed to write the FAT chain from %#x", c);
 			return false;
+		}
+		for (i = 0; i < n; i++)
+			set_cached_next(ef, c + i, c + i + 1);
+	}
 	return true;
 }
 
@@ -225,6 +539,7 @@ static int grow_file(struct exfat* ef, struct exfat_node* node,
 	cluster_t previous;
 	cluster_t next;
 	uint32_t allocated = 0;
+	uint32_t run;
 
 	if (difference == 0)
 		exfat_bug("zero clusters count passed");
@@ -244,26 +559,28 @@ static int grow_file(struct exfat* ef, struct exfat_node* node,
 		if (node->fptr_index != 0)
 			exfat_bug("non-zero pointer index (%u)", node->fptr_index);
 		/* file does not have clusters (i.e. is empty), allocate
-		   the first one for it */
-		previous = allocate_cluster(ef, 0);
-		if (CLUSTER_INVALID(previous))
+		   the first run for it */
+		next = allocate_clusters(ef, 0, difference, &run);
+		if (CLUSTER_INVALID(next))
 			return -ENOSPC;
-		node->fptr_cluster = node->start_cluster = previous;
-		allocated = 1;
-		/* file consists of only one cluster, so it's contiguous */
+		node->fptr_cluster = node->start_cluster = next;
+		previous = next + run - 1;
+		allocated = run;
+		/* file consists of only one run, so it's contiguous */
 		node->flags |= EXFAT_ATTRIB_CONTIGUOUS;
 	}
 
 	while (allocated < difference)
 	{
-		next = allocate_cluster(ef, previous + 1);
+		next = allocate_clusters(ef, previous + 1, difference - allocated,
+				&run);
 		if (CLUSTER_INVALID(next))
 		{
 			if (allocated != 0)
 				shrink_file(ef, node, current + allocated, allocated);
 			return -ENOSPC;
 		}
-		if (next != previous - 1 && IS_CONTIGUOUS(*node))
+		if (next != previous + 1 && IS_CONTIGUOUS(*node))
 		{
 			/* it's a pity, but we are not able to keep the file contiguous
 			   anymore */
@@ -274,8 +591,11 @@ static int grow_file(struct exfat* ef, struct exfat_node* node,
 		}
 		if (!set_next_cluster(ef, IS_CONTIGUOUS(*node), previous, next))
 			return -EIO;
-		previous = next;
-		allocated++;
+		if (!IS_CONTIGUOUS(*node) &&
+				!make_noncontiguous(ef, next, next + run - 1))
+			return -EIO;
+		previous = next + run - 1;
+		allocated += run;
 	}
 
 	if (!set_next_cluster(ef, IS_CONTIGUOUS(*node), previous,
@@ -319,6 +639,7 @@ static int shrink_file(struct exfat* ef, struct exfat_node* node,
 	}
 	node->fptr_index = 0;
 	node->fptr_cluster = node->start_cluster;
+	exfat_free_extents(node);
 
 	/* free remaining clusters */
 	while (difference--)
@@ -420,13 +741,21 @@ int exfat_truncate(struct exfat* ef, struct exfat_node* node, uint64_t size,
 
 uint32_t exfat_count_free_clusters(const struct exfat* ef)
 {
-	uint32_t free_clusters = 0;
-	uint32_t i;
+	const size_t words = ef->cmap.size / BMAP_BITS;
+	const size_t tail = ef->cmap.size % BMAP_BITS;
+	pthread_mutex_t* lock = (pthread_mutex_t*) &ef->cmap.lock;
+	uint32_t used_clusters = 0;
+	size_t i;
 
-	for (i = 0; i < ef->cmap.size; i++)
-		if (BMAP_GET(ef->cmap.chunk, i) == 0)
-			free_clusters++;
-	return free_clusters;
+	pthread_mutex_lock(lock);
+	for (i = 0; i < words; i++)
+		used_clusters += __builtin_popcountl(ef->cmap.chunk[i]);
+	/* bits past the end of the bitmap are not clusters */
+	if (tail != 0)
+		used_clusters += __builtin_popcountl(ef->cmap.chunk[words] &
+				(((bitmap_t) 1 << tail) - 1));
+	pthread_mutex_unlock(lock);
+	return ef->cmap.size - used_clusters;
 }
 
 static int find_used_clusters(const struct exfat* ef,
@@ -435,19 +764,14 @@ static int find_used_clusters(const struct exfat* ef,
 	const cluster_t end = le32_to_cpu(ef->sb->cluster_count);
 
 	/* find first used cluster */
-	for (*a = *b + 1; *a < end; (*a)++)
-		if (BMAP_GET(ef->cmap.chunk, *a - EXFAT_FIRST_DATA_CLUSTER))
-			break;
+	*a = find_bit(ef->cmap.chunk, *b + 1 - EXFAT_FIRST_DATA_CLUSTER,
+			end - EXFAT_FIRST_DATA_CLUSTER, true) + EXFAT_FIRST_DATA_CLUSTER;
 	if (*a >= end)
 		return 1;
 
 	/* find last contiguous used cluster */
-	for (*b = *a; *b < end; (*b)++)
-		if (BMAP_GET(ef->cmap.chunk, *b - EXFAT_FIRST_DATA_CLUSTER) == 0)
-		{
-			(*b)--;
-			break;
-		}
+	*b = find_bit(ef->cmap.chunk, *a - EXFAT_FIRST_DATA_CLUSTER,
+			end - EXFAT_FIRST_DATA_CLUSTER, false) + EXFAT_FIRST_DATA_CLUSTER - 1;
 
 	return 0;
 }
@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include "compiler.h"
@@ -39,6 +40,8 @@
 #define EXFAT_ATTRIB_CACHED     0x20000
 #define EXFAT_ATTRIB_DIRTY      0x40000
 #define EXFAT_ATTRIB_UNLINKED   0x80000
+#define EXFAT_LOOKUP_CACHE_PATH 512
+
 #define IS_CONTIGUOUS(node) (((node).flags & EXFAT_ATTRIB_CONTIGUOUS) != 0)
 #define SECTOR_SIZE(sb) (1 << (sb).sector_bits)
 #define CLUSTER_SIZE(sb) (SECTOR_SIZE(sb) << (sb).spc_bits)
@@ -62,12 +65,25 @@ typedef size_t bitmap_t;
 #define BMAP_CLR(bitmap, index) \
 	((bitmap)[BMAP_BLOCK(index)] &= ~BMAP_MASK(index))
 
+/* run of consecutive clusters in a file's cluster chain */
+struct exfat_extent
+{
+	uint32_t index;				/* position of the first cluster in the file */
+	cluster_t cluster;
+	uint32_t count;
+};
+
 struct exfat_node
 {
 	struct exfat_node* parent;
 	struct exfat_node* child;
 	struct exfat_node* next;
 	struct exfat_node* prev;
+	struct exfat_node* hash_next;	/* next node in the parent's bucket */
+	struct exfat_node** hash;		/* children by upcased name hash */
+	uint32_t hash_size;				/* buckets, a power of 2 */
+	uint32_t child_count;
+	uint16_t name_hash;
 
 	int references;
 	uint32_t fptr_index;
@@ -75,6 +91,11 @@ struct exfat_node
 	cluster_t entry_cluster;
 	off64_t entry_offset;
 	cluster_t start_cluster;
+	struct exfat_extent* extents;	/* known part of the cluster chain */
+	uint32_t extents_count;
+	uint32_t extents_size;			/* allocated entries */
+	uint32_t extents_mapped;		/* clusters covered by extents */
+	pthread_mutex_t lock;			/* serializes I/O on the node's data */
 	int flags;
 	uint64_t size;
 	time_t mtime, atime;
@@ -89,6 +110,7 @@ enum exfat_mode
 };
 
 struct exfat_dev;
+struct exfat_fat_cache;
 
 struct exfat
 {
@@ -104,8 +126,17 @@ struct exfat
 		bitmap_t* chunk;
 		uint32_t chunk_size;		/* in bits */
 		bool dirty;
+		pthread_mutex_t lock;		/* allocator lock */
 	}
 	cmap;
+	struct exfat_fat_cache* fat_cache;
+	struct
+	{
+		struct exfat_node* dir;		/* referenced while cached */
+		size_t length;
+		char path[EXFAT_LOOKUP_CACHE_PATH];
+	}
+	lookup_cache;					/* directory of the last lookup */
 	char label[UTF8_BYTES(EXFAT_ENAME_MAX) + 1];
 	void* zero_cluster;
 	int dmask, fmask;
@@ -143,6 +174,8 @@ off64_t exfat_get_size(const struct exfat_dev* dev);
 off64_t exfat_seek(struct exfat_dev* dev, off64_t offset, int whence);
 ssize_t exfat_read(struct exfat_dev* dev, void* buffer, size_t size);
 ssize_t exfat_write(struct exfat_dev* dev, const void* buffer, size_t size);
+void exfat_discard(struct exfat_dev* dev);
+int exfat_zero(struct exfat_dev* dev, off64_t offset, off64_t size);
 ssize_t exfat_pread(struct exfat_dev* dev, void* buffer, size_t size,
 		off64_t offset);
 ssize_t exfat_pwrite(struct exfat_dev* dev, const void* buffer, size_t size,
@@ -158,6 +191,7 @@ void exfat_closedir(struct exfat* ef, struct exfat_iterator* it);
 struct exfat_node* exfat_readdir(struct exfat* ef, struct exfat_iterator* it);
 int exfat_lookup(struct exfat* ef, struct exfat_node** node,
 		const char* path);
+void exfat_reset_lookup_cache(struct exfat* ef);
 int exfat_split(struct exfat* ef, struct exfat_node** parent,
 		struct exfat_node** node, le16_t* name, const char* path);
 
@@ -167,6 +201,9 @@ cluster_t exfat_next_cluster(const struct exfat* ef,
 cluster_t exfat_advance_cluster(const struct exfat* ef,
 		struct exfat_node* node, uint32_t count);
 int exfat_flush(struct exfat* ef);
+void exfat_init_fat_cache(struct exfat* ef);
+void exfat_free_fat_cache(struct exfat* ef);
+void exfat_free_extents(struct exfat_node* node);
 int exfat_truncate(struct exfat* ef, struct exfat_node* node, uint64_t size,
 		bool erase);
 uint32_t exfat_count_free_clusters(const struct exfat* ef);
@@ -31,6 +31,18 @@
 #ifdef __APPLE__
 #include <sys/disk.h>
 #endif
+#ifdef __linux__
+/* not all C libraries export these with <sys/mount.h> */
+#ifndef BLKDISCARD
+#define BLKDISCARD _IO(0x12, 119)
+#endif
+#ifndef BLKFLSBUF
+#define BLKFLSBUF _IO(0x12, 97)
+#endif
+#ifndef BLKZEROOUT
+#define BLKZEROOUT _IO(0x12, 127)
+#endif
+#endif
 #ifdef USE_UBLIO
 #include <sys/uio.h>
 #include <ublio.h>
@@ -282,6 +294,59 @@ ssize_t exfat_write(struct exfat_dev* dev, const void* buffer, size_t size)
 #endif
 }
 
+#ifdef __linux__
+/*
+ * BLKDISCARD and BLKZEROOUT bypass the page cache, and older kernels leave
+ * it as it was. Write back what is dirty and drop the rest so that neither
+ * stale pages nor partially written ones end up over the erased range.
+ */
+static void flush_cache(struct exfat_dev* dev)
+{
+#ifdef USE_UBLIO
+	ublio_fsync(dev->ufh);
+#endif
+	fsync(dev->fd);
+	ioctl(dev->fd, BLKFLSBUF, 0);
+}
+#endif
+
+/*
+ * Tells the device that its whole contents are no longer needed. This is
+ * only a hint: discarded blocks are not assumed to read back as zeroes.
+ */
+void exfat_discard(struct exfat_dev* dev)
+{
+#ifdef __linux__
+	uint64_t range[2] = {0, dev->size};
+
+	flush_cache(dev);
+	if (ioctl(dev->fd, BLKDISCARD, &range) == 0)
+		flush_cache(dev);
+#endif
+}
+
+/*
+ * Lets the device zero a range itself, which usually avoids transferring
+ * the zeroes. Returns 0 on success and -1 if the caller has to write them.
+ */
+int exfat_zero(struct exfat_dev* dev, off64_t offset, off64_t size)
+{
+#if defined(__linux__) && !defined(USE_UBLIO)
+	uint64_t range[2] = {offset, size};
+
+	/* the kernel only accepts 512-byte aligned ranges */
+	if (offset % 512 != 0 || size % 512 != 0)
+		return -1;
+	flush_cache(dev);
+	if (ioctl(dev->fd, BLKZEROOUT, &range) == 0)
+	{
+		flush_cache(dev);
+		return 0;
+	}
+#endif
+	return -1;
+}
+
 ssize_t exfat_pread(struct exfat_dev* dev, void* buffer, size_t size,
 		off64_t offset)
 {
@@ -302,10 +367,41 @@ ssize_t exfat_pwrite(struct exfat_dev* dev, const void* buffer, size_t size,
 #endif
 }
 
+/*
+ * Like relatime: atime is only moved when it falls behind mtime or is a
+ * day old, so reading a file does not dirty its directory entry each time.
+ */
+static bool atime_outdated(const struct exfat_node* node)
+{
+	return node->atime <= node->mtime || time(NULL) - node->atime >= 86400;
+}
+
+/*
+ * Returns the number of bytes from the start of the remaining request that
+ * are stored in physically consecutive clusters starting with *cluster, and
+ * advances *cluster to the cluster following them.
+ */
+static off64_t contiguous_run(const struct exfat* ef,
+		const struct exfat_node* node, cluster_t* cluster, off64_t loffset,
+		off64_t remainder)
+{
+	off64_t run = MIN(CLUSTER_SIZE(*ef->sb) - loffset, remainder);
+	cluster_t last = *cluster;
+
+	*cluster = exfat_next_cluster(ef, node, last);
+	while (run < remainder && *cluster == last + 1)
+	{
+		run += MIN(CLUSTER_SIZE(*ef->sb), remainder - run);
+		last = *cluster;
+		*cluster = exfat_next_cluster(ef, node, last);
+	}
+	return run;
+}
+
 ssize_t exfat_generic_pread(const struct exfat* ef, struct exfat_node* node,
 		void* buffer, size_t size, off64_t offset)
 {
-	cluster_t cluster;
+	cluster_t cluster, first;
 	char* bufp = buffer;
 	off64_t lsize, loffset, remainder;
 
@@ -330,19 +426,19 @@ ssize_t exfat_generic_pread(const struct exfat* ef, struct exfat_node* node,
 			exfat_error("invalid cluster 0x%x while reading", cluster);
 			return -1;
 		}
-		lsize = MIN(CLUSTER_SIZE(*ef->sb) - loffset, remainder);
+		first = cluster;
+		lsize = contiguous_run(ef, node, &cluster, loffset, remainder);
 		if (exfat_pread(ef->dev, bufp, lsize,
-					exfat_c2o(ef, cluster) + loffset) < 0)
+					exfat_c2o(ef, first) + loffset) < 0)
 		{
-			exfat_error("failed to read cluster %#x", cluster);
+			exfat_error("failed to read cluster %#x", first);
 			return -1;
 		}
 		bufp += lsize;
 		loffset = 0;
 		remainder -= lsize;
-		cluster = exfat_next_cluster(ef, node, cluster);
 	}
-	if (!ef->ro && !ef->noatime)
+	if (!ef->ro && !ef->noatime && atime_outdated(node))
 		exfat_update_atime(node);
 	return MIN(size, node->size - offset) - remainder;
 }
@@ -350,7 +446,7 @@ ssize_t exfat_generic_pread(const struct exfat* ef, struct exfat_node* node,
 ssize_t exfat_generic_pwrite(struct exfat* ef, struct exfat_node* node,
 		const void* buffer, size_t size, off64_t offset)
 {
-	cluster_t cluster;
+	cluster_t cluster, first;
 	const char* bufp = buffer;
 	off64_t lsize, loffset, remainder;
 
@@ -379,17 +475,17 @@ ssize_t exfat_generic_pwrite(struct exfat* ef, struct exfat_node* node,
 			exfat_error("invalid cluster 0x%x while writing", cluster);
 			return -1;
 		}
-		lsize = MIN(CLUSTER_SIZE(*ef->sb) - loffset, remainder);
+		first = cluster;
+		lsize = contiguous_run(ef, node, &cluster, loffset, remainder);
 		if (exfat_pwrite(ef->dev, bufp, lsize,
-				exfat_c2o(ef, cluster) + loffset) < 0)
+				exfat_c2o(ef, first) + loffset) < 0)
 		{
-			exfat_error("failed to write cluster %#x", cluster);
+			exfat_error("failed to write cluster %#x", first);
 			return -1;
 		}
 		bufp += lsize;
 		loffset = 0;
 		remainder -= lsize;
-		cluster = exfat_next_cluster(ef, node, cluster);
 	}
 	exfat_update_mtime(node);
 	return size - remainder;
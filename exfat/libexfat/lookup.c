@@ -83,29 +83,35 @@ static int compare_name(struct exfat* ef, const le16_t* a, const le16_t* b)
 static int lookup_name(struct exfat* ef, struct exfat_node* parent,
 		struct exfat_node** node, const char* name, size_t n)
 {
-	struct exfat_iterator it;
 	le16_t buffer[EXFAT_NAME_MAX + 1];
+	struct exfat_node* p;
+	uint16_t hash;
 	int rc;
 
 	*node = NULL;
 
+	if (!(parent->flags & EXFAT_ATTRIB_DIR))
+		return -ENOTDIR;
 	rc = utf8_to_utf16(buffer, name, EXFAT_NAME_MAX, n);
 	if (rc != 0)
 		return rc;
 
-	rc = exfat_opendir(ef, parent, &it);
+	rc = exfat_cache_directory(ef, parent);
 	if (rc != 0)
 		return rc;
-	while ((*node = exfat_readdir(ef, &it)))
-	{
-		if (compare_name(ef, buffer, (*node)->name) == 0)
+
+	/* names that compare equal have equal hashes as both use upcase */
+	hash = le16_to_cpu(exfat_calc_name_hash(ef, buffer));
+	if (parent->hash != NULL)
+		p = parent->hash[hash & (parent->hash_size - 1)];
+	else
+		p = parent->child;
+	for (; p; p = parent->hash != NULL ? p->hash_next : p->next)
+		if (p->name_hash == hash && compare_name(ef, buffer, p->name) == 0)
 		{
-			exfat_closedir(ef, &it);
+			*node = exfat_get_node(p);
 			return 0;
 		}
-		exfat_put_node(ef, *node);
-	}
-	exfat_closedir(ef, &it);
 	return -ENOENT;
 }
 
@@ -121,17 +127,19 @@ static size_t get_comp(const char* path, const char** comp)
 		return end - *comp;
 }
 
-int exfat_lookup(struct exfat* ef, struct exfat_node** node,
-		const char* path)
+/*
+ * Walks the components of path up to end, starting from (and consuming the
+ * reference to) parent.
+ */
+static int lookup_comps(struct exfat* ef, struct exfat_node* parent,
+		struct exfat_node** node, const char* path, const char* end)
 {
-	struct exfat_node* parent;
 	const char* p;
 	size_t n;
 	int rc;
 
-	/* start from the root directory */
-	parent = *node = exfat_get_node(ef->root);
-	for (p = path; (n = get_comp(p, &p)); p += n)
+	*node = parent;
+	for (p = path; p < end && (n = get_comp(p, &p)); p += n)
 	{
 		if (n == 1 && *p == '.')				/* skip "." component */
 			continue;
@@ -147,6 +155,56 @@ int exfat_lookup(struct exfat* ef, struct exfat_node** node,
 	return 0;
 }
 
+void exfat_reset_lookup_cache(struct exfat* ef)
+{
+	if (ef->lookup_cache.dir != NULL)
+		exfat_put_node(ef, ef->lookup_cache.dir);
+	ef->lookup_cache.dir = NULL;
+	ef->lookup_cache.length = 0;
+}
+
+/*
+ * FUSE looks up every entry of a directory being listed by its full path,
+ * so the directory part of the last path is remembered and resolved only
+ * once. Renames and directory removals drop it.
+ */
+int exfat_lookup(struct exfat* ef, struct exfat_node** node,
+		const char* path)
+{
+	struct exfat_node* parent;
+	const char* last = strrchr(path, '/');
+	size_t length = last != NULL ? last - path : 0;
+	int rc;
+
+	while (length > 0 && path[length - 1] == '/')
+		length--;
+	if (length == 0 || length >= EXFAT_LOOKUP_CACHE_PATH)
+		/* start from the root directory */
+		return lookup_comps(ef, exfat_get_node(ef->root), node,
+				path, path + strlen(path));
+
+	if (ef->lookup_cache.dir == NULL || ef->lookup_cache.length != length ||
+			memcmp(ef->lookup_cache.path, path, length) != 0)
+	{
+		rc = lookup_comps(ef, exfat_get_node(ef->root), &parent,
+				path, path + length);
+		if (rc != 0)
+			return rc;
+		if (!(parent->flags & EXFAT_ATTRIB_DIR))
+		{
+			exfat_put_node(ef, parent);
+			return -ENOTDIR;
+		}
+		exfat_reset_lookup_cache(ef);
+		memcpy(ef->lookup_cache.path, path, length);
+		ef->lookup_cache.length = length;
+		ef->lookup_cache.dir = parent;
+	}
+	parent = exfat_get_node(ef->lookup_cache.dir);
+	return lookup_comps(ef, parent, node, path + length,
+			path + strlen(path));
+}
+
 static bool is_last_comp(const char* comp, size_t length)
 {
 	const char* p = comp + length;
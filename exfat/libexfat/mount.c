@@ -158,6 +158,7 @@ int exfat_mount(struct exfat* ef, const char* spec, const char* options)
 
 	exfat_tzset();
 	memset(ef, 0, sizeof(struct exfat));
+	pthread_mutex_init(&ef->cmap.lock, NULL);
 
 	parse_options(ef, options);
 
@@ -255,6 +256,7 @@ int exfat_mount(struct exfat* ef, const char* spec, const char* options)
 		return -ENOMEM;
 	}
 	memset(ef->root, 0, sizeof(struct exfat_node));
+	pthread_mutex_init(&ef->root->lock, NULL);
 	ef->root->flags = EXFAT_ATTRIB_DIR;
 	ef->root->start_cluster = le32_to_cpu(ef->sb->rootdir_cluster);
 	ef->root->fptr_cluster = ef->root->start_cluster;
@@ -266,6 +268,8 @@ int exfat_mount(struct exfat* ef, const char* spec, const char* options)
 	/* always keep at least 1 reference to the root node */
 	exfat_get_node(ef->root);
 
+	exfat_init_fat_cache(ef);
+
 	rc = exfat_cache_directory(ef, ef->root);
 	if (rc != 0)
 		goto error;
@@ -288,7 +292,9 @@ int exfat_mount(struct exfat* ef, const char* spec, const char* options)
 error:
 	exfat_put_node(ef, ef->root);
 	exfat_reset_cache(ef);
+	exfat_free_extents(ef->root);
 	free(ef->root);
+	exfat_free_fat_cache(ef);
 	free(ef->zero_cluster);
 	exfat_close(ef->dev);
 	free(ef->sb);
@@ -321,8 +327,10 @@ void exfat_unmount(struct exfat* ef)
 {
 	exfat_put_node(ef, ef->root);
 	exfat_reset_cache(ef);
+	exfat_free_extents(ef->root);
 	free(ef->root);
 	ef->root = NULL;
+	exfat_free_fat_cache(ef);
 	finalize_super_block(ef);
 	exfat_close(ef->dev);	/* close descriptor immediately after fsync */
 	ef->dev = NULL;
@@ -36,8 +36,8 @@ struct iterator
 
 struct exfat_node* exfat_get_node(struct exfat_node* node)
 {
-	/* if we switch to multi-threaded mode we will need atomic
-	   increment here and atomic decrement in exfat_put_node() */
+	/* references are only taken and dropped with the node tree locked
+	   (see exfat-fuse), so this needs no atomic increment */
 	node->references++;
 	return node;
 }
@@ -60,6 +60,8 @@ void exfat_put_node(struct exfat* ef, struct exfat_node* node)
 		{
 			/* free all clusters and node structure itself */
 			exfat_truncate(ef, node, 0, true);
+			exfat_free_extents(node);
+			free(node->hash);
 			free(node);
 		}
 		/* FIXME handle I/O error */
@@ -147,6 +149,7 @@ static struct exfat_node* allocate_node(void)
 		return NULL;
 	}
 	memset(node, 0, sizeof(struct exfat_node));
+	pthread_mutex_init(&node->lock, NULL);
 	return node;
 }
 
@@ -450,12 +453,82 @@ error:
 	return rc;
 }
 
+#define NAME_HASH_MIN_SIZE 16
+
+/*
+ * Rebuilds the name index of a directory with the given number of buckets.
+ * If memory is short the old index (or none, in which case lookups fall
+ * back to scanning the children) is kept.
+ */
+static void rehash_directory(struct exfat_node* dir, uint32_t size)
+{
+	struct exfat_node** hash;
+	struct exfat_node* node;
+
+	hash = calloc(size, sizeof(struct exfat_node*));
+	if (hash == NULL)
+		return;
+	for (node = dir->child; node; node = node->next)
+	{
+		node->hash_next = hash[node->name_hash & (size - 1)];
+		hash[node->name_hash & (size - 1)] = node;
+	}
+	free(dir->hash);
+	dir->hash = hash;
+	dir->hash_size = size;
+}
+
+static void hash_insert(struct exfat_node* dir, struct exfat_node* node)
+{
+	struct exfat_node** bucket;
+
+	dir->child_count++;
+	if (dir->child_count > dir->hash_size)
+	{
+		uint32_t size = dir->hash_size;
+
+		/* the node is already in the list, so a rebuild indexes it too */
+		rehash_directory(dir, MAX(size * 2, NAME_HASH_MIN_SIZE));
+		if (dir->hash_size != size)
+			return;
+	}
+	if (dir->hash == NULL)
+		return;
+	bucket = &dir->hash[node->name_hash & (dir->hash_size - 1)];
+	node->hash_next = *bucket;
+	*bucket = node;
+}
+
+static void hash_remove(struct exfat_node* dir, struct exfat_node* node)
+{
+	struct exfat_node** p;
+
+	dir->child_count--;
+	if (dir->hash == NULL)
+		return;
+	for (p = &dir->hash[node->name_hash & (dir->hash_size - 1)]; *p;
+			p = &(*p)->hash_next)
+		if (*p == node)
+		{
+			*p = node->hash_next;
+			break;
+		}
+	node->hash_next = NULL;
+}
+
+static uint16_t name_hash(struct exfat* ef, const le16_t* name)
+{
+	return le16_to_cpu(exfat_calc_name_hash(ef, name));
+}
+
 int exfat_cache_directory(struct exfat* ef, struct exfat_node* dir)
 {
 	struct iterator it;
 	int rc;
 	struct exfat_node* node;
 	struct exfat_node* current = NULL;
+	uint32_t count = 0;
+	uint32_t size = NAME_HASH_MIN_SIZE;
 
 	if (dir->flags & EXFAT_ATTRIB_CACHED)
 		return 0; /* already cached */
@@ -466,6 +539,8 @@ int exfat_cache_directory(struct exfat* ef, struct exfat_node* dir)
 	while ((rc = readdir(ef, dir, &node, &it)) == 0)
 	{
 		node->parent = dir;
+		node->name_hash = name_hash(ef, node->name);
+		count++;
 		if (current != NULL)
 		{
 			current->next = node;
@@ -490,11 +565,16 @@ int exfat_cache_directory(struct exfat* ef, struct exfat_node* dir)
 		return rc;
 	}
 
+	dir->child_count = count;
+	while (size < count)
+		size *= 2;
+	rehash_directory(dir, size);
 	dir->flags |= EXFAT_ATTRIB_CACHED;
 	return 0;
 }
 
-static void tree_attach(struct exfat_node* dir, struct exfat_node* node)
+static void tree_attach(struct exfat* ef, struct exfat_node* dir,
+		struct exfat_node* node)
 {
 	node->parent = dir;
 	if (dir->child)
@@ -503,10 +583,13 @@ static void tree_attach(struct exfat_node* dir, struct exfat_node* node)
 		node->next = dir->child;
 	}
 	dir->child = node;
+	node->name_hash = name_hash(ef, node->name);
+	hash_insert(dir, node);
 }
 
 static void tree_detach(struct exfat_node* node)
 {
+	hash_remove(node->parent, node);
 	if (node->prev)
 		node->prev->next = node->next;
 	else /* this is the first node in the list */
@@ -525,8 +608,12 @@ static void reset_cache(struct exfat* ef, struct exfat_node* node)
 		struct exfat_node* p = node->child;
 		reset_cache(ef, p);
 		tree_detach(p);
+		exfat_free_extents(p);
 		free(p);
 	}
+	free(node->hash);
+	node->hash = NULL;
+	node->hash_size = 0;
 	node->flags &= ~EXFAT_ATTRIB_CACHED;
 	if (node->references != 0)
 	{
@@ -541,6 +628,7 @@ static void reset_cache(struct exfat* ef, struct exfat_node* node)
 
 void exfat_reset_cache(struct exfat* ef)
 {
+	exfat_reset_lookup_cache(ef);
 	reset_cache(ef, ef->root);
 }
 
@@ -736,6 +824,8 @@ int exfat_rmdir(struct exfat* ef, struct exfat_node* node)
 {
 	if (!(node->flags & EXFAT_ATTRIB_DIR))
 		return -ENOTDIR;
+	/* the last lookup may have cached this directory */
+	exfat_reset_lookup_cache(ef);
 	/* check that directory is empty */
 	exfat_cache_directory(ef, node);
 	if (node->child)
@@ -863,7 +953,7 @@ static int write_entry(struct exfat* ef, struct exfat_node* dir,
 	init_node_meta1(node, &meta1);
 	init_node_meta2(node, &meta2);
 
-	tree_attach(dir, node);
+	tree_attach(ef, dir, node);
 	exfat_update_mtime(dir);
 	return 0;
 }
@@ -993,7 +1083,7 @@ static int rename_entry(struct exfat* ef, struct exfat_node* dir,
 
 	memcpy(node->name, name, (EXFAT_NAME_MAX + 1) * sizeof(le16_t));
 	tree_detach(node);
-	tree_attach(dir, node);
+	tree_attach(ef, dir, node);
 	return 0;
 }
 
@@ -1007,6 +1097,9 @@ int exfat_rename(struct exfat* ef, const char* old_path, const char* new_path)
 	le16_t name[EXFAT_NAME_MAX + 1];
 	int rc;
 
+	/* cached paths below old_path are about to change */
+	exfat_reset_lookup_cache(ef);
+
 	rc = exfat_lookup(ef, &node, old_path);
 	if (rc != 0)
 		return rc;
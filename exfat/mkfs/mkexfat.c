@@ -57,6 +57,8 @@ static int erase_object(struct exfat_dev* dev, const void* block,
 	const off64_t block_count = DIV_ROUND_UP(size, block_size);
 	off64_t i;
 
+	if (exfat_zero(dev, start, size) == 0)
+		return 0;
 	if (exfat_seek(dev, start, SEEK_SET) == (off64_t) -1)
 	{
 		exfat_error("seek to 0x%"PRIx64" failed", start);
@@ -131,6 +133,8 @@ int mkfs(struct exfat_dev* dev, off64_t volume_size)
 
 	fputs("Creating... ", stdout);
 	fflush(stdout);
+	/* discarding is only a hint, the metadata areas are still erased */
+	exfat_discard(dev);
 	if (erase(dev) != 0)
 		return 1;
 	if (create(dev) != 0)
@@ -212,6 +212,23 @@ int GUIButton::Update(void)
 	return ret;
 }
 
+int GUIButton::NotifyVarChange(const std::string& varName, const std::string& value)
+{
+	GUIObject::NotifyVarChange(varName, value);
+
+	if (mButtonLabel)
+		mButtonLabel->NotifyVarChange(varName, value);
+	return 0;
+}
+
+bool GUIButton::GetWatchedVars(std::set<std::string>& vars)
+{
+	GUIObject::GetWatchedVars(vars);
+	if (mButtonLabel)
+		return mButtonLabel->GetWatchedVars(vars);
+	return true;
+}
+
 int GUIButton::SetRenderPos(int x, int y, int w, int h)
 {
 	mRenderX = x;
@@ -155,6 +155,23 @@ int GUICheckbox::SetRenderPos(int x, int y, int w, int h)
 	return 0;
 }
 
+int GUICheckbox::NotifyVarChange(const std::string& varName, const std::string& value)
+{
+	GUIObject::NotifyVarChange(varName, value);
+
+	if (mLabel)
+		mLabel->NotifyVarChange(varName, value);
+	return 0;
+}
+
+bool GUICheckbox::GetWatchedVars(std::set<std::string>& vars)
+{
+	GUIObject::GetWatchedVars(vars);
+	if (mLabel)
+		return mLabel->GetWatchedVars(vars);
+	return true;
+}
+
 int GUICheckbox::NotifyTouch(TOUCH_STATE state, int x, int y)
 {
 	if (!isConditionTrue())
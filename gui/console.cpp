@@ -1,5 +1,6 @@
 // console.cpp - GUIConsole object
 
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,7 +27,26 @@ extern "C" {
 #include "objects.hpp"
 
 
+// Number of console lines kept for scrollback
+#define CONSOLE_MAX_LINES 4096
+
+// gConsole is a ring of the most recent lines, line n lives at
+// n % CONSOLE_MAX_LINES. gConsoleTotal counts every line ever printed.
+// gui_print may be called from any thread, so both are guarded by
+// gConsoleLock.
 static std::vector<std::string> gConsole;
+static unsigned long gConsoleTotal = 0;
+static pthread_mutex_t gConsoleLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Must be called with gConsoleLock held
+static void gui_console_append(const char* line)
+{
+	if (gConsole.size() < CONSOLE_MAX_LINES)
+		gConsole.push_back(line);
+	else
+		gConsole[gConsoleTotal % CONSOLE_MAX_LINES] = line;
+	gConsoleTotal++;
+}
 
 extern "C" void gui_print(const char *fmt, ...)
 {
@@ -46,12 +66,13 @@ extern "C" void gui_print(const char *fmt, ...)
 		return;
 	}
 
+	pthread_mutex_lock(&gConsoleLock);
 	for (start = next = buf; *next != '\0';)
 	{
 		if (*next == '\n')
 		{
 			*next = '\0';
-			gConsole.push_back(start);
+			gui_console_append(start);
 
 			start = ++next;
 		}
@@ -61,7 +82,10 @@ extern "C" void gui_print(const char *fmt, ...)
 
 	// The text after last \n (or whole string if there is no \n)
 	if(*start)
-		gConsole.push_back(start);
+		gui_console_append(start);
+	pthread_mutex_unlock(&gConsoleLock);
+
+	gui_wake();
 	return;
 }
 
@@ -78,6 +102,7 @@ GUIConsole::GUIConsole(xml_node<>* node) : GUIObject(node)
 	memset(&mScrollColor, 0x08, sizeof(COLOR));
 	mScrollColor.alpha = 255;
 	mLastCount = 0;
+	mWrapWidth = 0;
 	mSlideout = 0;
 	RenderCount = 0;
 	mSlideoutState = hidden;
@@ -174,32 +199,67 @@ int GUIConsole::RenderConsole(void)
 	// Render the lines
 	gr_color(mForegroundColor.red, mForegroundColor.green, mForegroundColor.blue, mForegroundColor.alpha);
 
-	// Don't try to continue to render without data
-	int prevCount = mLastCount;
-	mLastCount = gConsole.size();
 	mRender = false;
-	if (mLastCount == 0)
-		return (mSlideout ? RenderSlideout() : 0);
 
-	// Due to word wrap, figure out what / how the newly added text needs to be added to the render vector that is word wrapped
-	// Note, that multiple consoles on different GUI pages may be different widths or use different fonts, so the word wrapping
-	// may different in different console windows
-	for (int i = prevCount; i < mLastCount; i++) {
-		string curr_line = gConsole[i];
-		int line_char_width;
-		for(;;) {
-			line_char_width = gr_maxExW(curr_line.c_str(), fontResource, mConsoleW);
-			if (line_char_width < curr_line.size()) {
-				rConsole.push_back(curr_line.substr(0, line_char_width));
-				curr_line = curr_line.substr(line_char_width);
-			} else {
-				rConsole.push_back(curr_line);
+	pthread_mutex_lock(&gConsoleLock);
+	unsigned long oldest = gConsoleTotal - gConsole.size();
+
+	// Multiple consoles on different GUI pages may be different widths or use different fonts, so every
+	// console keeps its own word wrapping. It only needs to be redone if our width changes.
+	if (mWrapWidth != mConsoleW)
+	{
+		rConsole.clear();
+		mLastCount = 0;
+		mWrapWidth = mConsoleW;
+	}
+
+	// Forget rows of lines that have dropped out of the scrollback
+	if (mLastCount < oldest)
+		mLastCount = oldest;
+	while (!rConsole.empty() && rConsole.front().line < oldest)
+	{
+		rConsole.pop_front();
+		if (mCurrentLine > 0)
+			mCurrentLine--;
+	}
+
+	// Word wrap the newly added lines, each row just records where it starts in the line
+	for (; mLastCount < gConsoleTotal; mLastCount++)
+	{
+		const std::string& curr_line = gConsole[mLastCount % CONSOLE_MAX_LINES];
+		ConsoleRow row;
+		row.line = mLastCount;
+		row.offset = 0;
+		for (;;)
+		{
+			unsigned int remaining = curr_line.size() - row.offset;
+			unsigned int line_char_width = gr_maxExW(curr_line.c_str() + row.offset, fontResource, mConsoleW);
+			if (line_char_width < remaining)
+			{
+				// Always make progress, even if a single character doesn't fit
+				if (line_char_width == 0)
+					line_char_width = 1;
+				row.length = line_char_width;
+				rConsole.push_back(row);
+				row.offset += line_char_width;
+			}
+			else
+			{
+				row.length = remaining;
+				rConsole.push_back(row);
 				break;
 			}
 		}
 	}
 	RenderCount = rConsole.size();
 
+	// Don't try to continue to render without data
+	if (RenderCount == 0)
+	{
+		pthread_mutex_unlock(&gConsoleLock);
+		return (mSlideout ? RenderSlideout() : 0);
+	}
+
 	// Find the start point
 	int start;
 	int curLine = mCurrentLine; // Thread-safing (Another thread updates this value)
@@ -216,12 +276,18 @@ int GUIConsole::RenderConsole(void)
 		start = curLine - mMaxRows;
 	}
 
+	std::string text;
 	unsigned int line;
 	for (line = 0; line < mMaxRows; line++)
 	{
 		if ((start + (int) line) >= 0 && (start + (int) line) < (int) RenderCount)
-			gr_textExW(mConsoleX, mStartY + (line * mFontHeight), rConsole[start + line].c_str(), fontResource, mConsoleW + mConsoleX);
+		{
+			const ConsoleRow& row = rConsole[start + line];
+			text.assign(gConsole[row.line % CONSOLE_MAX_LINES], row.offset, row.length);
+			gr_textExW(mConsoleX, mStartY + (line * mFontHeight), text.c_str(), fontResource, mConsoleW + mConsoleX);
+		}
 	}
+	pthread_mutex_unlock(&gConsoleLock);
 	return (mSlideout ? RenderSlideout() : 0);
 }
 
@@ -257,7 +323,7 @@ int GUIConsole::Update(void)
 		return 2;
 	}
 
-	if (mCurrentLine == -1 && mLastCount != gConsole.size())
+	if (mCurrentLine == -1 && mLastCount != gConsoleTotal)
 	{
 		// We can use Render, and return for just a flip
 		Render();
@@ -84,6 +84,10 @@ GUIFileSelector::GUIFileSelector(xml_node<>* node) : GUIObject(node)
 	hasFontHighlightColor = false;
 	isHighlighted = false;
 	updateFileList = false;
+	mListDev = 0;
+	mListIno = 0;
+	mListTime = 0;
+	mListSortOrder = 0;
 	startSelection = -1;
 
 	// Load header text
@@ -901,6 +905,12 @@ int GUIFileSelector::NotifyVarChange(const std::string& varName, const std::stri
 	return 0;
 }
 
+bool GUIFileSelector::GetWatchedVars(std::set<std::string>& vars)
+{
+	// The header text may reference any variable
+	return false;
+}
+
 int GUIFileSelector::SetRenderPos(int x, int y, int w /* = 0 */, int h /* = 0 */)
 {
 	mRenderX = x;
@@ -915,7 +925,7 @@ int GUIFileSelector::SetRenderPos(int x, int y, int w /* = 0 */, int h /* = 0 */
 	return 0;
 }
 
-bool GUIFileSelector::fileSort(FileData d1, FileData d2)
+bool GUIFileSelector::fileSort(const FileData& d1, const FileData& d2)
 {
 	if (d1.fileName == ".")
 		return -1;
@@ -956,13 +966,12 @@ int GUIFileSelector::GetFileList(const std::string folder)
 	struct dirent* de;
 	struct stat st;
 
-	// Clear all data
-	mFolderList.clear();
-	mFileList.clear();
-
 	d = opendir(folder.c_str());
 	if (d == NULL)
 	{
+		mFolderList.clear();
+		mFileList.clear();
+		mListFolder.clear();
 		LOGINFO("Unable to open '%s'\n", folder.c_str());
 		if (folder != "/" && (mShowNavFolders != 0 || mShowFiles != 0)) {
 			size_t found;
@@ -978,6 +987,33 @@ int GUIFileSelector::GetFileList(const std::string folder)
 		return -1;
 	}
 
+	// Sizes and dates are only needed to sort by them
+	bool needStat = (mSortOrder == 2 || mSortOrder == -2 || mSortOrder == 3 || mSortOrder == -3);
+
+	// Nothing to do if the same folder hasn't changed since we listed it.
+	// A mount on the path changes its device and inode. The folder's mtime
+	// only has one second resolution, so a change in the second the list
+	// was taken in counts as newer. Sizes and dates change without touching
+	// the folder, so lists sorted by them are always read again.
+	int dir_fd = dirfd(d);
+	bool haveStat = (fstat(dir_fd, &st) == 0);
+	bool stale = !haveStat || needStat || folder != mListFolder || mSortOrder != mListSortOrder
+		|| st.st_dev != mListDev || st.st_ino != mListIno || st.st_mtime >= mListTime;
+	if (!stale)
+	{
+		closedir(d);
+		return 0;
+	}
+	mListFolder = haveStat ? folder : "";
+	mListDev = st.st_dev;
+	mListIno = st.st_ino;
+	mListTime = time(NULL);
+	mListSortOrder = mSortOrder;
+
+	// Clear all data
+	mFolderList.clear();
+	mFileList.clear();
+
 	while ((de = readdir(d)) != NULL)
 	{
 		FileData data;
@@ -994,31 +1030,44 @@ int GUIFileSelector::GetFileList(const std::string folder)
 			data.fileType = de->d_type;
 		}
 
-		std::string path = folder + "/" + data.fileName;
-		stat(path.c_str(), &st);
-		data.protection = st.st_mode;
-		data.userId = st.st_uid;
-		data.groupId = st.st_gid;
-		data.fileSize = st.st_size;
-		data.lastAccess = st.st_atime;
-		data.lastModified = st.st_mtime;
-		data.lastStatChange = st.st_ctime;
-
 		if (data.fileType == DT_UNKNOWN) {
-			data.fileType = TWFunc::Get_D_Type_From_Stat(path);
+			data.fileType = TWFunc::Get_D_Type_From_Stat(folder + "/" + data.fileName);
 		}
 		if (data.fileType == DT_DIR)
 		{
-			if (mShowNavFolders || (data.fileName != "." && data.fileName != TW_FILESELECTOR_UP_A_LEVEL))
-				mFolderList.push_back(data);
+			if (!mShowNavFolders && data.fileName == TW_FILESELECTOR_UP_A_LEVEL)
+				continue;
 		}
 		else if (data.fileType == DT_REG || data.fileType == DT_LNK || data.fileType == DT_BLK)
 		{
-			if (mExtn.empty() || (data.fileName.length() > mExtn.length() && data.fileName.substr(data.fileName.length() - mExtn.length()) == mExtn))
-			{
-				mFileList.push_back(data);
-			}
+			if (!mExtn.empty() && (data.fileName.length() <= mExtn.length() || data.fileName.compare(data.fileName.length() - mExtn.length(), mExtn.length(), mExtn) != 0))
+				continue;
 		}
+		else
+			continue;
+
+		if (needStat && fstatat(dir_fd, de->d_name, &st, 0) == 0) {
+			data.protection = st.st_mode;
+			data.userId = st.st_uid;
+			data.groupId = st.st_gid;
+			data.fileSize = st.st_size;
+			data.lastAccess = st.st_atime;
+			data.lastModified = st.st_mtime;
+			data.lastStatChange = st.st_ctime;
+		} else {
+			data.protection = 0;
+			data.userId = 0;
+			data.groupId = 0;
+			data.fileSize = 0;
+			data.lastAccess = 0;
+			data.lastModified = 0;
+			data.lastStatChange = 0;
+		}
+
+		if (data.fileType == DT_DIR)
+			mFolderList.push_back(data);
+		else
+			mFileList.push_back(data);
 	}
 	closedir(d);
 
@@ -1033,6 +1082,8 @@ void GUIFileSelector::SetPageFocus(int inFocus)
 	if (inFocus)
 	{
 		updateFileList = true;
+		// Storage may have been mounted or changed while we were away
+		mListFolder.clear();
 		scrollingY = 0;
 		scrollingSpeed = 0;
 		mUpdate = 1;
@@ -31,6 +31,8 @@
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <sys/mount.h>
+#include <sys/eventfd.h>
+#include <poll.h>
 #include <time.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -38,6 +40,7 @@
 extern "C"
 {
 #include "../twcommon.h"
+#include "../twtrace.h"
 #include "../minuitwrp/minui.h"
 #ifdef HAVE_SELINUX
 #include "../minzip/Zip.h"
@@ -62,6 +65,14 @@ extern "C"
 
 const static int CURTAIN_FADE = 32;
 
+// Length of one frame while the screen is changing, animations and sliders
+// count these ticks so it must stay at 30 per second
+const static long FRAME_NSEC = 33333333;
+// Number of frames without any update before the loop goes to sleep
+const static int IDLE_FRAMES = 60;
+// Longest sleep while idle, keeps clock and battery text current
+const static int IDLE_TIMEOUT_MS = 1000;
+
 using namespace rapidxml;
 
 // Global values
@@ -73,6 +84,8 @@ static int gForceRender = 0;
 pthread_mutex_t gForceRendermutex;
 static int gNoAnimation = 1;
 static int gGuiInputRunning = 0;
+static int gWakeFd = -1;
+static int gIdleFrames = 0;
 #ifndef TW_NO_SCREEN_TIMEOUT
 blanktimer blankTimer;
 #endif
@@ -86,6 +99,7 @@ extern "C" void gr_write_frame_to_file(int fd);
 
 void flip(void)
 {
+	TWTRACE_SCOPE("gui_flip");
 	if (gRecorder != -1)
 	{
 		timespec time;
@@ -419,6 +433,7 @@ static void * input_thread(void *cookie)
 				cursor->Move(ev.value, 0);
 			else if(ev.code == REL_Y)
 				cursor->Move(0, ev.value);
+			gui_wake();
 
 			if(drag == 1) {
 				cursor->GetPos(x, y);
@@ -434,9 +449,32 @@ static void * input_thread(void *cookie)
 	return NULL;
 }
 
-// This special function will return immediately the first time, but then
-// always returns 1/30th of a second (or immediately if called later) from
-// the last time it was called
+// Wakes up the render loop. Called whenever something may need to be
+// redrawn: input, variable changes, console output and forced renders.
+void gui_wake(void)
+{
+	if (gWakeFd >= 0)
+	{
+		uint64_t one = 1;
+		write(gWakeFd, &one, sizeof(one));
+	}
+}
+
+// Records the result of the last update so loopTimer knows whether the
+// screen is still changing
+static void loopUpdated(int ret)
+{
+	if (ret > 0)
+		gIdleFrames = 0;
+	else if (gWakeFd >= 0 && gIdleFrames < IDLE_FRAMES)
+		gIdleFrames++;
+}
+
+// This special function will return immediately the first time. While the
+// screen is changing it returns 1/30th of a second (or immediately if called
+// later) from the last time it was called. Once nothing has been updated for
+// IDLE_FRAMES frames it sleeps until gui_wake() is called instead, waking up
+// at least once a second.
 static void loopTimer(void)
 {
 	static timespec lastCall;
@@ -455,17 +493,43 @@ static void loopTimer(void)
 		clock_gettime(CLOCK_MONOTONIC, &curTime);
 
 		timespec diff = TWFunc::timespec_diff(lastCall, curTime);
+		int idle = (gIdleFrames >= IDLE_FRAMES);
+		int timeout;
 
-		// This is really 30 times per second
-		if (diff.tv_sec || diff.tv_nsec > 33333333)
+		if (idle)
+			timeout = IDLE_TIMEOUT_MS;
+		else if (diff.tv_sec || diff.tv_nsec > FRAME_NSEC)
 		{
 			lastCall = curTime;
 			return;
 		}
+		else
+			timeout = (FRAME_NSEC - diff.tv_nsec + 999999) / 1000000;
 
-		// We need to sleep some period time microseconds
-		unsigned int sleepTime = 33333 -(diff.tv_nsec / 1000);
-		usleep(sleepTime);
+		if (gWakeFd < 0)
+		{
+			// No wake event, we never go idle so just poll
+			usleep(timeout * 1000);
+			continue;
+		}
+
+		struct pollfd pfd;
+		pfd.fd = gWakeFd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		int ret = poll(&pfd, 1, timeout);
+		if (ret > 0 && (pfd.revents & POLLIN))
+		{
+			uint64_t count;
+			read(gWakeFd, &count, sizeof(count));
+			gIdleFrames = 0;
+		}
+		if (idle)
+		{
+			// Woken up or timed out, either way render a frame now
+			clock_gettime(CLOCK_MONOTONIC, &lastCall);
+			return;
+		}
 	} while (1);
 }
 
@@ -500,6 +564,7 @@ static int runPages(void)
 			int ret;
 
 			ret = PageManager::Update();
+			loopUpdated(ret);
 
 #ifndef PRINT_RENDER_TIME
 			if (ret > 1)
@@ -530,6 +595,7 @@ static int runPages(void)
 			pthread_mutex_lock(&gForceRendermutex);
 			gForceRender = 0;
 			pthread_mutex_unlock(&gForceRendermutex);
+			loopUpdated(1);
 			PageManager::Render();
 			flip();
 		}
@@ -570,6 +636,7 @@ static int runPage(const char *page_name)
 			int ret;
 
 			ret = PageManager::Update();
+			loopUpdated(ret);
 			if (ret > 1)
 				PageManager::Render();
 
@@ -581,6 +648,7 @@ static int runPage(const char *page_name)
 			pthread_mutex_lock(&gForceRendermutex);
 			gForceRender = 0;
 			pthread_mutex_unlock(&gForceRendermutex);
+			loopUpdated(1);
 			PageManager::Render();
 			flip();
 		}
@@ -600,6 +668,7 @@ int gui_forceRender(void)
 	pthread_mutex_lock(&gForceRendermutex);
 	gForceRender = 1;
 	pthread_mutex_unlock(&gForceRendermutex);
+	gui_wake();
 	return 0;
 }
 
@@ -610,6 +679,7 @@ int gui_changePage(std::string newPage)
 	pthread_mutex_lock(&gForceRendermutex);
 	gForceRender = 1;
 	pthread_mutex_unlock(&gForceRendermutex);
+	gui_wake();
 	return 0;
 }
 
@@ -619,6 +689,7 @@ int gui_changeOverlay(std::string overlay)
 	pthread_mutex_lock(&gForceRendermutex);
 	gForceRender = 1;
 	pthread_mutex_unlock(&gForceRendermutex);
+	gui_wake();
 	return 0;
 }
 
@@ -628,6 +699,7 @@ int gui_changePackage(std::string newPackage)
 	pthread_mutex_lock(&gForceRendermutex);
 	gForceRender = 1;
 	pthread_mutex_unlock(&gForceRendermutex);
+	gui_wake();
 	return 0;
 }
 
@@ -673,6 +745,10 @@ extern "C" int gui_init(void)
 
 	gr_init();
 
+	gWakeFd = eventfd(0, EFD_NONBLOCK);
+	if (gWakeFd < 0)
+		LOGERR("Unable to create GUI wake event, falling back to polling.\n");
+
 // HASH: Disable curtain for Safestrap (sorry Dees_Troy!)
 #ifndef BUILD_SAFESTRAP
 	if (res_create_surface("/res/images/curtain.jpg", &gCurtain))
@@ -758,6 +834,7 @@ extern "C" int gui_start(void)
 		return -1;
 
 	gGuiConsoleTerminate = 1;
+	gui_wake();
 
 	while (gGuiConsoleRunning)
 		loopTimer();
@@ -782,6 +859,7 @@ extern "C" int gui_startPage(const char *page_name)
 		return -1;
 
 	gGuiConsoleTerminate = 1;
+	gui_wake();
 
 	while (gGuiConsoleRunning)
 		loopTimer();
@@ -814,6 +892,7 @@ static void * console_thread(void *cookie)
 			int ret;
 
 			ret = PageManager::Update();
+			loopUpdated(ret);
 			if (ret > 1)
 				PageManager::Render();
 
@@ -828,6 +907,7 @@ static void * console_thread(void *cookie)
 			pthread_mutex_lock(&gForceRendermutex);
 			gForceRender = 0;
 			pthread_mutex_unlock(&gForceRendermutex);
+			loopUpdated(1);
 			PageManager::Render();
 			flip();
 		}
@@ -595,6 +595,8 @@ int GUIInput::NotifyVarChange(const std::string& varName, const std::string& val
 {
 	GUIObject::NotifyVarChange(varName, value);
 
+	if (mInputText)
+		mInputText->NotifyVarChange(varName, value);
 	if (varName == mVariable && !isLocalChange) {
 		HandleTextLocation(-1003);
 		return 0;
@@ -602,6 +604,15 @@ int GUIInput::NotifyVarChange(const std::string& varName, const std::string& val
 	return 0;
 }
 
+bool GUIInput::GetWatchedVars(std::set<std::string>& vars)
+{
+	GUIObject::GetWatchedVars(vars);
+	vars.insert(mVariable);
+	if (mInputText)
+		return mInputText->GetWatchedVars(vars);
+	return true;
+}
+
 int GUIInput::NotifyKeyboard(int key)
 {
 	string variableValue;
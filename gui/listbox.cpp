@@ -808,6 +808,12 @@ int GUIListBox::NotifyVarChange(const std::string& varName, const std::string& v
 	return 0;
 }
 
+bool GUIListBox::GetWatchedVars(std::set<std::string>& vars)
+{
+	// The header text may reference any variable
+	return false;
+}
+
 int GUIListBox::SetRenderPos(int x, int y, int w /* = 0 */, int h /* = 0 */)
 {
 	mRenderX = x;
@@ -185,6 +185,19 @@ int GUIObject::NotifyVarChange(const std::string& varName, const std::string& va
 	return 0;
 }
 
+bool GUIObject::GetWatchedVars(std::set<std::string>& vars)
+{
+	std::vector<Condition>::iterator iter;
+	for (iter = mConditions.begin(); iter != mConditions.end(); ++iter)
+	{
+		if (!iter->mVar1.empty())
+			vars.insert(iter->mVar1);
+		if (!iter->mVar2.empty())
+			vars.insert(iter->mVar2);
+	}
+	return true;
+}
+
 bool GUIObject::isMounted(string vol)
 {
 	FILE *fp;
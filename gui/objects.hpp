@@ -26,6 +26,7 @@
 #include <string>
 #include <map>
 #include <set>
+#include <deque>
 #include <time.h>
 
 extern "C" {
@@ -134,6 +135,10 @@ public:
 	//  Returns 0 on success, <0 on error
 	virtual int NotifyVarChange(const std::string& varName, const std::string& value);
 
+	// GetWatchedVars - Adds the variables NotifyVarChange reacts to
+	//  Returns false if the object must be notified of every change
+	virtual bool GetWatchedVars(std::set<std::string>& vars);
+
 protected:
 	class Condition
 	{
@@ -197,6 +202,7 @@ public:
 
 	// Notify of a variable change
 	virtual int NotifyVarChange(const std::string& varName, const std::string& value);
+	virtual bool GetWatchedVars(std::set<std::string>& vars);
 
 	// Set maximum width in pixels
 	virtual int SetMaxWidth(unsigned width);
@@ -208,7 +214,16 @@ public:
 	bool isHighlighted;
 
 protected:
+	// mText compiled into literal text and %variable% references
+	struct TextSegment
+	{
+		std::string text;
+		bool isVar;
+	};
+
 	std::string mText;
+	std::vector<TextSegment> mSegments;
+	std::set<std::string> mTextVars;
 	std::string mLastValue;
 	COLOR mColor;
 	COLOR mHighlightColor;
@@ -216,12 +231,17 @@ protected:
 	int mIsStatic;
 	int mVarChanged;
 	int mFontHeight;
+	int mLastWidth;
+	bool mWidthValid;
 	unsigned maxWidth;
 	unsigned charSkip;
 	bool hasHighlightColor;
 
 protected:
+	void compileText(void);
 	std::string parseText(void);
+	bool refreshValue(void);
+	int measureValue(void* fontResource);
 };
 
 // GUIImage - Used for static image
@@ -342,7 +362,7 @@ protected:
 	COLOR mScrollColor;
 	unsigned int mFontHeight;
 	int mCurrentLine;
-	unsigned int mLastCount;
+	unsigned long mLastCount;
 	unsigned int RenderCount;
 	unsigned int mMaxRows;
 	int mStartY;
@@ -352,7 +372,16 @@ protected:
 	int mLastTouchX, mLastTouchY;
 	int mSlideout;
 	SlideoutState mSlideoutState;
-	std::vector<std::string> rConsole;
+
+	// A word wrapped row: console line number and the part of it shown
+	struct ConsoleRow
+	{
+		unsigned long line;
+		unsigned int offset;
+		unsigned int length;
+	};
+	std::deque<ConsoleRow> rConsole;
+	int mWrapWidth;
 	bool mRender;
 
 protected:
@@ -383,6 +412,10 @@ public:
 	//  Return 0 on success, >0 to ignore remainder of touch, and <0 on error
 	virtual int NotifyTouch(TOUCH_STATE state, int x, int y);
 
+	// NotifyVarChange - Notify of a variable change, forwarded to the label
+	virtual int NotifyVarChange(const std::string& varName, const std::string& value);
+	virtual bool GetWatchedVars(std::set<std::string>& vars);
+
 protected:
 	GUIImage* mButtonImg;
 	Resource* mButtonIcon;
@@ -422,6 +455,10 @@ public:
 	//  Return 0 on success, >0 to ignore remainder of touch, and <0 on error
 	virtual int NotifyTouch(TOUCH_STATE state, int x, int y);
 
+	// NotifyVarChange - Notify of a variable change, forwarded to the label
+	virtual int NotifyVarChange(const std::string& varName, const std::string& value);
+	virtual bool GetWatchedVars(std::set<std::string>& vars);
+
 protected:
 	Resource* mChecked;
 	Resource* mUnchecked;
@@ -454,6 +491,7 @@ public:
 
 	// NotifyVarChange - Notify of a variable change
 	virtual int NotifyVarChange(const std::string& varName, const std::string& value);
+	virtual bool GetWatchedVars(std::set<std::string>& vars);
 
 	// SetPos - Update the position of the render object
 	//  Return 0 on success, <0 on error
@@ -479,7 +517,7 @@ protected:
 	virtual int GetSelection(int x, int y);
 
 	virtual int GetFileList(const std::string folder);
-	static bool fileSort(FileData d1, FileData d2);
+	static bool fileSort(const FileData& d1, const FileData& d2);
 
 protected:
 	std::vector<FileData> mFolderList;
@@ -535,6 +573,13 @@ protected:
 	COLOR mFontHighlightColor;
 	int startSelection;
 	bool updateFileList;
+
+	// What the current lists were built from, to skip re-reading an unchanged folder
+	std::string mListFolder;
+	dev_t mListDev;
+	ino_t mListIno;
+	time_t mListTime;
+	int mListSortOrder;
 };
 
 class GUIListBox : public GUIObject, public RenderObject, public ActionObject
@@ -558,6 +603,7 @@ public:
 
 	// NotifyVarChange - Notify of a variable change
 	virtual int NotifyVarChange(const std::string& varName, const std::string& value);
+	virtual bool GetWatchedVars(std::set<std::string>& vars);
 
 	// SetPos - Update the position of the render object
 	//  Return 0 on success, <0 on error
@@ -646,6 +692,7 @@ public:
 
 	// NotifyVarChange - Notify of a variable change
 	virtual int NotifyVarChange(const std::string& varName, const std::string& value);
+	virtual bool GetWatchedVars(std::set<std::string>& vars);
 
 	// SetPos - Update the position of the render object
 	//  Return 0 on success, <0 on error
@@ -750,6 +797,7 @@ public:
 	// NotifyVarChange - Notify of a variable change
 	//  Returns 0 on success, <0 on error
 	virtual int NotifyVarChange(const std::string& varName, const std::string& value);
+	virtual bool GetWatchedVars(std::set<std::string>& vars);
 
 protected:
 	Resource* mEmptyBar;
@@ -875,6 +923,7 @@ public:
 
 	// Notify of a variable change
 	virtual int NotifyVarChange(const std::string& varName, const std::string& value);
+	virtual bool GetWatchedVars(std::set<std::string>& vars);
 
 	// NotifyTouch - Notify of a touch event
 	//  Return 0 on success, >0 to ignore remainder of touch, and <0 on error
@@ -963,6 +1012,7 @@ public:
 
 	// Notify of a variable change
 	virtual int NotifyVarChange(const std::string& varName, const std::string& value);
+	virtual bool GetWatchedVars(std::set<std::string>& vars);
 
 	// SetPageFocus - Notify when a page gains or loses focus
 	virtual void SetPageFocus(int inFocus);
@@ -37,6 +37,7 @@
 
 extern "C" {
 #include "../twcommon.h"
+#include "../twtrace.h"
 #include "../minuitwrp/minui.h"
 }
 
@@ -191,6 +192,7 @@ Page::Page(xml_node<>* page, xml_node<>* templates /* = NULL */)
 	// This is a recursive routine for template handling
 	ProcessNode(page, templates);
 
+	IndexVarWatchers();
 	return;
 }
 
@@ -519,10 +521,46 @@ void Page::SetPageFocus(int inFocus)
 	return;
 }
 
+void Page::IndexVarWatchers(void)
+{
+	size_t count = mObjects.size();
+	std::vector<std::set<std::string> > watched(count);
+	std::vector<bool> wildcard(count);
+	std::set<std::string> allVars;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		wildcard[i] = !mObjects[i]->GetWatchedVars(watched[i]);
+		if (wildcard[i])
+			mVarWildcard.push_back(mObjects[i]);
+		allVars.insert(watched[i].begin(), watched[i].end());
+	}
+
+	std::set<std::string>::iterator var;
+	for (var = allVars.begin(); var != allVars.end(); ++var)
+	{
+		std::vector<GUIObject*>& watchers = mVarWatchers[*var];
+		for (size_t i = 0; i < count; i++)
+		{
+			if (wildcard[i] || watched[i].count(*var))
+				watchers.push_back(mObjects[i]);
+		}
+	}
+}
+
 int Page::NotifyVarChange(std::string varName, std::string value)
 {
+	// An empty name is a full refresh, everybody gets it
+	std::vector<GUIObject*>* watchers = &mObjects;
+	if (!varName.empty())
+	{
+		std::map<std::string, std::vector<GUIObject*> >::iterator pos;
+		pos = mVarWatchers.find(varName);
+		watchers = (pos != mVarWatchers.end() ? &pos->second : &mVarWildcard);
+	}
+
 	std::vector<GUIObject*>::iterator iter;
-	for (iter = mObjects.begin(); iter != mObjects.end(); ++iter)
+	for (iter = watchers->begin(); iter != watchers->end(); ++iter)
 	{
 		if ((*iter)->NotifyVarChange(varName, value))
 			LOGERR("An action handler errored on NotifyVarChange.\n");
@@ -960,6 +998,7 @@ int PageManager::IsCurrentPage(Page* page)
 
 int PageManager::Render(void)
 {
+	TWTRACE_SCOPE("gui_render");
 	int res = (mCurrentSet ? mCurrentSet->Render() : -1);
 	if(mMouseCursor)
 		mMouseCursor->Render();
@@ -995,6 +1034,7 @@ int PageManager::Update(void)
 		return 0;
 #endif
 
+	TWTRACE_SCOPE("gui_update");
 	int res = (mCurrentSet ? mCurrentSet->Update() : -1);
 
 	if(mMouseCursor)
@@ -1008,17 +1048,29 @@ int PageManager::Update(void)
 
 int PageManager::NotifyTouch(TOUCH_STATE state, int x, int y)
 {
-	return (mCurrentSet ? mCurrentSet->NotifyTouch(state, x, y) : -1);
+	int ret = (mCurrentSet ? mCurrentSet->NotifyTouch(state, x, y) : -1);
+
+	// Let the render loop pick up the change right away
+	gui_wake();
+	return ret;
 }
 
 int PageManager::NotifyKey(int key, bool down)
 {
-	return (mCurrentSet ? mCurrentSet->NotifyKey(key, down) : -1);
+	int ret = (mCurrentSet ? mCurrentSet->NotifyKey(key, down) : -1);
+
+	// Let the render loop pick up the change right away
+	gui_wake();
+	return ret;
 }
 
 int PageManager::NotifyKeyboard(int key)
 {
-	return (mCurrentSet ? mCurrentSet->NotifyKeyboard(key) : -1);
+	int ret = (mCurrentSet ? mCurrentSet->NotifyKeyboard(key) : -1);
+
+	// Let the render loop pick up the change right away
+	gui_wake();
+	return ret;
 }
 
 int PageManager::SetKeyBoardFocus(int inFocus)
@@ -1028,7 +1080,11 @@ int PageManager::SetKeyBoardFocus(int inFocus)
 
 int PageManager::NotifyVarChange(std::string varName, std::string value)
 {
-	return (mCurrentSet ? mCurrentSet->NotifyVarChange(varName, value) : -1);
+	int ret = (mCurrentSet ? mCurrentSet->NotifyVarChange(varName, value) : -1);
+
+	// Let the render loop pick up the change right away
+	gui_wake();
+	return ret;
 }
 
 extern "C" void gui_notifyVarChange(const char *name, const char* value)
@@ -19,6 +19,7 @@ typedef struct {
 // Utility Functions
 int ConvertStrToColor(std::string str, COLOR* color);
 int gui_forceRender(void);
+void gui_wake(void);
 int gui_changePage(std::string newPage);
 int gui_changeOverlay(std::string newPage);
 std::string gui_parse_text(string inText);
@@ -60,8 +61,14 @@ protected:
 	ActionObject* mTouchStart;
 	COLOR mBackground;
 
+	// Objects to notify per variable name, in page order
+	std::map<std::string, std::vector<GUIObject*> > mVarWatchers;
+	// Objects to notify of variables nobody watches explicitly
+	std::vector<GUIObject*> mVarWildcard;
+
 protected:
 	bool ProcessNode(xml_node<>* page, xml_node<>* templates = NULL, int depth = 0);
+	void IndexVarWatchers(void);
 };
 
 class PageSet
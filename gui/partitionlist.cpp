@@ -879,6 +879,12 @@ int GUIPartitionList::NotifyVarChange(const std::string& varName, const std::str
 	return 0;
 }
 
+bool GUIPartitionList::GetWatchedVars(std::set<std::string>& vars)
+{
+	// The header text may reference any variable
+	return false;
+}
+
 int GUIPartitionList::SetRenderPos(int x, int y, int w /* = 0 */, int h /* = 0 */)
 {
 	mRenderX = x;
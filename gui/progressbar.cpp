@@ -239,3 +239,11 @@ int GUIProgressBar::NotifyVarChange(const std::string& varName, const std::strin
 	}
 	return 0;
 }
+
+bool GUIProgressBar::GetWatchedVars(std::set<std::string>& vars)
+{
+	GUIObject::GetWatchedVars(vars);
+	vars.insert("ui_progress_portion");
+	vars.insert("ui_progress_frames");
+	return true;
+}
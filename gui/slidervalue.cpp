@@ -418,6 +418,15 @@ int GUISliderValue::NotifyVarChange(const std::string& varName, const std::strin
 	return 0;
 }
 
+bool GUISliderValue::GetWatchedVars(std::set<std::string>& vars)
+{
+	GUIObject::GetWatchedVars(vars);
+	vars.insert(mVariable);
+	if (mLabel)
+		return mLabel->GetWatchedVars(vars);
+	return true;
+}
+
 void GUISliderValue::SetPageFocus(int inFocus)
 {
 	if (inFocus)
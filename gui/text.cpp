@@ -35,6 +35,8 @@ GUIText::GUIText(xml_node<>* node)
 	mIsStatic = 1;
 	mVarChanged = 0;
 	mFontHeight = 0;
+	mLastWidth = 0;
+	mWidthValid = false;
 	maxWidth = 0;
 	charSkip = 0;
 	isHighlighted = false;
@@ -93,9 +95,9 @@ GUIText::GUIText(xml_node<>* node)
 	child = node->first_node("text");
 	if (child)  mText = child->value();
 
-	// Simple way to check for static state
+	compileText();
 	mLastValue = parseText();
-	if (mLastValue != mText)   mIsStatic = 0;
+	if (!mTextVars.empty())   mIsStatic = 0;
 
 	gr_getFontDetails(mFont ? mFont->GetResource() : NULL, (unsigned*) &mFontHeight, NULL);
 	return;
@@ -107,21 +109,19 @@ int GUIText::Render(void)
 		return 0;
 
 	void* fontResource = NULL;
-	string displayValue;
 
 	if (mFont)
 		fontResource = mFont->GetResource();
 
-	mLastValue = parseText();
-	displayValue = mLastValue;
+	if (mVarChanged)
+		refreshValue();
 
+	const char* displayValue = mLastValue.c_str();
 	if (charSkip)
-		displayValue.erase(0, charSkip);
-
-	mVarChanged = 0;
+		displayValue += (charSkip < mLastValue.length() ? charSkip : mLastValue.length());
 
 	int x = mRenderX, y = mRenderY;
-	int width = gr_measureEx(displayValue.c_str(), fontResource);
+	int width = measureValue(fontResource);
 
 	if (mPlacement != TOP_LEFT && mPlacement != BOTTOM_LEFT)
 	{
@@ -144,9 +144,9 @@ int GUIText::Render(void)
 		gr_color(mColor.red, mColor.green, mColor.blue, mColor.alpha);
 
 	if (maxWidth)
-		gr_textExW(x, y, displayValue.c_str(), fontResource, maxWidth + x);
+		gr_textExW(x, y, displayValue, fontResource, maxWidth + x);
 	else
-		gr_textEx(x, y, displayValue.c_str(), fontResource);
+		gr_textEx(x, y, displayValue, fontResource);
 	return 0;
 }
 
@@ -168,12 +168,7 @@ int GUIText::Update(void)
 	if (mIsStatic || !mVarChanged)
 		return 0;
 
-	std::string newValue = parseText();
-	if (mLastValue == newValue)
-		return 0;
-	else
-		mLastValue = newValue;
-	return 2;
+	return (refreshValue() ? 2 : 0);
 }
 
 int GUIText::GetCurrentBounds(int& w, int& h)
@@ -184,52 +179,122 @@ int GUIText::GetCurrentBounds(int& w, int& h)
 		fontResource = mFont->GetResource();
 
 	h = mFontHeight;
-	mLastValue = parseText();
-	w = gr_measureEx(mLastValue.c_str(), fontResource);
+	if (mVarChanged)
+		refreshValue();
+	w = measureValue(fontResource);
 	return 0;
 }
 
-std::string GUIText::parseText(void)
+// Splits mText into literal and variable segments once, so updates only
+// have to look up the variables instead of re-scanning the text
+void GUIText::compileText(void)
 {
-	static int counter = 0;
-	std::string str = mText;
+	std::string literal;
 	size_t pos = 0;
-	size_t next = 0, end = 0;
+
+	mSegments.clear();
+	mTextVars.clear();
 
 	while (1)
 	{
-		next = str.find('%', pos);
-		if (next == std::string::npos) return str;
-		end = str.find('%', next + 1);
-		if (end == std::string::npos) return str;
-
-		// We have a block of data
-		std::string var = str.substr(next + 1, (end - next) - 1);
-		str.erase(next, (end - next) + 1);
-
-		if (next + 1 == end)
+		size_t next = mText.find('%', pos);
+		size_t end = (next == std::string::npos ? next : mText.find('%', next + 1));
+		if (end == std::string::npos)
 		{
-			str.insert(next, 1, '%');
+			literal.append(mText, pos, std::string::npos);
+			break;
 		}
+
+		literal.append(mText, pos, next - pos);
+		if (next + 1 == end)
+			literal += '%';
 		else
 		{
-			std::string value;
-			if (DataManager::GetValue(var, value) == 0)
-				str.insert(next, value);
+			TextSegment segment;
+
+			if (!literal.empty())
+			{
+				segment.text = literal;
+				segment.isVar = false;
+				mSegments.push_back(segment);
+				literal.clear();
+			}
+			segment.text = mText.substr(next + 1, (end - next) - 1);
+			segment.isVar = true;
+			mSegments.push_back(segment);
+			mTextVars.insert(segment.text);
 		}
+		pos = end + 1;
+	}
 
-		pos = next + 1;
+	if (!literal.empty())
+	{
+		TextSegment segment;
+		segment.text = literal;
+		segment.isVar = false;
+		mSegments.push_back(segment);
 	}
 }
 
+std::string GUIText::parseText(void)
+{
+	std::string str, value;
+
+	std::vector<TextSegment>::iterator iter;
+	for (iter = mSegments.begin(); iter != mSegments.end(); ++iter)
+	{
+		if (!iter->isVar)
+			str += iter->text;
+		else if (DataManager::GetValue(iter->text, value) == 0)
+			str += value;
+	}
+	return str;
+}
+
+// Re-evaluates the text, returns true if it changed
+bool GUIText::refreshValue(void)
+{
+	mVarChanged = 0;
+
+	std::string newValue = parseText();
+	if (mLastValue == newValue)
+		return false;
+
+	mLastValue = newValue;
+	mWidthValid = false;
+	return true;
+}
+
+// Width of the displayed text, only measured again when it changes
+int GUIText::measureValue(void* fontResource)
+{
+	if (!mWidthValid)
+	{
+		const char* displayValue = mLastValue.c_str();
+		if (charSkip)
+			displayValue += (charSkip < mLastValue.length() ? charSkip : mLastValue.length());
+		mLastWidth = gr_measureEx(displayValue, fontResource);
+		mWidthValid = true;
+	}
+	return mLastWidth;
+}
+
 int GUIText::NotifyVarChange(const std::string& varName, const std::string& value)
 {
 	GUIObject::NotifyVarChange(varName, value);
 
-	mVarChanged = 1;
+	if (varName.empty() || mTextVars.count(varName))
+		mVarChanged = 1;
 	return 0;
 }
 
+bool GUIText::GetWatchedVars(std::set<std::string>& vars)
+{
+	GUIObject::GetWatchedVars(vars);
+	vars.insert(mTextVars.begin(), mTextVars.end());
+	return true;
+}
+
 int GUIText::SetMaxWidth(unsigned width)
 {
 	maxWidth = width;
@@ -240,6 +305,6 @@ int GUIText::SetMaxWidth(unsigned width)
 int GUIText::SkipCharCount(unsigned skip)
 {
 	charSkip = skip;
-	mVarChanged = 1;
+	mWidthValid = false;
 	return 0;
 }
@@ -31,28 +31,163 @@
 #include "selinux/selinux.h"
 #endif
 
-struct tar_dev
-{
-	dev_t td_dev;
-	libtar_hash_t *td_h;
-};
-typedef struct tar_dev tar_dev_t;
+#include "../twtrace.h"
 
+/*
+** Hardlink tracking.  Only files with more than one link can be the
+** target of a later hardlink, so only those are recorded, in an
+** open-addressing table keyed on (device, inode).  The archived names
+** are packed into a single growing arena and referenced by offset.
+*/
 struct tar_ino
 {
+	dev_t ti_dev;
 	ino_t ti_ino;
-	char ti_name[MAXPATHLEN];
+	size_t ti_name;		/* offset into tt_names, 0 for a free slot */
 };
 typedef struct tar_ino tar_ino_t;
 
+struct tar_ino_table
+{
+	tar_ino_t *tt_slots;
+	unsigned int tt_size;	/* number of slots, a power of two */
+	unsigned int tt_used;
+	char *tt_names;
+	size_t tt_names_len;
+	size_t tt_names_size;
+};
 
-/* free memory associated with a tar_dev_t */
+#define TAR_INO_TABLE_MIN	256
+#define TAR_INO_NAMES_MIN	16384
+
+
+/* free memory associated with a tar_ino_table */
 void
-tar_dev_free(tar_dev_t *tdp)
+tar_ino_table_free(struct tar_ino_table *tt)
+{
+	free(tt->tt_slots);
+	free(tt->tt_names);
+	free(tt);
+}
+
+
+static unsigned int
+tar_ino_hash(dev_t dev, ino_t ino)
+{
+	unsigned long long key = ((unsigned long long)dev << 32) ^ ino;
+
+	key *= 0x9E3779B97F4A7C15ULL;
+	return (unsigned int)(key >> 32);
+}
+
+
+/* find the slot for (dev, ino), or the free slot where it belongs */
+static tar_ino_t *
+tar_ino_find(struct tar_ino_table *tt, dev_t dev, ino_t ino)
+{
+	unsigned int i, mask = tt->tt_size - 1;
+
+	for (i = tar_ino_hash(dev, ino) & mask; tt->tt_slots[i].ti_name != 0;
+	     i = (i + 1) & mask)
+		if (tt->tt_slots[i].ti_ino == ino && tt->tt_slots[i].ti_dev == dev)
+			break;
+
+	return &tt->tt_slots[i];
+}
+
+
+/* keep the table at most half full */
+static int
+tar_ino_reserve(struct tar_ino_table *tt)
+{
+	tar_ino_t *old = tt->tt_slots;
+	unsigned int i, old_size = tt->tt_size;
+
+	if ((tt->tt_used + 1) * 2 <= tt->tt_size)
+		return 0;
+
+	tt->tt_size = (old_size ? old_size * 2 : TAR_INO_TABLE_MIN);
+	tt->tt_slots = (tar_ino_t *)calloc(tt->tt_size, sizeof(tar_ino_t));
+	if (tt->tt_slots == NULL)
+	{
+		tt->tt_slots = old;
+		tt->tt_size = old_size;
+		return -1;
+	}
+	for (i = 0; i < old_size; i++)
+		if (old[i].ti_name != 0)
+			*tar_ino_find(tt, old[i].ti_dev, old[i].ti_ino) = old[i];
+	free(old);
+
+	return 0;
+}
+
+
+/* copy name into the arena, returning its offset or 0 on failure */
+static size_t
+tar_ino_save_name(struct tar_ino_table *tt, char *name)
+{
+	size_t len = strlen(name) + 1, offset;
+	char *names;
+
+	if (tt->tt_names_len + len > tt->tt_names_size)
+	{
+		size_t size = (tt->tt_names_size ? tt->tt_names_size
+			       : TAR_INO_NAMES_MIN);
+
+		while (size < tt->tt_names_len + len)
+			size *= 2;
+		names = (char *)realloc(tt->tt_names, size);
+		if (names == NULL)
+			return 0;
+		tt->tt_names = names;
+		tt->tt_names_size = size;
+		/* offset 0 marks a free slot, so it never holds a name */
+		if (tt->tt_names_len == 0)
+			tt->tt_names_len = 1;
+	}
+	offset = tt->tt_names_len;
+	memcpy(tt->tt_names + offset, name, len);
+	tt->tt_names_len += len;
+
+	return offset;
+}
+
+
+#ifdef HAVE_SELINUX
+/*
+** return the archive's shared copy of context.  A partition only has a
+** few hundred distinct contexts, so each is stored once per handle and
+** th_buf.selinux_context points at it rather than owning a copy.
+*/
+static char *
+tar_intern_context(TAR *t, char *context)
 {
-	libtar_hash_free(tdp->td_h, free);
-	free(tdp);
+	libtar_hashptr_t hp;
+	char *p;
+
+	if (t->contexts == NULL)
+	{
+		t->contexts = libtar_hash_new(256,
+					      (libtar_hashfunc_t)path_fullhash);
+		if (t->contexts == NULL)
+			return NULL;
+	}
+
+	libtar_hashptr_reset(&hp);
+	if (libtar_hash_getkey(t->contexts, &hp, context,
+			       (libtar_matchfunc_t)libtar_str_match) != 0)
+		return (char *)libtar_hashptr_data(&hp);
+
+	p = strdup(context);
+	if (p != NULL && libtar_hash_add(t->contexts, p) != 0)
+	{
+		free(p);
+		p = NULL;
+	}
+	return p;
 }
+#endif
 
 
 /* appends a file to the tar archive */
@@ -61,8 +196,7 @@ tar_append_file(TAR *t, char *realname, char *savename)
 {
 	struct stat s;
 	int i;
-	libtar_hashptr_t hp;
-	tar_dev_t *td = NULL;
+	struct tar_ino_table *tt;
 	tar_ino_t *ti = NULL;
 	char path[MAXPATHLEN];
 
@@ -96,69 +230,61 @@ tar_append_file(TAR *t, char *realname, char *savename)
 #ifdef HAVE_SELINUX
 	/* get selinux context */
 	if(t->options & TAR_STORE_SELINUX) {
-		if(t->th_buf.selinux_context != NULL) {
-			free(t->th_buf.selinux_context);
-			t->th_buf.selinux_context = NULL;
-		}
-
+		unsigned long long trace_start;
+		TWTRACE_TOTAL_BEGIN(trace_start);
 		security_context_t selinux_context = NULL;
 		if (lgetfilecon(realname, &selinux_context) >= 0) {
-			t->th_buf.selinux_context = strdup(selinux_context);
+			t->th_buf.selinux_context = tar_intern_context(t, selinux_context);
+#ifdef DEBUG
 			printf("setting selinux context: %s\n", selinux_context);
+#endif
 			freecon(selinux_context);
 		}
 		else
 			perror("Failed to get selinux context");
+		TWTRACE_TOTAL_END(t->trace_getfilecon, trace_start);
 	}
 #endif
 	/* check if it's a hardlink */
-#ifdef DEBUG
-	puts("    tar_append_file(): checking inode cache for hardlink...");
-#endif
-	libtar_hashptr_reset(&hp);
-	if (libtar_hash_getkey(t->h, &hp, &(s.st_dev),
-			       (libtar_matchfunc_t)dev_match) != 0)
-		td = (tar_dev_t *)libtar_hashptr_data(&hp);
-	else
+	if (!S_ISDIR(s.st_mode) && s.st_nlink > 1)
 	{
 #ifdef DEBUG
-		printf("+++ adding hash for device (0x%lx, 0x%lx)...\n",
-		       major(s.st_dev), minor(s.st_dev));
+		puts("    tar_append_file(): checking inode cache for hardlink...");
 #endif
-		td = (tar_dev_t *)calloc(1, sizeof(tar_dev_t));
-		td->td_dev = s.st_dev;
-		td->td_h = libtar_hash_new(256, (libtar_hashfunc_t)ino_hash);
-		if (td->td_h == NULL)
-			return -1;
-		if (libtar_hash_add(t->h, td) == -1)
+		tt = t->inotab;
+		if (tt == NULL)
+		{
+			tt = (struct tar_ino_table *)calloc(1, sizeof(struct tar_ino_table));
+			if (tt == NULL)
+				return -1;
+			t->inotab = tt;
+		}
+		if (tar_ino_reserve(tt) != 0)
 			return -1;
-	}
-	libtar_hashptr_reset(&hp);
-	if (libtar_hash_getkey(td->td_h, &hp, &(s.st_ino),
-			       (libtar_matchfunc_t)ino_match) != 0)
-	{
-		ti = (tar_ino_t *)libtar_hashptr_data(&hp);
+		ti = tar_ino_find(tt, s.st_dev, s.st_ino);
+		if (ti->ti_name != 0)
+		{
 #ifdef DEBUG
-		printf("    tar_append_file(): encoding hard link \"%s\" "
-		       "to \"%s\"...\n", realname, ti->ti_name);
+			printf("    tar_append_file(): encoding hard link \"%s\" "
+			       "to \"%s\"...\n", realname, tt->tt_names + ti->ti_name);
 #endif
-		t->th_buf.typeflag = LNKTYPE;
-		th_set_link(t, ti->ti_name);
-	}
-	else
-	{
+			t->th_buf.typeflag = LNKTYPE;
+			th_set_link(t, tt->tt_names + ti->ti_name);
+		}
+		else
+		{
 #ifdef DEBUG
-		printf("+++ adding entry: device (0x%lx,0x%lx), inode %ld "
-		       "(\"%s\")...\n", major(s.st_dev), minor(s.st_dev),
-		       s.st_ino, realname);
+			printf("+++ adding entry: device (0x%lx,0x%lx), inode %ld "
+			       "(\"%s\")...\n", major(s.st_dev), minor(s.st_dev),
+			       s.st_ino, realname);
 #endif
-		ti = (tar_ino_t *)calloc(1, sizeof(tar_ino_t));
-		if (ti == NULL)
-			return -1;
-		ti->ti_ino = s.st_ino;
-		snprintf(ti->ti_name, sizeof(ti->ti_name), "%s",
-			 savename ? savename : realname);
-		libtar_hash_add(td->td_h, ti);
+			ti->ti_name = tar_ino_save_name(tt, savename ? savename : realname);
+			if (ti->ti_name == 0)
+				return -1;
+			ti->ti_dev = s.st_dev;
+			ti->ti_ino = s.st_ino;
+			tt->tt_used++;
+		}
 	}
 
 	/* check if it's a symlink */
@@ -197,8 +323,16 @@ tar_append_file(TAR *t, char *realname, char *savename)
 #endif
 
 	/* if it's a regular file, write the contents as well */
-	if (TH_ISREG(t) && tar_append_regfile(t, realname) != 0)
-		return -1;
+	if (TH_ISREG(t))
+	{
+		unsigned long long trace_start;
+
+		TWTRACE_TOTAL_BEGIN(trace_start);
+		i = tar_append_regfile(t, realname);
+		TWTRACE_TOTAL_END(t->trace_append_regfile, trace_start);
+		if (i != 0)
+			return -1;
+	}
 
 	return 0;
 }
@@ -17,70 +17,205 @@
 #include <sys/types.h>
 #include <fcntl.h>
 #include <errno.h>
-#include <utime.h>
+#include <sys/stat.h>
 
-#define DEBUG
 #ifdef STDC_HEADERS
 # include <stdlib.h>
+# include <string.h>
 #endif
 
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
 #endif
 
-#define DEBUG
+#include "../twtrace.h"
 
+/*
+** Per-handle extraction state.  Entries in an archive mostly arrive
+** grouped by directory, so the parent of the last entry is kept open and
+** new entries are created relative to it, and every directory that is
+** known to exist is remembered so mkdirhier() runs once per directory
+** rather than once per file.
+*/
+struct tar_dircache
+{
+	libtar_hash_t *made;		/* directories known to exist */
+	char path[MAXPATHLEN];		/* directory open as fd */
+	size_t len;
+	int fd;
+};
+
+
+void
+tar_dircache_free(struct tar_dircache *dc)
+{
+	if (dc->fd >= 0)
+		close(dc->fd);
+	libtar_hash_free(dc->made, free);
+	free(dc);
+}
+
+
+static int
+tar_dircache_known(struct tar_dircache *dc, char *path)
+{
+	libtar_hashptr_t hp;
+
+	libtar_hashptr_reset(&hp);
+	return libtar_hash_getkey(dc->made, &hp, path,
+				  (libtar_matchfunc_t)libtar_str_match);
+}
+
+
+static void
+tar_dircache_add(struct tar_dircache *dc, char *path)
+{
+	char *p;
+
+	if (tar_dircache_known(dc, path))
+		return;
+	p = strdup(path);
+	if (p != NULL && libtar_hash_add(dc->made, p) != 0)
+		free(p);
+}
+
+
+/*
+** tar_parent_fd() - create the parent directories of filename if needed
+** and return a descriptor for the parent, setting *name to the last
+** component of filename for use with the *at() calls
+** returns:
+**	descriptor or AT_FDCWD		success
+**	-1 (and sets errno)		error
+*/
+static int
+tar_parent_fd(TAR *t, char *filename, char **name)
+{
+	struct tar_dircache *dc = t->dircache;
+	size_t len;
+	int fd;
+
+	if (dc == NULL)
+	{
+		dc = (struct tar_dircache *)calloc(1, sizeof(struct tar_dircache));
+		if (dc == NULL)
+			return -1;
+		dc->made = libtar_hash_new(1024,
+					   (libtar_hashfunc_t)path_fullhash);
+		if (dc->made == NULL)
+		{
+			free(dc);
+			return -1;
+		}
+		dc->fd = -1;
+		t->dircache = dc;
+	}
+
+	/* directory entries may carry a trailing slash */
+	len = strlen(filename);
+	while (len > 1 && filename[len - 1] == '/')
+		len--;
+	while (len > 0 && filename[len - 1] != '/')
+		len--;
+	*name = filename + len;
+	if (len == 0)
+		return AT_FDCWD;
+	if (len > 1)
+		len--;
+
+	if (dc->fd >= 0 && dc->len == len
+	    && strncmp(dc->path, filename, len) == 0)
+		return dc->fd;
+
+	if (len >= sizeof(dc->path))
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	if (dc->fd >= 0)
+	{
+		close(dc->fd);
+		dc->fd = -1;
+	}
+	memcpy(dc->path, filename, len);
+	dc->path[len] = '\0';
+	dc->len = len;
+
+	if (!tar_dircache_known(dc, dc->path))
+	{
+		if (mkdirhier(dc->path) == -1)
+			return -1;
+		tar_dircache_add(dc, dc->path);
+	}
+	fd = open(dc->path, O_RDONLY | O_DIRECTORY);
+	if (fd == -1)
+		return -1;
+	dc->fd = fd;
+
+	return fd;
+}
+
+
+/*
+** tar_set_file_perms() - apply owner, times and mode to name in dirfd,
+** or to fd when the file is still open
+*/
 static int
-tar_set_file_perms(TAR *t, char *realname)
+tar_set_file_perms(TAR *t, int dirfd, char *name, int fd)
 {
 	mode_t mode;
 	uid_t uid;
 	gid_t gid;
-	struct utimbuf ut;
-	char *filename;
+	struct timespec ts[2];
+	int i;
 
-	filename = (realname ? realname : th_get_pathname(t));
 	mode = th_get_mode(t);
 	uid = th_get_uid(t);
 	gid = th_get_gid(t);
-	ut.modtime = ut.actime = th_get_mtime(t);
+	ts[0].tv_sec = ts[1].tv_sec = th_get_mtime(t);
+	ts[0].tv_nsec = ts[1].tv_nsec = 0;
 
 #ifdef DEBUG
 	printf("   ==> setting perms: %s (mode %04o, uid %d, gid %d)\n",
-	       filename, mode, uid, gid);
+	       name, mode, uid, gid);
 #endif
 
 	/* change owner/group */
 	if (geteuid() == 0)
-#ifdef HAVE_LCHOWN
-		if (lchown(filename, uid, gid) == -1)
+	{
+		if (fd >= 0)
+			i = fchown(fd, uid, gid);
+		else
+			i = fchownat(dirfd, name, uid, gid,
+				     AT_SYMLINK_NOFOLLOW);
+		if (i == -1)
 		{
-# ifdef DEBUG
+#ifdef DEBUG
 			fprintf(stderr, "lchown(\"%s\", %d, %d): %s\n",
-				filename, uid, gid, strerror(errno));
-# endif
-#else /* ! HAVE_LCHOWN */
-		if (!TH_ISSYM(t) && chown(filename, uid, gid) == -1)
-		{
-# ifdef DEBUG
-			fprintf(stderr, "chown(\"%s\", %d, %d): %s\n",
-				filename, uid, gid, strerror(errno));
-# endif
-#endif /* HAVE_LCHOWN */
+				name, uid, gid, strerror(errno));
+#endif
 			return -1;
 		}
+	}
+
+	if (TH_ISSYM(t))
+		return 0;
 
 	/* change access/modification time */
-	if (!TH_ISSYM(t) && utime(filename, &ut) == -1)
+	if (utimensat(dirfd, name, ts, 0) == -1)
 	{
 #ifdef DEBUG
-		perror("utime()");
+		perror("utimensat()");
 #endif
 		return -1;
 	}
 
 	/* change permissions */
-	if (!TH_ISSYM(t) && chmod(filename, mode) == -1)
+	if (fd >= 0)
+		i = fchmod(fd, mode);
+	else
+		i = fchmodat(dirfd, name, mode, 0);
+	if (i == -1)
 	{
 #ifdef DEBUG
 		perror("chmod()");
@@ -92,66 +227,72 @@ tar_set_file_perms(TAR *t, char *realname)
 }
 
 
+static int tar_extract_regfile_fd(TAR *t, char *realname, int *fdp);
+
+
 /* switchboard */
 int
 tar_extract_file(TAR *t, char *realname, char *prefix)
 {
-	int i;
-	char *lnp;
-	int pathname_len;
-	int realname_len;
+	int i, dirfd, fd = -1;
+	char *filename, *name;
+	unsigned long long trace_start;
+
+	filename = (realname ? realname : th_get_pathname(t));
 
 	if (t->options & TAR_NOOVERWRITE)
 	{
 		struct stat s;
 
-		if (lstat(realname, &s) == 0 || errno != ENOENT)
+		if (lstat(filename, &s) == 0 || errno != ENOENT)
 		{
 			errno = EEXIST;
 			return -1;
 		}
 	}
 
+	TWTRACE_TOTAL_BEGIN(trace_start);
 	if (TH_ISDIR(t))
 	{
-		printf("dir\n");
-		i = tar_extract_dir(t, realname);
+		i = tar_extract_dir(t, filename);
 		if (i == 1)
 			i = 0;
 	}
-	else if (TH_ISLNK(t)) {
-		printf("link\n");
-		i = tar_extract_hardlink(t, realname, prefix);
-	}
-	else if (TH_ISSYM(t)) {
-		printf("sym\n");
-		i = tar_extract_symlink(t, realname);
-	}
-	else if (TH_ISCHR(t)) {
-		printf("chr\n");
-		i = tar_extract_chardev(t, realname);
-	}
-	else if (TH_ISBLK(t)) {
-		printf("blk\n");
-		i = tar_extract_blockdev(t, realname);
-	}
-	else if (TH_ISFIFO(t)) {
-		printf("fifo\n");
-		i = tar_extract_fifo(t, realname);
-	}
-	else /* if (TH_ISREG(t)) */ {
-		printf("reg\n");
-		i = tar_extract_regfile(t, realname);
-	}
+	else if (TH_ISLNK(t))
+		i = tar_extract_hardlink(t, filename, prefix);
+	else if (TH_ISSYM(t))
+		i = tar_extract_symlink(t, filename);
+	else if (TH_ISCHR(t))
+		i = tar_extract_chardev(t, filename);
+	else if (TH_ISBLK(t))
+		i = tar_extract_blockdev(t, filename);
+	else if (TH_ISFIFO(t))
+		i = tar_extract_fifo(t, filename);
+	else /* if (TH_ISREG(t)) */
+		i = tar_extract_regfile_fd(t, filename, &fd);
+	TWTRACE_TOTAL_END(t->trace_extract_data, trace_start);
 
 	if (i != 0) {
-		printf("FAILED RESTORE OF FILE i: %s\n", realname);
+		printf("FAILED RESTORE OF FILE i: %s\n", filename);
 		return i;
 	}
 
-	i = tar_set_file_perms(t, realname);
+	/* the parent is the cached directory the entry was created in */
+	dirfd = tar_parent_fd(t, filename, &name);
+	if (dirfd == -1)
+	{
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	TWTRACE_TOTAL_BEGIN(trace_start);
+	i = tar_set_file_perms(t, dirfd, name, fd);
+	TWTRACE_TOTAL_END(t->trace_set_file_perms, trace_start);
 	if (i != 0) {
 		printf("FAILED SETTING PERMS: %d\n", i);
+		if (fd >= 0)
+			close(fd);
 		return i;
 	}
 
@@ -159,48 +300,40 @@ tar_extract_file(TAR *t, char *realname, char *prefix)
 	if((t->options & TAR_STORE_SELINUX) && t->th_buf.selinux_context != NULL)
 	{
 #ifdef DEBUG
-		printf("   Restoring SELinux context %s to file %s\n", t->th_buf.selinux_context, realname);
+		printf("   Restoring SELinux context %s to file %s\n", t->th_buf.selinux_context, filename);
 #endif
-		if (lsetfilecon(realname, t->th_buf.selinux_context) < 0) {
+		TWTRACE_TOTAL_BEGIN(trace_start);
+		if (fd >= 0)
+			i = fsetfilecon(fd, t->th_buf.selinux_context);
+		else
+			i = lsetfilecon(filename, t->th_buf.selinux_context);
+		if (i < 0) {
 			fprintf(stderr, "Failed to restore SELinux context %s!\n", strerror(errno));
 		}
+		TWTRACE_TOTAL_END(t->trace_setfilecon, trace_start);
 	}
 #endif
 
-/*
-	pathname_len = strlen(th_get_pathname(t)) + 1;
-	realname_len = strlen(realname) + 1;
-	lnp = (char *)calloc(1, pathname_len + realname_len);
-	if (lnp == NULL)
+	if (fd >= 0 && close(fd) == -1)
 		return -1;
-	strcpy(&lnp[0], th_get_pathname(t));
-	strcpy(&lnp[pathname_len], realname);
-#ifdef DEBUG
-	printf("tar_extract_file(): calling libtar_hash_add(): key=\"%s\", "
-	       "value=\"%s\"\n", th_get_pathname(t), realname);
-#endif
-	if (libtar_hash_add(t->h, lnp) != 0)
-		return -1;
-	free(lnp);
-*/
+
 	return 0;
 }
 
 
-/* extract regular file */
-int
-tar_extract_regfile(TAR *t, char *realname)
+/*
+** extract a regular file, leaving it open in *fdp so the caller can
+** apply its metadata through the descriptor
+*/
+static int
+tar_extract_regfile_fd(TAR *t, char *realname, int *fdp)
 {
-	//mode_t mode;
 	size_t size;
-	//uid_t uid;
-	//gid_t gid;
-	int fdout;
+	int dirfd, fdout;
 	int i, k;
 	char buf[T_BLOCKSIZE];
-	char *filename;
+	char *filename, *name;
 
-	fflush(NULL);
 #ifdef DEBUG
 	printf("==> tar_extract_regfile(t=0x%lx, realname=\"%s\")\n", t,
 	       realname);
@@ -213,21 +346,17 @@ tar_extract_regfile(TAR *t, char *realname)
 	}
 
 	filename = (realname ? realname : th_get_pathname(t));
-	//mode = th_get_mode(t);
 	size = th_get_size(t);
-	//uid = th_get_uid(t);
-	//gid = th_get_gid(t);
 
-	if (mkdirhier(dirname(filename)) == -1)
+	dirfd = tar_parent_fd(t, filename, &name);
+	if (dirfd == -1)
 		return -1;
 
 #ifdef DEBUG
-	//printf("  ==> extracting: %s (mode %04o, uid %d, gid %d, %d bytes)\n",
-	//       filename, mode, uid, gid, size);
 	printf("  ==> extracting: %s (file size %d bytes)\n",
 	       filename, size);
 #endif
-	fdout = open(filename, O_WRONLY | O_CREAT | O_TRUNC
+	fdout = openat(dirfd, name, O_WRONLY | O_CREAT | O_TRUNC
 #ifdef O_BINARY
 		     | O_BINARY
 #endif
@@ -240,26 +369,6 @@ tar_extract_regfile(TAR *t, char *realname)
 		return -1;
 	}
 
-#if 0
-	/* change the owner.  (will only work if run as root) */
-	if (fchown(fdout, uid, gid) == -1 && errno != EPERM)
-	{
-#ifdef DEBUG
-		perror("fchown()");
-#endif
-		return -1;
-	}
-
-	/* make sure the mode isn't inheritted from a file we're overwriting */
-	if (fchmod(fdout, mode & 07777) == -1)
-	{
-#ifdef DEBUG
-		perror("fchmod()");
-#endif
-		return -1;
-	}
-#endif
-
 	/* extract the file */
 	for (i = size; i > 0; i -= T_BLOCKSIZE)
 	{
@@ -268,27 +377,42 @@ tar_extract_regfile(TAR *t, char *realname)
 		{
 			if (k != -1)
 				errno = EINVAL;
+			close(fdout);
 			return -1;
 		}
 
 		/* write block to output file */
 		if (write(fdout, buf,
 			  ((i > T_BLOCKSIZE) ? T_BLOCKSIZE : i)) == -1)
+		{
+			close(fdout);
 			return -1;
+		}
 	}
 
-	/* close output file */
-	if (close(fdout) == -1)
-		return -1;
-
 #ifdef DEBUG
 	printf("### done extracting %s\n", filename);
 #endif
 
+	*fdp = fdout;
 	return 0;
 }
 
 
+/* extract regular file */
+int
+tar_extract_regfile(TAR *t, char *realname)
+{
+	int fdout;
+
+	if (tar_extract_regfile_fd(t, realname, &fdout) != 0)
+		return -1;
+
+	/* close output file */
+	return close(fdout);
+}
+
+
 /* skip regfile */
 int
 tar_skip_regfile(TAR *t)
@@ -323,10 +447,11 @@ tar_skip_regfile(TAR *t)
 int
 tar_extract_hardlink(TAR * t, char *realname, char *prefix)
 {
-	char *filename;
+	char *filename, *name;
 	char *linktgt = NULL;
 	char *lnp;
 	libtar_hashptr_t hp;
+	int dirfd;
 
 	if (!TH_ISLNK(t))
 	{
@@ -335,7 +460,8 @@ tar_extract_hardlink(TAR * t, char *realname, char *prefix)
 	}
 
 	filename = (realname ? realname : th_get_pathname(t));
-	if (mkdirhier(dirname(filename)) == -1)
+	dirfd = tar_parent_fd(t, filename, &name);
+	if (dirfd == -1)
 		return -1;
 	libtar_hashptr_reset(&hp);
 	if (libtar_hash_getkey(t->h, &hp, th_get_linkname(t),
@@ -351,7 +477,7 @@ tar_extract_hardlink(TAR * t, char *realname, char *prefix)
 #ifdef DEBUG
 	printf("  ==> extracting: %s (link to %s)\n", filename, linktgt);
 #endif
-	if (link(linktgt, filename) == -1)
+	if (linkat(AT_FDCWD, linktgt, dirfd, name, 0) == -1)
 	{
 #ifdef DEBUG
 		perror("link()");
@@ -368,7 +494,8 @@ tar_extract_hardlink(TAR * t, char *realname, char *prefix)
 int
 tar_extract_symlink(TAR *t, char *realname)
 {
-	char *filename;
+	char *filename, *name;
+	int dirfd;
 
 	if (!TH_ISSYM(t))
 	{
@@ -378,14 +505,14 @@ tar_extract_symlink(TAR *t, char *realname)
 	}
 
 	filename = (realname ? realname : th_get_pathname(t));
-	printf("file: %s\n", filename);
-	if (mkdirhier(dirname(filename)) == -1) {
-		printf("mkdirhier\n");
+	dirfd = tar_parent_fd(t, filename, &name);
+	if (dirfd == -1) {
+		printf("mkdirhier failed for %s\n", filename);
 		return -1;
 	}
 
-	if (unlink(filename) == -1 && errno != ENOENT) {
-		printf("unlink\n");
+	if (unlinkat(dirfd, name, 0) == -1 && errno != ENOENT) {
+		printf("unlink failed for %s\n", filename);
 		return -1;
 	}
 
@@ -393,7 +520,7 @@ tar_extract_symlink(TAR *t, char *realname)
 	printf("  ==> extracting: %s (symlink to %s)\n",
 	       filename, th_get_linkname(t));
 #endif
-	if (symlink(th_get_linkname(t), filename) == -1)
+	if (symlinkat(th_get_linkname(t), dirfd, name) == -1)
 	{
 #ifdef DEBUG
 		perror("symlink()");
@@ -411,7 +538,8 @@ tar_extract_chardev(TAR *t, char *realname)
 {
 	mode_t mode;
 	unsigned long devmaj, devmin;
-	char *filename;
+	char *filename, *name;
+	int dirfd;
 
 	if (!TH_ISCHR(t))
 	{
@@ -424,14 +552,15 @@ tar_extract_chardev(TAR *t, char *realname)
 	devmaj = th_get_devmajor(t);
 	devmin = th_get_devminor(t);
 
-	if (mkdirhier(dirname(filename)) == -1)
+	dirfd = tar_parent_fd(t, filename, &name);
+	if (dirfd == -1)
 		return -1;
 
 #ifdef DEBUG
 	printf("  ==> extracting: %s (character device %ld,%ld)\n",
 	       filename, devmaj, devmin);
 #endif
-	if (mknod(filename, mode | S_IFCHR,
+	if (mknodat(dirfd, name, mode | S_IFCHR,
 		  compat_makedev(devmaj, devmin)) == -1)
 	{
 #ifdef DEBUG
@@ -450,7 +579,8 @@ tar_extract_blockdev(TAR *t, char *realname)
 {
 	mode_t mode;
 	unsigned long devmaj, devmin;
-	char *filename;
+	char *filename, *name;
+	int dirfd;
 
 	if (!TH_ISBLK(t))
 	{
@@ -463,14 +593,15 @@ tar_extract_blockdev(TAR *t, char *realname)
 	devmaj = th_get_devmajor(t);
 	devmin = th_get_devminor(t);
 
-	if (mkdirhier(dirname(filename)) == -1)
+	dirfd = tar_parent_fd(t, filename, &name);
+	if (dirfd == -1)
 		return -1;
 
 #ifdef DEBUG
 	printf("  ==> extracting: %s (block device %ld,%ld)\n",
 	       filename, devmaj, devmin);
 #endif
-	if (mknod(filename, mode | S_IFBLK,
+	if (mknodat(dirfd, name, mode | S_IFBLK,
 		  compat_makedev(devmaj, devmin)) == -1)
 	{
 #ifdef DEBUG
@@ -488,7 +619,10 @@ int
 tar_extract_dir(TAR *t, char *realname)
 {
 	mode_t mode;
-	char *filename;
+	char *filename, *name;
+	int dirfd;
+	size_t len;
+
 	if (!TH_ISDIR(t))
 	{
 		errno = EINVAL;
@@ -498,7 +632,8 @@ tar_extract_dir(TAR *t, char *realname)
 	filename = (realname ? realname : th_get_pathname(t));
 	mode = th_get_mode(t);
 
-	if (mkdirhier(dirname(filename)) == -1) {
+	dirfd = tar_parent_fd(t, filename, &name);
+	if (dirfd == -1) {
 		printf("tar_extract_dir mkdirhier failed\n");
 		return -1;
 	}
@@ -507,7 +642,7 @@ tar_extract_dir(TAR *t, char *realname)
 	printf("  ==> extracting: %s (mode %04o, directory)\n", filename,
 	       mode);
 #endif
-	if (mkdir(filename, mode) == -1)
+	if (mkdirat(dirfd, name, mode) == -1)
 	{
 		if (errno == EEXIST)
 		{
@@ -524,6 +659,19 @@ tar_extract_dir(TAR *t, char *realname)
 		}
 	}
 
+	/* entries below this directory need not check it again */
+	len = strlen(filename);
+	while (len > 1 && filename[len - 1] == '/')
+		len--;
+	if (len < MAXPATHLEN && filename[len] == '/')
+	{
+		filename[len] = '\0';
+		tar_dircache_add(t->dircache, filename);
+		filename[len] = '/';
+	}
+	else
+		tar_dircache_add(t->dircache, filename);
+
 	return 0;
 }
 
@@ -533,7 +681,8 @@ int
 tar_extract_fifo(TAR *t, char *realname)
 {
 	mode_t mode;
-	char *filename;
+	char *filename, *name;
+	int dirfd;
 
 	if (!TH_ISFIFO(t))
 	{
@@ -544,13 +693,14 @@ tar_extract_fifo(TAR *t, char *realname)
 	filename = (realname ? realname : th_get_pathname(t));
 	mode = th_get_mode(t);
 
-	if (mkdirhier(dirname(filename)) == -1)
+	dirfd = tar_parent_fd(t, filename, &name);
+	if (dirfd == -1)
 		return -1;
 
 #ifdef DEBUG
 	printf("  ==> extracting: %s (fifo)\n", filename);
 #endif
-	if (mkfifo(filename, mode) == -1)
+	if (mknodat(dirfd, name, (mode & 07777) | S_IFIFO, 0) == -1)
 	{
 #ifdef DEBUG
 		perror("mkfifo()");
@@ -49,15 +49,16 @@ tar_init(TAR **t, char *pathname, tartype_t *type,
 	(*t)->type = (type ? type : &default_type);
 	(*t)->oflags = oflags;
 
+	/* the hardlink table for writing is allocated on first use */
 	if ((oflags & O_ACCMODE) == O_RDONLY)
+	{
 		(*t)->h = libtar_hash_new(256,
 					  (libtar_hashfunc_t)path_hashfunc);
-	else
-		(*t)->h = libtar_hash_new(16, (libtar_hashfunc_t)dev_hash);
-	if ((*t)->h == NULL)
-	{
-		free(*t);
-		return -1;
+		if ((*t)->h == NULL)
+		{
+			free(*t);
+			return -1;
+		}
 	}
 
 	return 0;
@@ -117,10 +118,20 @@ tar_close(TAR *t)
 
 	i = (*(t->type->closefunc))(t->fd);
 
+	TWTRACE_TOTAL_EMIT(t->trace_getfilecon, "tar_getfilecon_us", "tar_getfilecon_files");
+	TWTRACE_TOTAL_EMIT(t->trace_append_regfile, "tar_append_regfile_us", "tar_append_regfile_files");
+	TWTRACE_TOTAL_EMIT(t->trace_extract_data, "tar_extract_data_us", "tar_extract_data_files");
+	TWTRACE_TOTAL_EMIT(t->trace_set_file_perms, "tar_set_file_perms_us", "tar_set_file_perms_files");
+	TWTRACE_TOTAL_EMIT(t->trace_setfilecon, "tar_setfilecon_us", "tar_setfilecon_files");
+
 	if (t->h != NULL)
-		libtar_hash_free(t->h, ((t->oflags & O_ACCMODE) == O_RDONLY
-					? free
-					: (libtar_freefunc_t)tar_dev_free));
+		libtar_hash_free(t->h, free);
+	if (t->inotab != NULL)
+		tar_ino_table_free(t->inotab);
+	if (t->contexts != NULL)
+		libtar_hash_free(t->contexts, free);
+	if (t->dircache != NULL)
+		tar_dircache_free(t->dircache);
 	free(t);
 
 	return i;
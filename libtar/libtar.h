@@ -16,6 +16,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include "tar.h"
+#include "../twtrace.h"
 
 #include "libtar_listhash.h"
 
@@ -91,6 +92,15 @@ typedef struct
 	int options;
 	struct tar_header th_buf;
 	libtar_hash_t *h;
+	struct tar_ino_table *inotab;
+	libtar_hash_t *contexts;
+	struct tar_dircache *dircache;
+	/* per-file time in the hot paths, traced once by tar_close() */
+	struct twtrace_total trace_getfilecon;
+	struct twtrace_total trace_append_regfile;
+	struct twtrace_total trace_extract_data;
+	struct twtrace_total trace_set_file_perms;
+	struct twtrace_total trace_setfilecon;
 }
 TAR;
 
@@ -128,10 +138,10 @@ int tar_close(TAR *t);
 /***** append.c ************************************************************/
 
 /* forward declaration to appease the compiler */
-struct tar_dev;
+struct tar_ino_table;
 
 /* cleanup function */
-void tar_dev_free(struct tar_dev *tdp);
+void tar_ino_table_free(struct tar_ino_table *tt);
 
 /* Appends a file to the tar archive.
  * Arguments:
@@ -225,6 +235,12 @@ void th_finish(TAR *t);
 
 /***** extract.c ***********************************************************/
 
+/* forward declaration to appease the compiler */
+struct tar_dircache;
+
+/* cleanup function */
+void tar_dircache_free(struct tar_dircache *dc);
+
 /* sequentially extract next file from t */
 int tar_extract_file(TAR *t, char *realname, char *prefix);
 
@@ -255,6 +271,9 @@ void th_print_long_ls(TAR *t);
 /* hashing function for pathnames */
 int path_hashfunc(char *key, int numbuckets);
 
+/* hashing function for full pathnames */
+unsigned int path_fullhash(char *key, unsigned int numbuckets);
+
 /* matching function for dev_t's */
 int dev_match(dev_t *dev1, dev_t *dev2);
 
@@ -35,6 +35,19 @@ path_hashfunc(char *key, int numbuckets)
 }
 
 
+/* hashing function for full pathnames */
+unsigned int
+path_fullhash(char *key, unsigned int numbuckets)
+{
+	unsigned int result = 5381;
+
+	while (*key != '\0')
+		result = result * 33U + (unsigned char)*key++;
+
+	return (result % numbuckets);
+}
+
+
 /* matching function for dev_t's */
 int
 dev_match(dev_t *dev1, dev_t *dev2)
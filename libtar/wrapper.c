@@ -10,7 +10,6 @@
 **  University of Illinois at Urbana-Champaign
 */
 
-#define DEBUG
 #include <internal.h>
 
 #include <stdio.h>
@@ -78,8 +77,8 @@ tar_extract_all(TAR *t, char *prefix)
 #ifdef DEBUG
 		printf("    tar_extract_all(): calling tar_extract_file(t, "
 		       "\"%s\")\n", buf);
-#endif
 		printf("item name: '%s'\n", filename);
+#endif
 		if (tar_extract_file(t, buf, prefix) != 0)
 			return -1;
 	}
@@ -709,7 +709,9 @@ int ev_get(struct input_event *ev, unsigned dont_wait)
             lastInputStat = curr;
         }
 
-        r = poll(ev_fds, ev_count, 0);
+        /* Block until input arrives instead of spinning; when blocking,
+         * wake up in time for the /dev/input rescan above. */
+        r = poll(ev_fds, ev_count, dont_wait ? 1 : 2000);
 
         if(r > 0) {
             for(n = 0; n < ev_count; n++) {
@@ -722,8 +724,6 @@ int ev_get(struct input_event *ev, unsigned dont_wait)
                 }
             }
         }
-
-        usleep(1000);
     } while(dont_wait == 0);
 
     return -1;
@@ -15,6 +15,7 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
 
@@ -52,6 +53,12 @@
 #define PIXEL_SIZE 2
 #endif
 
+#if PIXEL_SIZE == 4
+typedef uint32_t gr_fb_pixel;
+#else
+typedef uint16_t gr_fb_pixel;
+#endif
+
 #define NUM_BUFFERS 2
 #define MAX_DISPLAY_DIM  2048
 
@@ -60,6 +67,8 @@
 typedef struct {
     GGLSurface texture;
     unsigned offset[97];
+    unsigned width[96];
+    unsigned maxwidth;
     unsigned cheight;
     unsigned ascent;
 } GRFont;
@@ -72,6 +81,7 @@ static GGLSurface gr_mem_surface;
 static unsigned gr_active_fb = 0;
 static unsigned double_buffering = 0;
 static int gr_is_curr_clr_opaque = 0;
+static gr_fb_pixel gr_text_pixel = 0;
 
 static int gr_fb_fd = -1;
 static int gr_vt_fd = -1;
@@ -385,6 +395,67 @@ void gr_color(unsigned char r, unsigned char g, unsigned char b, unsigned char a
     gl->color4xv(gl, color);
 
     gr_is_curr_clr_opaque = (a == 255);
+
+    /* Text is drawn straight into the memory surface, keep the color in
+     * its pixel format. The glyph alpha replaces the color alpha, so it
+     * is always written opaque. */
+#if defined(RECOVERY_BGRA)
+    gr_text_pixel = b | (g << 8) | (r << 16) | (0xffu << 24);
+#elif defined(RECOVERY_RGBX)
+    gr_text_pixel = r | (g << 8) | (b << 16) | (0xffu << 24);
+#else
+    gr_text_pixel = ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3);
+#endif
+}
+
+/* Fills in the per glyph width table and the widest glyph of a font */
+static void gr_font_init_widths(GRFont* font)
+{
+    unsigned pos;
+
+    font->maxwidth = 0;
+    for (pos = 0; pos < 96; pos++)
+    {
+        font->width[pos] = font->offset[pos+1] - font->offset[pos];
+        if (font->width[pos] > font->maxwidth)
+            font->maxwidth = font->width[pos];
+    }
+}
+
+/* Copies the first w x h pixels of a glyph into the memory surface. The
+ * font bitmaps only hold 0 or 255, so blending reduces to writing the
+ * text color wherever the glyph is set. This replaces a textured recti
+ * through pixelflinger per character. */
+static void gr_draw_glyph(GRFont* font, unsigned off, int x, int y, int w, int h)
+{
+    const unsigned char* src;
+    gr_fb_pixel* dst;
+    int sx = 0, sy = 0, row, col;
+
+    if (x < 0) { sx = -x; x = 0; }
+    if (y < 0) { sy = -y; y = 0; }
+    if (x + (w - sx) > (int) gr_mem_surface.width)
+        w = gr_mem_surface.width - x + sx;
+    if (y + (h - sy) > (int) gr_mem_surface.height)
+        h = gr_mem_surface.height - y + sy;
+    if (w <= sx || h <= sy)
+        return;
+
+    src = (const unsigned char*) font->texture.data + sy * font->texture.stride + font->offset[off] + sx;
+    dst = (gr_fb_pixel*) gr_mem_surface.data + y * gr_mem_surface.stride + x;
+    w -= sx;
+    h -= sy;
+
+    for (row = 0; row < h; row++)
+    {
+        for (col = 0; col < w; col++)
+        {
+            if (src[col])
+                dst[col] = gr_text_pixel;
+        }
+        src += font->texture.stride;
+        dst += gr_mem_surface.stride;
+    }
 }
 
 int gr_measureEx(const char *s, void* font)
@@ -400,7 +471,7 @@ int gr_measureEx(const char *s, void* font)
     {
         off -= 32;
         if (off < 96)
-            total += (fnt->offset[off+1] - fnt->offset[off]);
+            total += fnt->width[off];
     }
     return total;
 }
@@ -418,7 +489,7 @@ int gr_maxExW(const char *s, void* font, int max_width)
     {
         off -= 32;
         if (off < 96) {
-            max_width -= (fnt->offset[off+1] - fnt->offset[off]);
+            max_width -= fnt->width[off];
 			if (max_width > 0) {
 				total++;
 			} else {
@@ -438,15 +509,14 @@ unsigned character_width(const char *s, void* pFont)
     if (!font)  font = gr_font;
 
 	off = *s - 32;
-	if (off == 0)
+	if (off == 0 || off >= 96)
 		return 0;
 
-	return font->offset[off+1] - font->offset[off];
+	return font->width[off];
 }
 
 int gr_textEx(int x, int y, const char *s, void* pFont)
 {
-    GGLContext *gl = gr_context;
     GRFont *font = (GRFont*) pFont;
     unsigned off;
     unsigned cwidth;
@@ -454,20 +524,12 @@ int gr_textEx(int x, int y, const char *s, void* pFont)
     /* Handle default font */
     if (!font)  font = gr_font;
 
-    gl->bindTexture(gl, &font->texture);
-    gl->texEnvi(gl, GGL_TEXTURE_ENV, GGL_TEXTURE_ENV_MODE, GGL_REPLACE);
-    gl->texGeni(gl, GGL_S, GGL_TEXTURE_GEN_MODE, GGL_ONE_TO_ONE);
-    gl->texGeni(gl, GGL_T, GGL_TEXTURE_GEN_MODE, GGL_ONE_TO_ONE);
-    gl->enable(gl, GGL_TEXTURE_2D);
-
     while((off = *s++)) {
         off -= 32;
-        cwidth = 0;
         if (off < 96) {
-            cwidth = font->offset[off+1] - font->offset[off];
-			gl->texCoord2i(gl, (font->offset[off]) - x, 0 - y);
-			gl->recti(gl, x, y, x + cwidth, y + font->cheight);
-			x += cwidth;
+            cwidth = font->width[off];
+            gr_draw_glyph(font, off, x, y, cwidth, font->cheight);
+            x += cwidth;
         }
     }
 
@@ -476,7 +538,6 @@ int gr_textEx(int x, int y, const char *s, void* pFont)
 
 int gr_textExW(int x, int y, const char *s, void* pFont, int max_width)
 {
-    GGLContext *gl = gr_context;
     GRFont *font = (GRFont*) pFont;
     unsigned off;
     unsigned cwidth;
@@ -484,27 +545,18 @@ int gr_textExW(int x, int y, const char *s, void* pFont, int max_width)
     /* Handle default font */
     if (!font)  font = gr_font;
 
-    gl->bindTexture(gl, &font->texture);
-    gl->texEnvi(gl, GGL_TEXTURE_ENV, GGL_TEXTURE_ENV_MODE, GGL_REPLACE);
-    gl->texGeni(gl, GGL_S, GGL_TEXTURE_GEN_MODE, GGL_ONE_TO_ONE);
-    gl->texGeni(gl, GGL_T, GGL_TEXTURE_GEN_MODE, GGL_ONE_TO_ONE);
-    gl->enable(gl, GGL_TEXTURE_2D);
-
     while((off = *s++)) {
         off -= 32;
-        cwidth = 0;
         if (off < 96) {
-            cwidth = font->offset[off+1] - font->offset[off];
-			if ((x + (int)cwidth) < max_width) {
-				gl->texCoord2i(gl, (font->offset[off]) - x, 0 - y);
-				gl->recti(gl, x, y, x + cwidth, y + font->cheight);
-				x += cwidth;
-			} else {
-				gl->texCoord2i(gl, (font->offset[off]) - x, 0 - y);
-				gl->recti(gl, x, y, max_width, y + font->cheight);
-				x = max_width;
-				return x;
-			}
+            cwidth = font->width[off];
+            if ((x + (int)cwidth) < max_width) {
+                gr_draw_glyph(font, off, x, y, cwidth, font->cheight);
+                x += cwidth;
+            } else {
+                gr_draw_glyph(font, off, x, y, max_width - x, font->cheight);
+                x = max_width;
+                return x;
+            }
         }
     }
 
@@ -513,7 +565,6 @@ int gr_textExW(int x, int y, const char *s, void* pFont, int max_width)
 
 int gr_textExWH(int x, int y, const char *s, void* pFont, int max_width, int max_height)
 {
-    GGLContext *gl = gr_context;
     GRFont *font = (GRFont*) pFont;
     unsigned off;
     unsigned cwidth;
@@ -522,28 +573,21 @@ int gr_textExWH(int x, int y, const char *s, void* pFont, int max_width, int max
     /* Handle default font */
     if (!font)  font = gr_font;
 
-    gl->bindTexture(gl, &font->texture);
-    gl->texEnvi(gl, GGL_TEXTURE_ENV, GGL_TEXTURE_ENV_MODE, GGL_REPLACE);
-    gl->texGeni(gl, GGL_S, GGL_TEXTURE_GEN_MODE, GGL_ONE_TO_ONE);
-    gl->texGeni(gl, GGL_T, GGL_TEXTURE_GEN_MODE, GGL_ONE_TO_ONE);
-    gl->enable(gl, GGL_TEXTURE_2D);
+    if (y + font->cheight < (unsigned int)(max_height))
+        rect_y = y + font->cheight;
+    else
+        rect_y = max_height;
 
     while((off = *s++)) {
         off -= 32;
-        cwidth = 0;
         if (off < 96) {
-            cwidth = font->offset[off+1] - font->offset[off];
+            cwidth = font->width[off];
 			if ((x + (int)cwidth) < max_width)
 				rect_x = x + cwidth;
 			else
 				rect_x = max_width;
-			if (y + font->cheight < (unsigned int)(max_height))
-				rect_y = y + font->cheight;
-			else
-				rect_y = max_height;
 
-			gl->texCoord2i(gl, (font->offset[off]) - x, 0 - y);
-			gl->recti(gl, x, y, rect_x, rect_y);
+			gr_draw_glyph(font, off, x, y, rect_x - x, rect_y - y);
 			x += cwidth;
 			if (x > max_width)
 				return x;
@@ -688,6 +732,7 @@ void* gr_loadFont(const char* fontName)
     ftex->format = GGL_PIXEL_FORMAT_A_8;
     font->cheight = height;
     font->ascent = height - 2;
+    gr_font_init_widths(font);
     return (void*) font;
 }
 
@@ -699,19 +744,7 @@ int gr_getFontDetails(void* font, unsigned* cheight, unsigned* maxwidth)
     if (!fnt)   return -1;
 
     if (cheight)    *cheight = fnt->cheight;
-    if (maxwidth)
-    {
-        int pos;
-        *maxwidth = 0;
-        for (pos = 0; pos < 96; pos++)
-        {
-            unsigned int width = fnt->offset[pos+1] - fnt->offset[pos];
-            if (width > *maxwidth)
-            {
-                *maxwidth = width;
-            }
-        }
-    }
+    if (maxwidth)   *maxwidth = fnt->maxwidth;
     return 0;
 }
 
@@ -752,6 +785,7 @@ static void gr_init_font(void)
     ftex->format = GGL_PIXEL_FORMAT_A_8;
     gr_font->cheight = height;
     gr_font->ascent = height - 2;
+    gr_font_init_widths(gr_font);
     return;
 }
 
@@ -19,6 +19,7 @@
 #include "Bits.h"
 #include "Log.h"
 #include "DirUtil.h"
+#include "../twtrace.h"
 
 #undef NDEBUG   // do this after including Log.h
 #include <assert.h>
@@ -676,6 +677,7 @@ bool mzProcessZipEntryContents(const ZipArchive *pArchive,
     bool ret = false;
     off_t oldOff;
 
+    TWTRACE_BEGIN("mzProcessZipEntryContents");
     /* save current offset */
     oldOff = lseek(pArchive->fd, 0, SEEK_CUR);
 
@@ -697,6 +699,7 @@ bool mzProcessZipEntryContents(const ZipArchive *pArchive,
 
     /* restore file offset */
     lseek(pArchive->fd, oldOff, SEEK_SET);
+    TWTRACE_END("mzProcessZipEntryContents");
     return ret;
 }
 
@@ -26,6 +26,10 @@
 #include <dirent.h>
 #include <iostream>
 #include <sstream>
+#include <map>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
 
 #ifdef TW_INCLUDE_CRYPTO
 	#include "cutils/properties.h"
@@ -41,6 +45,7 @@
 #include "twrpTar.hpp"
 #include "twrpDU.hpp"
 #include "fixPermissions.hpp"
+#include "twtrace.h"
 extern "C" {
 	#include "mtdutils/mtdutils.h"
 	#include "mtdutils/mounts.h"
@@ -161,10 +166,17 @@ TWPartition::TWPartition(void) {
 #ifdef BUILD_SAFESTRAP
 	Hidden = false;
 #endif
+	FS_Type_From_Cache = false;
+	Size_Thread_Running = false;
+	Size_Thread_Cancel = false;
+	Size_Thread_Done = false;
+	Size_Thread_Result = 0;
+	Size_Thread_Extra = 0;
+	Backup_Size_Estimated = false;
 }
 
 TWPartition::~TWPartition(void) {
-	// Do nothing
+	Cancel_Backup_Size();
 }
 
 bool TWPartition::Process_Fstab_Line(string Line, bool Display_Error) {
@@ -1042,6 +1054,13 @@ bool TWPartition::Mount(bool Display_Error) {
 			}
 		} else {
 #endif
+			if (FS_Type_From_Cache) {
+				// The device may have been reformatted behind our back
+				LOGINFO("Mounting '%s' as cached type '%s' failed, probing again\n", Mount_Point.c_str(), Current_File_System.c_str());
+				Forget_FS_Types(Actual_Block_Device);
+				FS_Type_From_Cache = false;
+				return Mount(Display_Error);
+			}
 			if (!Removable && Display_Error)
 				LOGERR("Unable to mount '%s'\n", Mount_Point.c_str());
 			else
@@ -1082,6 +1101,8 @@ bool TWPartition::Mount(bool Display_Error) {
 }
 
 bool TWPartition::UnMount(bool Display_Error) {
+	// A background du would keep the mount busy
+	Cancel_Backup_Size();
 	if (Is_Mounted()) {
 		int never_unmount_system;
 
@@ -1123,11 +1144,13 @@ bool TWPartition::Wipe(string New_File_System) {
 	bool wiped = false, update_crypt = false, recreate_media = true;
 	int check;
 	string Layout_Filename = Mount_Point + "/.layout_version";
+	TWTRACE_SCOPE("TWPartition::Wipe");
 
 	if (!Can_Be_Wiped) {
 		LOGERR("Partition '%s' cannot be wiped.\n", Mount_Point.c_str());
 		return false;
 	}
+	Forget_FS_Types(Actual_Block_Device);
 
 	if (Mount_Point == "/cache")
 		Log_Offset = 0;
@@ -1338,6 +1361,7 @@ bool TWPartition::Repair() {
 }
 
 bool TWPartition::Backup(string backup_folder) {
+	TWTRACE_SCOPE("TWPartition::Backup");
 	if (Backup_Method == FILES)
 		return Backup_Tar(backup_folder);
 	else if (Backup_Method == DD)
@@ -1353,6 +1377,7 @@ bool TWPartition::Check_MD5(string restore_folder) {
 	char split_filename[512];
 	int index = 0;
 	twrpDigest md5sum;
+	TWTRACE_SCOPE("TWPartition::Check_MD5");
 
 	memset(split_filename, 0, sizeof(split_filename));
 	Full_Filename = restore_folder + "/" + Backup_FileName;
@@ -1399,9 +1424,11 @@ bool TWPartition::Check_MD5(string restore_folder) {
 bool TWPartition::Restore(string restore_folder) {
 	size_t first_period, second_period;
 	string Restore_File_System;
+	TWTRACE_SCOPE("TWPartition::Restore");
 
 	TWFunc::GUI_Operation_Text(TW_RESTORE_TEXT, Display_Name, "Restoring");
 	LOGINFO("Restore filename is: %s\n", Backup_FileName.c_str());
+	Forget_FS_Types(Actual_Block_Device);
 
 	// Parse backup filename to extract the file system before wiping
 	first_period = Backup_FileName.find(".");
@@ -1478,6 +1505,43 @@ bool TWPartition::Wipe_Encryption() {
 	return false;
 }
 
+// blkid results by block device.  A probe reads and tries dozens of
+// superblock formats, and Check_FS_Type runs on every Mount(), so the
+// result is kept until recovery rewrites the device (wipe, restore, zip
+// install) or the device changes size.  A mount that fails with a cached
+// type is retried after a fresh probe.
+struct FS_Type_Cache_Entry {
+	unsigned long long Size;
+	string Type;
+};
+static std::map<string, FS_Type_Cache_Entry> FS_Type_Cache;
+static pthread_mutex_t FS_Type_Cache_Lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Superblock types Check_FS_Type looks for
+static const char* Mountable_FS_Types[] = {
+	"ext4", "ext3", "ext2", "f2fs", "vfat", "exfat", "ntfs", NULL
+};
+
+static unsigned long long Block_Device_Size(const string& Block_Device) {
+	unsigned long long size = 0;
+	int fd = open(Block_Device.c_str(), O_RDONLY);
+	if (fd < 0)
+		return 0;
+	if (ioctl(fd, BLKGETSIZE64, &size) != 0)
+		size = 0;
+	close(fd);
+	return size;
+}
+
+void TWPartition::Forget_FS_Types(string Block_Device) {
+	pthread_mutex_lock(&FS_Type_Cache_Lock);
+	if (Block_Device.empty())
+		FS_Type_Cache.clear();
+	else
+		FS_Type_Cache.erase(Block_Device);
+	pthread_mutex_unlock(&FS_Type_Cache_Lock);
+}
+
 void TWPartition::Check_FS_Type() {
 	const char* type;
 	blkid_probe pr;
@@ -1489,7 +1553,29 @@ void TWPartition::Check_FS_Type() {
 	if (!Is_Present)
 		return;
 
+	unsigned long long Device_Size = Block_Device_Size(Actual_Block_Device);
+	pthread_mutex_lock(&FS_Type_Cache_Lock);
+	std::map<string, FS_Type_Cache_Entry>::iterator cached = FS_Type_Cache.find(Actual_Block_Device);
+	if (cached != FS_Type_Cache.end() && cached->second.Size == Device_Size) {
+		Current_File_System = cached->second.Type;
+		FS_Type_From_Cache = true;
+		pthread_mutex_unlock(&FS_Type_Cache_Lock);
+		return;
+	}
+	pthread_mutex_unlock(&FS_Type_Cache_Lock);
+	FS_Type_From_Cache = false;
+
 	pr = blkid_new_probe_from_filename(Actual_Block_Device.c_str());
+	if (pr == NULL) {
+		LOGINFO("Can't open device %s for probing\n", Actual_Block_Device.c_str());
+		return;
+	}
+	// Only run the probers for file systems we can mount (see
+	// Is_File_System) and only decode the type; a full probe also tries
+	// every RAID, LVM and exotic file system signature.
+	blkid_probe_enable_partitions(pr, 0);
+	blkid_probe_set_superblocks_flags(pr, BLKID_SUBLKS_TYPE);
+	blkid_probe_filter_superblocks_type(pr, BLKID_FLTR_ONLYIN, (char**)Mountable_FS_Types);
 	if (blkid_do_fullprobe(pr)) {
 		blkid_free_probe(pr);
 		LOGINFO("Can't probe device %s\n", Actual_Block_Device.c_str());
@@ -1504,6 +1590,12 @@ void TWPartition::Check_FS_Type() {
 
 	Current_File_System = type;
 	blkid_free_probe(pr);
+
+	pthread_mutex_lock(&FS_Type_Cache_Lock);
+	FS_Type_Cache_Entry& entry = FS_Type_Cache[Actual_Block_Device];
+	entry.Size = Device_Size;
+	entry.Type = Current_File_System;
+	pthread_mutex_unlock(&FS_Type_Cache_Lock);
 }
 
 bool TWPartition::Wipe_EXT23(string File_System) {
@@ -1961,7 +2053,124 @@ bool TWPartition::Restore_Flash_Image(string restore_folder) {
 	return true;
 }
 
+// Guards starting, joining and applying the background /data size, which
+// the action thread and the GUI's partition list can both do
+static pthread_mutex_t Backup_Size_Lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Only stores the result; the partition's sizes are read by other threads
+// and are updated by whoever joins the thread
+void* TWPartition::Backup_Size_Thread(void* cookie) {
+	TWPartition* Part = (TWPartition*)cookie;
+	uint64_t size = du.Get_Folder_Size("/data", &Part->Size_Thread_Cancel);
+
+	if (Part->Size_Thread_Cancel)
+		return NULL;
+	LOGINFO("Data backup size is %iMB.\n", (int)(size / 1048576LLU));
+	// Update_System_Details shows /data and /datadata together
+	DataManager::SetValue(TW_BACKUP_DATA_SIZE, (int)((size + Part->Size_Thread_Extra) / 1048576LLU));
+	// Last, so that a join after seeing it never waits
+	Part->Size_Thread_Result = size;
+	__sync_synchronize();
+	Part->Size_Thread_Done = true;
+	return NULL;
+}
+
+// Takes the size found by Backup_Size_Thread, with Backup_Size_Lock held
+void TWPartition::Apply_Backup_Size() {
+	if (!Size_Thread_Done)
+		return;
+	Used = Backup_Size = Size_Thread_Result;
+	Backup_Size_Estimated = false;
+	Size_Thread_Done = false;
+}
+
+// Runs Backup_Size_Thread in the calling thread, without holding the lock
+void TWPartition::Run_Backup_Size() {
+	TWPartition* datadata = PartitionManager.Find_Partition_By_Path("/datadata");
+
+	Size_Thread_Cancel = false;
+	Size_Thread_Done = false;
+	Size_Thread_Extra = (datadata != NULL) ? datadata->Backup_Size : 0;
+	Backup_Size_Thread(this);
+	pthread_mutex_lock(&Backup_Size_Lock);
+	Apply_Backup_Size();
+	pthread_mutex_unlock(&Backup_Size_Lock);
+}
+
+void TWPartition::Start_Backup_Size() {
+	TWPartition* datadata = PartitionManager.Find_Partition_By_Path("/datadata");
+	bool started;
+
+	Cancel_Backup_Size();
+	if (!Backup_Size_Estimated)
+		return;
+	pthread_mutex_lock(&Backup_Size_Lock);
+	Size_Thread_Cancel = false;
+	Size_Thread_Done = false;
+	Size_Thread_Extra = (datadata != NULL) ? datadata->Backup_Size : 0;
+	started = (pthread_create(&Size_Thread, NULL, Backup_Size_Thread, this) == 0);
+	Size_Thread_Running = started;
+	pthread_mutex_unlock(&Backup_Size_Lock);
+	if (!started)
+		Run_Backup_Size();
+}
+
+// Joining happens outside the lock, so the GUI's Collect_Backup_Size never
+// waits on a running du; the thread is claimed first so only one caller
+// joins it
+void TWPartition::Cancel_Backup_Size() {
+	bool running;
+
+	pthread_mutex_lock(&Backup_Size_Lock);
+	running = Size_Thread_Running;
+	Size_Thread_Running = false;
+	if (running)
+		Size_Thread_Cancel = true;
+	pthread_mutex_unlock(&Backup_Size_Lock);
+	if (running)
+		pthread_join(Size_Thread, NULL);
+	pthread_mutex_lock(&Backup_Size_Lock);
+	Size_Thread_Done = false;
+	pthread_mutex_unlock(&Backup_Size_Lock);
+}
+
+bool TWPartition::Collect_Backup_Size() {
+	bool collected = false;
+
+	// The GUI calls this while drawing, so never wait for the lock
+	if (pthread_mutex_trylock(&Backup_Size_Lock) != 0)
+		return false;
+	if (Size_Thread_Running && Size_Thread_Done) {
+		// The thread has stored its result and is about to return
+		pthread_join(Size_Thread, NULL);
+		Size_Thread_Running = false;
+		Apply_Backup_Size();
+		collected = true;
+	}
+	pthread_mutex_unlock(&Backup_Size_Lock);
+	return collected;
+}
+
+void TWPartition::Wait_For_Backup_Size() {
+	bool running, estimated;
+
+	pthread_mutex_lock(&Backup_Size_Lock);
+	running = Size_Thread_Running;
+	Size_Thread_Running = false;
+	estimated = Backup_Size_Estimated;
+	pthread_mutex_unlock(&Backup_Size_Lock);
+	if (running) {
+		pthread_join(Size_Thread, NULL);
+		pthread_mutex_lock(&Backup_Size_Lock);
+		Apply_Backup_Size();
+		pthread_mutex_unlock(&Backup_Size_Lock);
+	} else if (estimated && Mount(true)) {
+		Run_Backup_Size();
+	}
+}
+
 bool TWPartition::Update_Size(bool Display_Error) {
+	TWTRACE_SCOPE("TWPartition::Update_Size");
 	bool ret = false, Was_Already_Mounted = false;
 #ifdef BUILD_SAFESTRAP
 	string datamedia_mount = EXPAND(TW_SS_DATAMEDIA_MOUNT);
@@ -1988,12 +2197,13 @@ bool TWPartition::Update_Size(bool Display_Error) {
 
 	if (Has_Data_Media) {
 		if (Mount(Display_Error)) {
-			unsigned long long data_media_used, actual_data;
-			Used = du.Get_Folder_Size("/data");
+			// Walking all of /data is slow on large storage; the statfs
+			// figure stands in until Start_Backup_Size replaces it. It
+			// includes /data/media, so it overstates the backup and is
+			// only shown as an estimate.
+			Cancel_Backup_Size();
 			Backup_Size = Used;
-			int bak = (int)(Used / 1048576LLU);
-			int fre = (int)(Free / 1048576LLU);
-			LOGINFO("Data backup size is %iMB, free: %iMB.\n", bak, fre);
+			Backup_Size_Estimated = true;
 		} else {
 			if (!Was_Already_Mounted)
 				UnMount(false);
@@ -37,6 +37,8 @@
 #include "fixPermissions.hpp"
 #include "twrpDigest.hpp"
 #include "twrpDU.hpp"
+#include "twtrace.h"
+#include "twrpProgress.hpp"
 
 extern "C" {
 	#include "cutils/properties.h"
@@ -51,6 +53,7 @@ extern "C" {
 #endif
 
 TWPartitionManager::TWPartitionManager(void) {
+	Restore_Journal_Fresh = false;
 }
 
 #ifdef BUILD_SAFESTRAP
@@ -569,6 +572,7 @@ bool TWPartitionManager::Make_MD5(bool generate_md5, string Backup_Folder, strin
 	if (!generate_md5)
 		return true;
 
+	twrpProgress::Begin_Stage(twrpProgress::MD5, twrpProgress::Archive_Size(Full_File));
 	TWFunc::GUI_Operation_Text(TW_GENERATE_MD5_TEXT, "Generating MD5");
 	gui_print(" * Generating md5...\n");
 
@@ -614,52 +618,65 @@ bool TWPartitionManager::Make_MD5(bool generate_md5, string Backup_Folder, strin
 	return true;
 }
 
-bool TWPartitionManager::Backup_Partition(TWPartition* Part, string Backup_Folder, bool generate_md5, unsigned long long* img_bytes_remaining, unsigned long long* file_bytes_remaining, unsigned long *img_time, unsigned long *file_time, unsigned long long *img_bytes, unsigned long long *file_bytes) {
-	time_t start, stop;
-	int img_bps;
-	unsigned long long file_bps;
-	unsigned long total_time, remain_time, section_time;
-	int use_compression, backup_time;
-	float pos;
+twrpProgress::Stage_Type TWPartitionManager::Backup_Stage_Type(TWPartition* Part) {
+	if (Part->Backup_Method != 1)
+		return twrpProgress::BACKUP_IMAGE;
+	if (DataManager::GetIntValue(TW_USE_COMPRESSION_VAR))
+		return twrpProgress::BACKUP_FILES_COMPRESSED;
+	return twrpProgress::BACKUP_FILES;
+}
 
-	if (Part == NULL)
-		return true;
+twrpProgress::Stage_Type TWPartitionManager::Restore_Stage_Type(TWPartition* Part, string Restore_Name) {
+	string Full_FileName = Restore_Name + "/" + Part->Backup_FileName;
 
-	DataManager::GetValue(TW_BACKUP_AVG_IMG_RATE, img_bps);
+	if (Part->Backup_Method != 1)
+		return twrpProgress::RESTORE_IMAGE;
+	if (!TWFunc::Path_Exists(Full_FileName))
+		Full_FileName += "000";
+	if (TWFunc::Get_File_Type(Full_FileName) == 1)
+		return twrpProgress::RESTORE_FILES_COMPRESSED;
+	return twrpProgress::RESTORE_FILES;
+}
 
-	DataManager::GetValue(TW_USE_COMPRESSION_VAR, use_compression);
-	if (use_compression)
-		DataManager::GetValue(TW_BACKUP_AVG_FILE_COMP_RATE, file_bps);
-	else
-		DataManager::GetValue(TW_BACKUP_AVG_FILE_RATE, file_bps);
+void TWPartitionManager::Plan_Backup_Progress(TWPartition* Part, bool generate_md5) {
+	twrpProgress::Stage_Type Type = Backup_Stage_Type(Part);
+	unsigned long long Archive_Bytes = Part->Backup_Size;
 
-	// We know the speed for both, how far into the whole backup are we, based on time
-	total_time = (*img_bytes / (unsigned long)img_bps) + (*file_bytes / (unsigned long)file_bps);
-	remain_time = (*img_bytes_remaining / (unsigned long)img_bps) + (*file_bytes_remaining / (unsigned long)file_bps);
+	twrpProgress::Plan(Type, Part->Backup_Size);
+	if (generate_md5) {
+		if (Type == twrpProgress::BACKUP_FILES_COMPRESSED)
+			Archive_Bytes = Archive_Bytes * DataManager::GetIntValue(TW_BACKUP_AVG_COMP_RATIO) / 100;
+		twrpProgress::Plan(twrpProgress::MD5, Archive_Bytes);
+	}
+}
 
-	pos = (total_time - remain_time) / (float) total_time;
-	DataManager::SetProgress(pos);
+void TWPartitionManager::Plan_Restore_Progress(TWPartition* Part, string Restore_Name, bool check_md5) {
+	string Full_FileName = Restore_Name + "/" + Part->Backup_FileName;
 
-	LOGINFO("Estimated total time: %lu\nEstimated remaining time: %lu\n", total_time, remain_time);
+	if (check_md5)
+		twrpProgress::Plan(twrpProgress::MD5, twrpProgress::Archive_Size(Full_FileName));
+	twrpProgress::Plan(Restore_Stage_Type(Part, Restore_Name), twrpProgress::Restore_Data_Size(Full_FileName));
+}
 
-	// And get the time
-	if (Part->Backup_Method == 1)
-		section_time = Part->Backup_Size / file_bps;
-	else
-		section_time = Part->Backup_Size / img_bps;
+bool TWPartitionManager::Backup_Partition(TWPartition* Part, string Backup_Folder, bool generate_md5, unsigned long long* img_bytes_remaining, unsigned long long* file_bytes_remaining, unsigned long *img_time, unsigned long *file_time, unsigned long long *img_bytes, unsigned long long *file_bytes) {
+	time_t start, stop;
+	int backup_time;
 
-	// Set the position
-	pos = section_time / (float) total_time;
-	DataManager::ShowProgress(pos, section_time);
+	if (Part == NULL)
+		return true;
 
 	time(&start);
 
+	twrpProgress::Begin_Stage(Backup_Stage_Type(Part), Part->Backup_Size);
 	if (Part->Backup(Backup_Folder)) {
+		if (Backup_Stage_Type(Part) == twrpProgress::BACKUP_FILES_COMPRESSED)
+			twrpProgress::Record_Compression(twrpProgress::Archive_Size(Backup_Folder + Part->Backup_FileName), Part->Backup_Size);
 		if (Part->Has_SubPartition) {
 			std::vector<TWPartition*>::iterator subpart;
 
 			for (subpart = Partitions.begin(); subpart != Partitions.end(); subpart++) {
 				if ((*subpart)->Can_Be_Backed_Up && (*subpart)->Is_SubPartition && (*subpart)->SubPartition_Of == Part->Mount_Point) {
+					twrpProgress::Begin_Stage(Backup_Stage_Type(*subpart), (*subpart)->Backup_Size);
 					if (!(*subpart)->Backup(Backup_Folder))
 						return false;
 					sync();
@@ -704,12 +721,15 @@ int TWPartitionManager::Run_Backup(void) {
 #ifdef BUILD_SAFESTRAP
 	string bootslot;
 #endif
+	TWTRACE_OPERATION("backup");
 	seconds = time(0);
 	t = localtime(&seconds);
 
 	time(&total_start);
 
 	Update_System_Details();
+	for (subpart = Partitions.begin(); subpart != Partitions.end(); subpart++)
+		(*subpart)->Wait_For_Backup_Size();
 #ifdef BUILD_SAFESTRAP
 	DataManager::GetValue("tw_bootslot", bootslot);
 #endif
@@ -740,6 +760,7 @@ int TWPartitionManager::Run_Backup(void) {
 	LOGINFO("Full_Backup_Path is: '%s'\n", Full_Backup_Path.c_str());
 
 	LOGINFO("Calculating backup details...\n");
+	twrpProgressOperation Progress;
 	DataManager::GetValue("tw_backup_list", Backup_List);
 	if (!Backup_List.empty()) {
 		end_pos = Backup_List.find(";", start_pos);
@@ -748,6 +769,7 @@ int TWPartitionManager::Run_Backup(void) {
 			backup_part = Find_Partition_By_Path(backup_path);
 			if (backup_part != NULL) {
 				partition_count++;
+				Plan_Backup_Progress(backup_part, do_md5);
 				if (backup_part->Backup_Method == 1)
 					file_bytes += backup_part->Backup_Size;
 				else
@@ -758,6 +780,7 @@ int TWPartitionManager::Run_Backup(void) {
 					for (subpart = Partitions.begin(); subpart != Partitions.end(); subpart++) {
 						if ((*subpart)->Can_Be_Backed_Up && (*subpart)->Is_Present && (*subpart)->Is_SubPartition && (*subpart)->SubPartition_Of == backup_part->Mount_Point) {
 							partition_count++;
+							Plan_Backup_Progress(*subpart, do_md5);
 							if ((*subpart)->Backup_Method == 1)
 								file_bytes += (*subpart)->Backup_Size;
 							else
@@ -808,8 +831,6 @@ int TWPartitionManager::Run_Backup(void) {
 		return false;
 	}
 
-	DataManager::SetProgress(0.0);
-
 	start_pos = 0;
 	end_pos = Backup_List.find(";", start_pos);
 	while (end_pos != string::npos && start_pos < Backup_List.size()) {
@@ -824,6 +845,7 @@ int TWPartitionManager::Run_Backup(void) {
 		start_pos = end_pos + 1;
 		end_pos = Backup_List.find(";", start_pos);
 	}
+	twrpProgress::Stop(true);
 
 	// Average BPS
 	if (img_time == 0)
@@ -841,26 +863,6 @@ int TWPartitionManager::Run_Backup(void) {
 	uint64_t actual_backup_size = du.Get_Folder_Size(Full_Backup_Path);
 	actual_backup_size /= (1024LLU * 1024LLU);
 
-	int prev_img_bps, use_compression;
-	unsigned long long prev_file_bps;
-	DataManager::GetValue(TW_BACKUP_AVG_IMG_RATE, prev_img_bps);
-	img_bps += (prev_img_bps * 4);
-	img_bps /= 5;
-
-	DataManager::GetValue(TW_USE_COMPRESSION_VAR, use_compression);
-	if (use_compression)
-		DataManager::GetValue(TW_BACKUP_AVG_FILE_COMP_RATE, prev_file_bps);
-	else
-		DataManager::GetValue(TW_BACKUP_AVG_FILE_RATE, prev_file_bps);
-	file_bps += (prev_file_bps * 4);
-	file_bps /= 5;
-
-	DataManager::SetValue(TW_BACKUP_AVG_IMG_RATE, img_bps);
-	if (use_compression)
-		DataManager::SetValue(TW_BACKUP_AVG_FILE_COMP_RATE, file_bps);
-	else
-		DataManager::SetValue(TW_BACKUP_AVG_FILE_RATE, file_bps);
-
 	gui_print("[%llu MB TOTAL BACKED UP]\n", actual_backup_size);
 	Update_System_Details();
 	UnMount_Main_Partitions();
@@ -870,10 +872,296 @@ int TWPartitionManager::Run_Backup(void) {
 	return true;
 }
 
+// An interrupted restore leaves this journal in the backup folder so that
+// retrying the same restore can skip MD5 checks and partitions that were
+// already done.  It is removed when a restore completes.
+#define RESTORE_JOURNAL_FILE ".restore_journal"
+// After a reboot, restored partitions are only skipped if the journal was
+// written this recently (seconds) and their contents still match.
+#define RESTORE_JOURNAL_MAX_AGE 3600
+// Windows of the target device that are hashed into its fingerprint when
+// it holds neither ext4 nor f2fs (raw images, FAT): the start holds the
+// boot sector and FAT head, the others cover the rest of small images.
+#define RESTORE_FINGERPRINT_WINDOW 65536
+static const off64_t Restore_Fingerprint_Offsets[] = { 0, 2 * 1024 * 1024, 4 * 1024 * 1024 };
+// Both file systems keep their superblock 1KiB into the device
+#define SUPERBLOCK_OFFSET 1024
+#define EXT4_SB_MAGIC 0x38
+#define EXT4_SB_FREE_BLOCKS_LO 0x0C
+#define EXT4_SB_FREE_INODES 0x10
+#define EXT4_SB_UUID 0x68
+#define EXT4_SB_FREE_BLOCKS_HI 0x158
+#define F2FS_SB_MAGIC_VALUE 0xF2F52010
+#define F2FS_SB_LOG_BLOCKSIZE 16
+#define F2FS_SB_LOG_BLOCKS_PER_SEG 20
+#define F2FS_SB_CP_BLKADDR 76
+#define F2FS_SB_UUID 108
+#define F2FS_CP_VERSION 0
+#define F2FS_CP_VALID_BLOCKS 16
+#define F2FS_CP_VALID_NODES 144
+#define F2FS_CP_VALID_INODES 148
+
+// Sectors written to a block device since boot, from its sysfs stat file
+static string Block_Device_Writes(string Block_Device) {
+	char resolved[PATH_MAX];
+	unsigned long long stat[7];
+	string stat_file;
+
+	if (realpath(Block_Device.c_str(), resolved) == NULL)
+		return "unknown";
+	stat_file = "/sys/class/block/" + TWFunc::Get_Filename(resolved) + "/stat";
+	FILE* fp = fopen(stat_file.c_str(), "r");
+	if (fp == NULL)
+		return "unknown";
+	int fields = fscanf(fp, "%llu %llu %llu %llu %llu %llu %llu", &stat[0], &stat[1], &stat[2], &stat[3], &stat[4], &stat[5], &stat[6]);
+	fclose(fp);
+	if (fields != 7)
+		return "unknown";
+	char writes[32];
+	sprintf(writes, "%llu", stat[6]);
+	return writes;
+}
+
+static void Fingerprint_Hash(unsigned long long& hash, const unsigned char* data, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+}
+
+// Hashes what a mount leaves alone but any change of the files does not:
+// the ext4 UUID and free block and inode counts, or the f2fs UUID and the
+// valid block, node and inode counts of its newest checkpoint.  Mount
+// counts and times, the superblock checksum and the checkpoint version
+// are left out, so the mount done when recovery starts doesn't count.
+static bool Hash_File_System(int fd, const unsigned char* start, unsigned long long& hash) {
+	const unsigned char* sb = start + SUPERBLOCK_OFFSET;
+	unsigned int magic;
+	unsigned short ext4_magic;
+
+	memcpy(&ext4_magic, sb + EXT4_SB_MAGIC, sizeof(ext4_magic));
+	if (ext4_magic == 0xEF53) {
+		Fingerprint_Hash(hash, sb + EXT4_SB_UUID, 16);
+		Fingerprint_Hash(hash, sb + EXT4_SB_FREE_BLOCKS_LO, 4);
+		Fingerprint_Hash(hash, sb + EXT4_SB_FREE_BLOCKS_HI, 4);
+		Fingerprint_Hash(hash, sb + EXT4_SB_FREE_INODES, 4);
+		return true;
+	}
+	memcpy(&magic, sb, sizeof(magic));
+	if (magic == F2FS_SB_MAGIC_VALUE) {
+		unsigned int log_blocksize, log_blocks_per_seg, cp_blkaddr;
+		unsigned long long version[2] = { 0, 0 };
+		unsigned char cp[2][F2FS_CP_VALID_INODES + 4];
+
+		memcpy(&log_blocksize, sb + F2FS_SB_LOG_BLOCKSIZE, 4);
+		memcpy(&log_blocks_per_seg, sb + F2FS_SB_LOG_BLOCKS_PER_SEG, 4);
+		memcpy(&cp_blkaddr, sb + F2FS_SB_CP_BLKADDR, 4);
+		if (log_blocksize > 16 || log_blocks_per_seg > 16)
+			return false;
+		// The two checkpoint packs are a segment apart
+		for (int i = 0; i < 2; i++) {
+			off64_t offset = ((off64_t)cp_blkaddr + ((off64_t)i << log_blocks_per_seg)) << log_blocksize;
+
+			if (pread64(fd, cp[i], sizeof(cp[i]), offset) != (ssize_t)sizeof(cp[i]))
+				return false;
+			memcpy(&version[i], cp[i] + F2FS_CP_VERSION, 8);
+		}
+		int newest = (version[1] > version[0]) ? 1 : 0;
+		Fingerprint_Hash(hash, sb + F2FS_SB_UUID, 16);
+		Fingerprint_Hash(hash, cp[newest] + F2FS_CP_VALID_BLOCKS, 8);
+		Fingerprint_Hash(hash, cp[newest] + F2FS_CP_VALID_NODES, 4);
+		Fingerprint_Hash(hash, cp[newest] + F2FS_CP_VALID_INODES, 4);
+		return true;
+	}
+	return false;
+}
+
+// FNV-1a hash of the file system usage of a block device, or of its
+// fingerprint windows if it holds no ext4 or f2fs
+static string Block_Device_Hash(string Block_Device) {
+	unsigned long long hash = 14695981039346656037ULL;
+	unsigned char* buffer = (unsigned char*)malloc(RESTORE_FINGERPRINT_WINDOW);
+	int fd = open(Block_Device.c_str(), O_RDONLY);
+	char text[32];
+
+	if (fd < 0 || buffer == NULL) {
+		if (fd >= 0)
+			close(fd);
+		free(buffer);
+		return "unknown";
+	}
+	if (pread64(fd, buffer, RESTORE_FINGERPRINT_WINDOW, 0) != RESTORE_FINGERPRINT_WINDOW || !Hash_File_System(fd, buffer, hash)) {
+		hash = 14695981039346656037ULL;
+		for (unsigned i = 0; i < sizeof(Restore_Fingerprint_Offsets) / sizeof(Restore_Fingerprint_Offsets[0]); i++) {
+			ssize_t len = pread64(fd, buffer, RESTORE_FINGERPRINT_WINDOW, Restore_Fingerprint_Offsets[i]);
+			if (len > 0)
+				Fingerprint_Hash(hash, buffer, len);
+		}
+	}
+	close(fd);
+	free(buffer);
+	sprintf(text, "%016llx", hash);
+	return text;
+}
+
+string TWPartitionManager::Restore_Signature(TWPartition* Part, string Restore_Name) {
+	string Full_Filename = Restore_Name + "/" + Part->Backup_FileName;
+	char split_filename[512], sig[64];
+	struct stat st;
+	string Signature = Part->Mount_Point;
+
+	if (stat(Full_Filename.c_str(), &st) == 0) {
+		sprintf(sig, " %llu:%lu", (unsigned long long)st.st_size, (unsigned long)st.st_mtime);
+		return Signature + sig;
+	}
+	for (int index = 0; index < 1000; index++) {
+		sprintf(split_filename, "%s%03i", Full_Filename.c_str(), index);
+		if (stat(split_filename, &st) != 0)
+			break;
+		sprintf(sig, " %llu:%lu", (unsigned long long)st.st_size, (unsigned long)st.st_mtime);
+		Signature += sig;
+	}
+	return Signature;
+}
+
+static string Fingerprint_Boot(string Fingerprint) {
+	return Fingerprint.substr(0, Fingerprint.find(' '));
+}
+
+// The fingerprint without the boot id and sector counters
+static string Fingerprint_Contents(string Fingerprint) {
+	string Contents;
+	size_t start = Fingerprint.find(' ');
+
+	while (start != string::npos) {
+		size_t end = Fingerprint.find(' ', start + 1);
+		string device = Fingerprint.substr(start + 1, end == string::npos ? string::npos : end - start - 1);
+		size_t writes = device.find(':'), hash = device.rfind(':');
+
+		if (writes != string::npos && hash != string::npos)
+			device.erase(writes, hash - writes);
+		Contents += " " + device;
+		start = end;
+	}
+	return Contents;
+}
+
+// "<boot id> <device>:<sectors written>:<hash> ..." for the partition and
+// its subpartitions.  Taken after a sync so that the restore's own writes
+// are already counted.
+string TWPartitionManager::Restore_Target_Fingerprint(TWPartition* Part) {
+	string Fingerprint, boot_id;
+	std::vector<TWPartition*>::iterator subpart;
+
+	sync();
+	if (TWFunc::read_file("/proc/sys/kernel/random/boot_id", boot_id) != 0 || boot_id.empty())
+		boot_id = "unknown";
+	Fingerprint = boot_id + " " + Part->Actual_Block_Device + ":" + Block_Device_Writes(Part->Actual_Block_Device) + ":" + Block_Device_Hash(Part->Actual_Block_Device);
+	if (Part->Has_SubPartition) {
+		for (subpart = Partitions.begin(); subpart != Partitions.end(); subpart++) {
+			if ((*subpart)->Is_SubPartition && (*subpart)->SubPartition_Of == Part->Mount_Point)
+				Fingerprint += " " + (*subpart)->Actual_Block_Device + ":" + Block_Device_Writes((*subpart)->Actual_Block_Device) + ":" + Block_Device_Hash((*subpart)->Actual_Block_Device);
+		}
+	}
+	return Fingerprint;
+}
+
+// A partition is only skipped if nothing has touched its block devices
+// since it was restored.  Within the same boot no sector may have been
+// written (wipe, format, zip install, ...); across a reboot the journal
+// must be fresh and the file system usage unchanged, which catches the OS,
+// a wipe or an install having changed files.
+bool TWPartitionManager::Restore_Target_Unchanged(TWPartition* Part, string Restored) {
+	string Prefix = Restored + " target ";
+	string Current = Restore_Target_Fingerprint(Part);
+	std::set<string>::iterator entry;
+
+	// Something could not be read, don't trust it
+	if (Current.find("unknown") != string::npos)
+		return false;
+	for (entry = Restore_Journal.lower_bound(Prefix); entry != Restore_Journal.end() && entry->compare(0, Prefix.size(), Prefix) == 0; entry++) {
+		string Recorded = entry->substr(Prefix.size());
+
+		if (Recorded.find("unknown") != string::npos)
+			continue;
+		if (Recorded == Current)
+			return true;
+		// Sector counters restart at boot, so only the hashes can be compared
+		if (Restore_Journal_Fresh && Fingerprint_Boot(Recorded) != Fingerprint_Boot(Current) && Fingerprint_Contents(Recorded) == Fingerprint_Contents(Current))
+			return true;
+	}
+	return false;
+}
+
+void TWPartitionManager::Load_Restore_Journal(string Restore_Name) {
+	string Journal = Restore_Name + "/" RESTORE_JOURNAL_FILE;
+	struct stat st;
+
+	Restore_Journal.clear();
+	Restore_Journal_Fresh = false;
+	if (stat(Journal.c_str(), &st) != 0)
+		return;
+
+	time_t now = time(NULL);
+	Restore_Journal_Fresh = (st.st_mtime <= now && now - st.st_mtime < RESTORE_JOURNAL_MAX_AGE);
+
+	FILE* fp = fopen(Journal.c_str(), "r");
+	if (fp == NULL)
+		return;
+	char line[1024];
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		size_t len = strlen(line);
+		if (len > 0 && line[len - 1] == '\n')
+			line[len - 1] = '\0';
+		Restore_Journal.insert(line);
+	}
+	fclose(fp);
+	LOGINFO("Loaded %u restore checkpoints from '%s'\n", (unsigned)Restore_Journal.size(), Journal.c_str());
+}
+
+void TWPartitionManager::Add_Restore_Journal(string Restore_Name, string Entry) {
+	string Journal = Restore_Name + "/" RESTORE_JOURNAL_FILE;
+
+	Restore_Journal.insert(Entry);
+	FILE* fp = fopen(Journal.c_str(), "a");
+	if (fp == NULL) {
+		LOGINFO("Unable to write restore journal '%s'\n", Journal.c_str());
+		return;
+	}
+	fprintf(fp, "%s\n", Entry.c_str());
+	// The point of the journal is to survive a power loss
+	fflush(fp);
+	fsync(fileno(fp));
+	fclose(fp);
+}
+
+bool TWPartitionManager::Check_MD5_Journaled(TWPartition* Part, string Restore_Name) {
+	string Verified = "verified " + Restore_Signature(Part, Restore_Name);
+
+	twrpProgress::Begin_Stage(twrpProgress::MD5, twrpProgress::Archive_Size(Restore_Name + "/" + Part->Backup_FileName));
+
+	// The backup files haven't changed since they were recently verified
+	if (Restore_Journal_Fresh && Restore_Journal.count(Verified)) {
+		LOGINFO("MD5 of '%s' already verified\n", Part->Backup_FileName.c_str());
+		return true;
+	}
+	if (!Part->Check_MD5(Restore_Name))
+		return false;
+	Add_Restore_Journal(Restore_Name, Verified);
+	return true;
+}
+
 bool TWPartitionManager::Restore_Partition(TWPartition* Part, string Restore_Name, int partition_count) {
 	time_t Start, Stop;
+	string Restored = "restored " + Restore_Signature(Part, Restore_Name);
+
+	twrpProgress::Begin_Stage(Restore_Stage_Type(Part, Restore_Name), twrpProgress::Restore_Data_Size(Restore_Name + "/" + Part->Backup_FileName));
+	if (Restore_Target_Unchanged(Part, Restored)) {
+		gui_print("[%s already restored, skipping]\n\n", Part->Backup_Display_Name.c_str());
+		twrpProgress::End_Stage();
+		return true;
+	}
 	time(&Start);
-	DataManager::ShowProgress(1.0 / (float)partition_count, 150);
 	if (!Part->Restore(Restore_Name))
 		return false;
 	if (Part->Has_SubPartition) {
@@ -881,11 +1169,13 @@ bool TWPartitionManager::Restore_Partition(TWPartition* Part, string Restore_Nam
 
 		for (subpart = Partitions.begin(); subpart != Partitions.end(); subpart++) {
 			if ((*subpart)->Is_SubPartition && (*subpart)->SubPartition_Of == Part->Mount_Point) {
+				twrpProgress::Begin_Stage(Restore_Stage_Type(*subpart, Restore_Name), twrpProgress::Restore_Data_Size(Restore_Name + "/" + (*subpart)->Backup_FileName));
 				if (!(*subpart)->Restore(Restore_Name))
 					return false;
 			}
 		}
 	}
+	Add_Restore_Journal(Restore_Name, Restored + " target " + Restore_Target_Fingerprint(Part));
 	time(&Stop);
 	gui_print("[%s done (%d seconds)]\n\n", Part->Backup_Display_Name.c_str(), (int)difftime(Stop, Start));
 	return true;
@@ -898,6 +1188,7 @@ int TWPartitionManager::Run_Restore(string Restore_Name) {
 	time(&rStart);
 	string Restore_List, restore_path;
 	size_t start_pos = 0, end_pos;
+	TWTRACE_OPERATION("restore");
 
 	gui_print("\n[RESTORE STARTED]\n\n");
 	gui_print("Restore folder: '%s'\n", Restore_Name.c_str());
@@ -905,7 +1196,31 @@ int TWPartitionManager::Run_Restore(string Restore_Name) {
 	if (!Mount_Current_Storage(true))
 		return false;
 
+	Load_Restore_Journal(Restore_Name);
 	DataManager::GetValue(TW_SKIP_MD5_CHECK_VAR, check_md5);
+	DataManager::GetValue("tw_restore_selected", Restore_List);
+
+	// Plan the whole restore so the estimate covers it from the start
+	twrpProgressOperation Progress;
+	end_pos = Restore_List.find(";", start_pos);
+	while (end_pos != string::npos && start_pos < Restore_List.size()) {
+		restore_part = Find_Partition_By_Path(Restore_List.substr(start_pos, end_pos - start_pos));
+		if (restore_part != NULL) {
+			Plan_Restore_Progress(restore_part, Restore_Name, check_md5 > 0);
+			if (restore_part->Has_SubPartition) {
+				std::vector<TWPartition*>::iterator subpart;
+
+				for (subpart = Partitions.begin(); subpart != Partitions.end(); subpart++) {
+					if ((*subpart)->Is_SubPartition && (*subpart)->SubPartition_Of == restore_part->Mount_Point)
+						Plan_Restore_Progress(*subpart, Restore_Name, check_md5 > 0);
+				}
+			}
+		}
+		start_pos = end_pos + 1;
+		end_pos = Restore_List.find(";", start_pos);
+	}
+	start_pos = 0;
+
 	if (check_md5 > 0) {
 		// Check MD5 files first before restoring to ensure that all of them match before starting a restore
 		TWFunc::GUI_Operation_Text(TW_VERIFY_MD5_TEXT, "Verifying MD5");
@@ -913,7 +1228,6 @@ int TWPartitionManager::Run_Restore(string Restore_Name) {
 	} else {
 		gui_print("Skipping MD5 check based on user setting.\n");
 	}
-	DataManager::GetValue("tw_restore_selected", Restore_List);
 	if (!Restore_List.empty()) {
 		end_pos = Restore_List.find(";", start_pos);
 		while (end_pos != string::npos && start_pos < Restore_List.size()) {
@@ -921,14 +1235,14 @@ int TWPartitionManager::Run_Restore(string Restore_Name) {
 			restore_part = Find_Partition_By_Path(restore_path);
 			if (restore_part != NULL) {
 				partition_count++;
-				if (check_md5 > 0 && !restore_part->Check_MD5(Restore_Name))
+				if (check_md5 > 0 && !Check_MD5_Journaled(restore_part, Restore_Name))
 					return false;
 				if (restore_part->Has_SubPartition) {
 					std::vector<TWPartition*>::iterator subpart;
 
 					for (subpart = Partitions.begin(); subpart != Partitions.end(); subpart++) {
 						if ((*subpart)->Is_SubPartition && (*subpart)->SubPartition_Of == restore_part->Mount_Point) {
-							if (check_md5 > 0 && !(*subpart)->Check_MD5(Restore_Name))
+							if (check_md5 > 0 && !Check_MD5_Journaled(*subpart, Restore_Name))
 								return false;
 						}
 					}
@@ -947,7 +1261,6 @@ int TWPartitionManager::Run_Restore(string Restore_Name) {
 	}
 
 	gui_print("Restoring %i partitions...\n", partition_count);
-	DataManager::SetProgress(0.0);
 	start_pos = 0;
 	if (!Restore_List.empty()) {
 		end_pos = Restore_List.find(";", start_pos);
@@ -965,6 +1278,9 @@ int TWPartitionManager::Run_Restore(string Restore_Name) {
 			end_pos = Restore_List.find(";", start_pos);
 		}
 	}
+	twrpProgress::Stop(true);
+	unlink((Restore_Name + "/" RESTORE_JOURNAL_FILE).c_str());
+	Restore_Journal.clear();
 	TWFunc::GUI_Operation_Text(TW_UPDATE_SYSTEM_DETAILS_TEXT, "Updating System Details");
 	Update_System_Details();
 	UnMount_Main_Partitions();
@@ -1071,6 +1387,7 @@ void TWPartitionManager::Set_Restore_Files(string Restore_Name) {
 }
 
 int TWPartitionManager::Wipe_By_Path(string Path) {
+	TWTRACE_OPERATION("wipe");
 	std::vector<TWPartition*>::iterator iter;
 	int ret = false;
 	bool found = false;
@@ -1134,6 +1451,7 @@ int TWPartitionManager::Wipe_By_Name(string Name) {
 }
 
 int TWPartitionManager::Wipe_By_Path(string Path, string New_File_System) {
+	TWTRACE_OPERATION("wipe");
 	std::vector<TWPartition*>::iterator iter;
 	int ret = false;
 	bool found = false;
@@ -1199,6 +1517,7 @@ int TWPartitionManager::Wipe_By_Name(string Name, string New_File_System) {
 int TWPartitionManager::Factory_Reset(void) {
 	std::vector<TWPartition*>::iterator iter;
 	int ret = true;
+	TWTRACE_OPERATION("wipe");
 
 	for (iter = Partitions.begin(); iter != Partitions.end(); iter++) {
 		if ((*iter)->Wipe_During_Factory_Reset && (*iter)->Is_Present) {
@@ -1421,6 +1740,28 @@ int TWPartitionManager::Repair_By_Name(string Name, bool Display_Error) {
 	return false;
 }
 
+static void* Probe_FS_Type_Thread(void* cookie) {
+	((TWPartition*)cookie)->Check_FS_Type();
+	return NULL;
+}
+
+void TWPartitionManager::Probe_FS_Types(void) {
+	std::vector<TWPartition*>::iterator iter;
+	std::vector<pthread_t> threads;
+
+	// blkid only reads the devices, so all of them can be probed at once;
+	// the mounts that follow then find their types in the cache.
+	for (iter = Partitions.begin(); iter != Partitions.end(); iter++) {
+		if (!(*iter)->Can_Be_Mounted || (*iter)->Is_Mounted())
+			continue;
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, Probe_FS_Type_Thread, *iter) == 0)
+			threads.push_back(thread);
+	}
+	for (size_t i = 0; i < threads.size(); i++)
+		pthread_join(threads[i], NULL);
+}
+
 void TWPartitionManager::Refresh_Sizes(void) {
 	Update_System_Details();
 	return;
@@ -1435,6 +1776,7 @@ void TWPartitionManager::Update_System_Details(void) {
 	DataManager::LoadBootslotVar();
 #endif
 	gui_print("Updating partition details...\n");
+	Probe_FS_Types();
 	for (iter = Partitions.begin(); iter != Partitions.end(); iter++) {
 		if ((*iter)->Can_Be_Mounted) {
 			(*iter)->Update_Size(true);
@@ -1575,6 +1917,11 @@ void TWPartitionManager::Update_System_Details(void) {
 	} else {
 		LOGINFO("Unable to find storage partition '%s'.\n", current_storage_path.c_str());
 	}
+	// Let the GUI come up while /data is measured
+	for (iter = Partitions.begin(); iter != Partitions.end(); iter++) {
+		if ((*iter)->Backup_Size_Estimated && (*iter)->Mount(false))
+			(*iter)->Start_Backup_Size();
+	}
 	if (!Write_Fstab())
 		LOGERR("Error creating fstab\n");
 	return;
@@ -2096,17 +2443,25 @@ void TWPartitionManager::Get_Partition_List(string ListType, std::vector<Partiti
 			if ((*iter)->Can_Be_Backed_Up && !(*iter)->Is_SubPartition && (*iter)->Is_Present) {
 #endif
 				struct PartitionList part;
+				bool Estimated;
+
+				(*iter)->Collect_Backup_Size();
 				Backup_Size = (*iter)->Backup_Size;
+				Estimated = (*iter)->Backup_Size_Estimated;
 				if ((*iter)->Has_SubPartition) {
 					std::vector<TWPartition*>::iterator subpart;
 
 					for (subpart = Partitions.begin(); subpart != Partitions.end(); subpart++) {
-						if ((*subpart)->Is_SubPartition && (*subpart)->Can_Be_Backed_Up && (*subpart)->Is_Present && (*subpart)->SubPartition_Of == (*iter)->Mount_Point)
+						if ((*subpart)->Is_SubPartition && (*subpart)->Can_Be_Backed_Up && (*subpart)->Is_Present && (*subpart)->SubPartition_Of == (*iter)->Mount_Point) {
+							(*subpart)->Collect_Backup_Size();
 							Backup_Size += (*subpart)->Backup_Size;
+							Estimated |= (*subpart)->Backup_Size_Estimated;
+						}
 					}
 				}
 				sprintf(backup_size, "%llu", Backup_Size / 1024 / 1024);
-				part.Display_Name = (*iter)->Backup_Display_Name + " (";
+				// Still the statfs figure, which counts /data/media too
+				part.Display_Name = (*iter)->Backup_Display_Name + (Estimated ? " (~" : " (");
 				part.Display_Name += backup_size;
 				part.Display_Name += "MB)";
 				part.Mount_Point = (*iter)->Backup_Path;
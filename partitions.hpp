@@ -21,7 +21,10 @@
 
 #include <vector>
 #include <string>
+#include <set>
+#include <pthread.h>
 #include "twrpDU.hpp"
+#include "twrpProgress.hpp"
 
 #define MAX_FSTAB_LINE_LENGTH 2048
 
@@ -66,6 +69,9 @@ public:
 	void Check_FS_Type();                                                     // Checks the fs type using blkid, does not do anything on MTD / yaffs2 because this crashes on some devices
 	bool Update_Size(bool Display_Error);                                     // Updates size information
 	void Recreate_Media_Folder();                                             // Recreates the /data/media folder
+	void Wait_For_Backup_Size();                                              // Waits for a background /data size calculation to finish
+	bool Collect_Backup_Size();                                               // Takes the background /data size if it is ready, without waiting
+	static void Forget_FS_Types(string Block_Device = "");                    // Drops cached blkid results for a device, or all devices if empty
 
 public:
 	string Current_File_System;                                               // Current file system
@@ -113,6 +119,11 @@ private:
 	bool Find_MTD_Block_Device(string MTD_Name);                              // Finds the mtd block device based on the name from the fstab
 	void Recreate_AndSec_Folder(void);                                        // Recreates the .android_secure folder
 	void Mount_Storage_Retry(void);                                           // Tries multiple times with a half second delay to mount a device in case storage is slow to mount
+	void Start_Backup_Size();                                                 // Starts calculating the /data backup size in the background
+	void Cancel_Backup_Size();                                                // Stops a background size calculation, leaving the estimate in place
+	static void* Backup_Size_Thread(void* cookie);                           // Thread body for Start_Backup_Size
+	void Run_Backup_Size();                                                   // Sizes /data in the calling thread
+	void Apply_Backup_Size();                                                 // Takes the size Backup_Size_Thread found
 
 private:
 	bool Can_Be_Mounted;                                                      // Indicates that the partition can be mounted
@@ -134,6 +145,14 @@ private:
 	string Alternate_Block_Device;                                            // Alternate block device (e.g. /dev/block/mmcblk1)
 	string Decrypted_Block_Device;                                            // Decrypted block device available after decryption
 	bool Removable;                                                           // Indicates if this partition is removable -- affects how often we check overall size, if present, etc.
+	bool FS_Type_From_Cache;                                                  // Current_File_System came from the blkid cache rather than a fresh probe
+	pthread_t Size_Thread;                                                    // Background du of /data, see Start_Backup_Size
+	bool Size_Thread_Running;                                                 // Size_Thread has been started and not yet joined
+	volatile bool Size_Thread_Cancel;                                         // Asks Size_Thread to stop early
+	volatile bool Size_Thread_Done;                                           // Size_Thread has stored its result
+	uint64_t Size_Thread_Result;                                              // Size of /data found by Size_Thread, applied once it is joined
+	uint64_t Size_Thread_Extra;                                               // Backup size of /datadata, shown together with /data
+	bool Backup_Size_Estimated;                                               // Backup_Size is the statfs figure, not yet the du of /data
 	bool Is_Present;                                                          // Indicates if the partition is currently present as a block device
 	int Length;                                                               // Used by make_ext4fs to leave free space at the end of the partition block for things like a crypto footer
 #ifndef BUILD_SAFESTRAP
@@ -240,6 +259,7 @@ public:
 
 	int Fix_Permissions();
 	void Get_Partition_List(string ListType, std::vector<PartitionList> *Partition_List);
+	void Probe_FS_Types();                                                    // Runs blkid on all partitions in parallel to fill the probe cache
 	int Fstab_Processed();                                                    // Indicates if the fstab has been processed or not
 	void Output_Storage_Fstab();                                              // Creates a /cache/recovery/storage.fstab file with a list of all potential storage locations for app use
 #ifdef BUILD_SAFESTRAP
@@ -253,12 +273,24 @@ private:
 	bool Make_MD5(bool generate_md5, string Backup_Folder, string Backup_Filename); // Generates an MD5 after a backup is made
 	bool Backup_Partition(TWPartition* Part, string Backup_Folder, bool generate_md5, unsigned long long* img_bytes_remaining, unsigned long long* file_bytes_remaining, unsigned long *img_time, unsigned long *file_time, unsigned long long *img_bytes, unsigned long long *file_bytes);
 	bool Restore_Partition(TWPartition* Part, string Restore_Name, int partition_count);
+	twrpProgress::Stage_Type Backup_Stage_Type(TWPartition* Part);          // Progress stage for backing up a partition
+	twrpProgress::Stage_Type Restore_Stage_Type(TWPartition* Part, string Restore_Name); // Progress stage for restoring a partition
+	void Plan_Backup_Progress(TWPartition* Part, bool generate_md5);         // Adds a partition's backup to the progress estimate
+	void Plan_Restore_Progress(TWPartition* Part, string Restore_Name, bool check_md5); // Adds a partition's restore to the progress estimate
+	string Restore_Signature(TWPartition* Part, string Restore_Name);        // Sizes and times of a partition's backup files, ties journal entries to them
+	string Restore_Target_Fingerprint(TWPartition* Part);                    // State of the block devices a partition restores to
+	bool Restore_Target_Unchanged(TWPartition* Part, string Restored);       // Checks the journal's "restored" entries against the target devices
+	void Load_Restore_Journal(string Restore_Name);                          // Reads the checkpoints left by an interrupted restore of this backup
+	void Add_Restore_Journal(string Restore_Name, string Entry);             // Records a completed restore step
+	bool Check_MD5_Journaled(TWPartition* Part, string Restore_Name);        // Checks MD5 unless the journal shows the same files already passed
 	void Output_Partition(TWPartition* Part);
 	TWPartition* Find_Next_Storage(string Path, string Exclude);
 	int Open_Lun_File(string Partition_Path, string Lun_File);
 
 private:
 	std::vector<TWPartition*> Partitions;                                     // Vector list of all partitions
+	std::set<string> Restore_Journal;                                         // Completed steps of an interrupted restore
+	bool Restore_Journal_Fresh;                                               // Journal is recent enough to trust restored partitions
 };
 
 extern TWPartitionManager PartitionManager;
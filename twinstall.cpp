@@ -47,6 +47,8 @@
 #include "partitions.hpp"
 #include "twrpDigest.hpp"
 #include "twrp-functions.hpp"
+#include "twtrace.h"
+#include "twrpProgress.hpp"
 extern "C" {
 	#include "gui/gui.h"
 	#include "legacy_property_service.h"
@@ -104,7 +106,8 @@ static int switch_to_new_properties()
 
 static int Run_Update_Binary(const char *path, ZipArchive *Zip, int* wipe_cache) {
 	string Temp_Binary = "/tmp/updater";
-	int binary_fd, ret_val, pipe_fd[2], status, zip_verify;
+	int binary_fd, ret_val, pipe_fd[2], status;
+	float progress_base = 0, progress_portion = 0;
 	char buffer[1024];
 	const char** args = (const char**)malloc(sizeof(char*) * 5);
 	FILE* child_data;
@@ -241,7 +244,6 @@ static int Run_Update_Binary(const char *path, ZipArchive *Zip, int* wipe_cache)
 
 	*wipe_cache = 0;
 
-	DataManager::GetValue(TW_SIGNED_ZIP_VERIFY_VAR, zip_verify);
 	child_data = fdopen(pipe_fd[0], "r");
 	while (fgets(buffer, sizeof(buffer), child_data) != NULL) {
 		char* command = strtok(buffer, " \n");
@@ -252,16 +254,17 @@ static int Run_Update_Binary(const char *path, ZipArchive *Zip, int* wipe_cache)
 			char* seconds_char = strtok(NULL, " \n");
 
 			float fraction_float = strtof(fraction_char, NULL);
-			int seconds_float = strtol(seconds_char, NULL, 10);
+			int seconds_float = seconds_char ? strtol(seconds_char, NULL, 10) : 0;
 
-			if (zip_verify)
-				DataManager::ShowProgress(fraction_float * (1 - VERIFICATION_PROGRESS_FRACTION), seconds_float);
-			else
-				DataManager::ShowProgress(fraction_float, seconds_float);
+			// The updater moves on to its next portion of the bar, filling
+			// it over the given time unless set_progress says otherwise
+			progress_base += progress_portion;
+			progress_portion = fraction_float;
+			twrpProgress::Animate_Fraction(progress_base, progress_portion, seconds_float);
 		} else if (strcmp(command, "set_progress") == 0) {
 			char* fraction_char = strtok(NULL, " \n");
 			float fraction_float = strtof(fraction_char, NULL);
-			DataManager::SetProgress(fraction_float);
+			twrpProgress::Set_Fraction(progress_base + fraction_float * progress_portion);
 		} else if (strcmp(command, "ui_print") == 0) {
 			char* display_value = strtok(NULL, "\n");
 			if (display_value) {
@@ -305,8 +308,18 @@ extern "C" int TWinstall_zip(const char* path, int* wipe_cache) {
 	twrpDigest md5sum;
 	string strpath = path;
 	ZipArchive Zip;
+	TWTRACE_OPERATION("install");
+	unsigned long long zip_size = TWFunc::Get_File_Size(strpath);
+	bool has_md5 = TWFunc::Path_Exists(strpath + ".md5");
+
+	twrpProgressOperation Progress;
+	if (has_md5)
+		twrpProgress::Plan(twrpProgress::MD5, zip_size);
+	twrpProgress::Plan(twrpProgress::INSTALL, zip_size);
 
 	gui_print("Installing '%s'...\nChecking for MD5 file...\n", path);
+	if (has_md5)
+		twrpProgress::Begin_Stage(twrpProgress::MD5, zip_size);
 	md5sum.setfn(strpath);
 	md5_return = md5sum.verify_md5digest();
 	if (md5_return == -2) { // md5 did not match
@@ -317,7 +330,6 @@ extern "C" int TWinstall_zip(const char* path, int* wipe_cache) {
 #ifndef TW_OEM_BUILD
 	DataManager::GetValue(TW_SIGNED_ZIP_VERIFY_VAR, zip_verify);
 #endif
-	DataManager::SetProgress(0);
 	if (zip_verify) {
 		gui_print("Verifying zip signature...\n");
 		ret_val = verify_file(path);
@@ -331,5 +343,10 @@ extern "C" int TWinstall_zip(const char* path, int* wipe_cache) {
 		LOGERR("Zip file is corrupt!\n", path);
 		return INSTALL_CORRUPT;
 	}
-	return Run_Update_Binary(path, &Zip, wipe_cache);
+	twrpProgress::Begin_Stage(twrpProgress::INSTALL, zip_size);
+	ret_val = Run_Update_Binary(path, &Zip, wipe_cache);
+	twrpProgress::Stop(ret_val == INSTALL_SUCCESS);
+	// The zip may have formatted or flashed partitions
+	TWPartition::Forget_FS_Types();
+	return ret_val;
 }
@@ -42,6 +42,7 @@
 #include "partitions.hpp"
 #include "variables.h"
 #include "bootloader.h"
+#include <zlib.h>
 #ifdef ANDROID_RB_POWEROFF
 	#include "cutils/android_reboot.h"
 #endif
@@ -414,25 +415,98 @@ void TWFunc::GUI_Operation_Text(string Read_Value, string Partition_Name, string
 	DataManager::SetValue("tw_partition", Partition_Name);
 }
 
+// /cache is small, so the persisted log is capped and older contents are
+// kept as a few gzipped generations (log.1.gz is the most recent)
+#define LOG_MAX_SIZE (1024 * 1024)
+#define LOG_ROTATE_COUNT 3
+#define LOG_COPY_CHUNK (64 * 1024)
+
+// Size of last_log when it was last brought in line with log, so later
+// updates in this session only need to append the new tail
+static off_t Last_Log_Synced = -1;
+
+int TWFunc::Append_File(int src_fd, int dst_fd, off_t Offset, off_t End) {
+	char buffer[LOG_COPY_CHUNK];
+
+	while (Offset < End) {
+		ssize_t ret = sendfile(dst_fd, src_fd, &Offset, End - Offset);
+		if (ret > 0)
+			continue;
+		if (ret < 0 && errno != EINVAL && errno != ENOSYS)
+			return -1;
+		// sendfile can't target this file, fall back to large reads
+		if (lseek(src_fd, Offset, SEEK_SET) != Offset)
+			return -1;
+		while (Offset < End) {
+			size_t len = (End - Offset > LOG_COPY_CHUNK) ? LOG_COPY_CHUNK : End - Offset;
+			ret = read(src_fd, buffer, len);
+			if (ret <= 0)
+				return (ret == 0) ? 0 : -1;
+			if (write(dst_fd, buffer, ret) != ret)
+				return -1;
+			Offset += ret;
+		}
+	}
+	return 0;
+}
+
+void TWFunc::Rotate_Log(string Log) {
+	char from[256], to[256], buffer[LOG_COPY_CHUNK];
+	ssize_t len;
+
+	for (int i = LOG_ROTATE_COUNT - 1; i > 0; i--) {
+		snprintf(from, sizeof(from), "%s.%i.gz", Log.c_str(), i);
+		snprintf(to, sizeof(to), "%s.%i.gz", Log.c_str(), i + 1);
+		rename(from, to);
+	}
+	snprintf(to, sizeof(to), "%s.1.gz", Log.c_str());
+	int fd = open(Log.c_str(), O_RDONLY);
+	gzFile gz = gzopen(to, "wb6");
+	if (fd < 0 || gz == NULL) {
+		LOGINFO("Unable to rotate '%s'\n", Log.c_str());
+	} else {
+		while ((len = read(fd, buffer, sizeof(buffer))) > 0)
+			gzwrite(gz, buffer, len);
+	}
+	if (gz != NULL)
+		gzclose(gz);
+	if (fd >= 0)
+		close(fd);
+	chmod(to, 0600);
+	truncate(Log.c_str(), 0);
+}
+
 void TWFunc::Copy_Log(string Source, string Destination) {
+	struct stat src_st, dst_st;
+	off_t start;
+
 	PartitionManager.Mount_By_Path(Destination, false);
-	FILE *destination_log = fopen(Destination.c_str(), "a");
-	if (destination_log == NULL) {
+	int src_fd = open(Source.c_str(), O_RDONLY);
+	if (src_fd < 0 || fstat(src_fd, &src_st) != 0) {
+		if (src_fd >= 0)
+			close(src_fd);
+		return;
+	}
+	// Only the part of the log written since the last copy is appended,
+	// and no more of it than fits under the cap
+	start = Log_Offset;
+	if (start > src_st.st_size)
+		start = 0;
+	if (src_st.st_size - start > LOG_MAX_SIZE)
+		start = src_st.st_size - LOG_MAX_SIZE;
+	if (stat(Destination.c_str(), &dst_st) == 0 && dst_st.st_size + (src_st.st_size - start) > LOG_MAX_SIZE)
+		Rotate_Log(Destination);
+
+	int dst_fd = open(Destination.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0600);
+	if (dst_fd < 0) {
 		LOGERR("TWFunc::Copy_Log -- Can't open destination log file: '%s'\n", Destination.c_str());
 	} else {
-		FILE *source_log = fopen(Source.c_str(), "r");
-		if (source_log != NULL) {
-			fseek(source_log, Log_Offset, SEEK_SET);
-			char buffer[4096];
-			while (fgets(buffer, sizeof(buffer), source_log))
-				fputs(buffer, destination_log); // Buffered write of log file
-			Log_Offset = ftell(source_log);
-			fflush(source_log);
-			fclose(source_log);
-		}
-		fflush(destination_log);
-		fclose(destination_log);
+		if (Append_File(src_fd, dst_fd, start, src_st.st_size) == 0)
+			Log_Offset = src_st.st_size;
+		fsync(dst_fd);
+		close(dst_fd);
 	}
+	close(src_fd);
 }
 
 void TWFunc::Update_Log_File(void) {
@@ -444,7 +518,24 @@ void TWFunc::Update_Log_File(void) {
 				LOGINFO("Unable to create /cache/recovery folder.\n");
 		}
 		Copy_Log(TMP_LOG_FILE, "/cache/recovery/log");
-		copy_file("/cache/recovery/log", "/cache/recovery/last_log", 600);
+
+		// last_log mirrors log; append just the new tail when it is in step
+		struct stat log_st, last_st;
+		int log_fd = open("/cache/recovery/log", O_RDONLY);
+		if (log_fd >= 0 && fstat(log_fd, &log_st) == 0) {
+			bool in_step = (stat("/cache/recovery/last_log", &last_st) == 0 && last_st.st_size == Last_Log_Synced && Last_Log_Synced <= log_st.st_size);
+			int last_fd = open("/cache/recovery/last_log", O_WRONLY | O_CREAT | (in_step ? O_APPEND : O_TRUNC), 0640);
+			if (last_fd >= 0) {
+				if (Append_File(log_fd, last_fd, in_step ? Last_Log_Synced : 0, log_st.st_size) == 0)
+					Last_Log_Synced = log_st.st_size;
+				else
+					Last_Log_Synced = -1;
+				fsync(last_fd);
+				close(last_fd);
+			}
+		}
+		if (log_fd >= 0)
+			close(log_fd);
 		chown("/cache/recovery/log", 1000, 1000);
 		chmod("/cache/recovery/log", 0600);
 		chmod("/cache/recovery/last_log", 0640);
@@ -472,9 +563,13 @@ void TWFunc::Update_Log_File(void) {
 		if (unlink("/cache/recovery/command") && errno != ENOENT) {
 			LOGINFO("Can't unlink %s\n", "/cache/recovery/command");
 		}
+		// The logs were fsynced above, only the directory is left
+		int dir_fd = open("/cache/recovery", O_RDONLY | O_DIRECTORY);
+		if (dir_fd >= 0) {
+			fsync(dir_fd);
+			close(dir_fd);
+		}
 	}
-
-	sync();
 }
 
 void TWFunc::Update_Intent_File(string Intent) {
@@ -575,15 +670,21 @@ int TWFunc::removeDir(const string path, bool skipParent) {
 }
 
 int TWFunc::copy_file(string src, string dst, int mode) {
+	struct stat st;
+	int ret = 0;
+
 	LOGINFO("Copying file %s to %s\n", src.c_str(), dst.c_str());
-	ifstream srcfile(src.c_str(), ios::binary);
-	ofstream dstfile(dst.c_str(), ios::binary);
-	dstfile << srcfile.rdbuf();
-	srcfile.close();
-	dstfile.close();
+	int src_fd = open(src.c_str(), O_RDONLY);
+	int dst_fd = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, mode);
+	if (src_fd < 0 || dst_fd < 0 || fstat(src_fd, &st) != 0 || Append_File(src_fd, dst_fd, 0, st.st_size) != 0)
+		ret = -1;
+	if (src_fd >= 0)
+		close(src_fd);
+	if (dst_fd >= 0)
+		close(dst_fd);
 	if (chmod(dst.c_str(), mode) != 0)
 		return -1;
-	return 0;
+	return ret;
 }
 
 unsigned int TWFunc::Get_D_Type_From_Stat(string Path) {
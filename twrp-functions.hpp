@@ -83,7 +83,9 @@ public:
 	static std::vector<std::string> Split_String(const std::string& str, const std::string& delimiter, bool removeEmpty = true); // Splits string by delimiter
 
 private:
-	static void Copy_Log(string Source, string Destination);
+	static void Copy_Log(string Source, string Destination);                   // Appends the new part of Source to Destination
+	static void Rotate_Log(string Log);                                         // Gzips Log into Log.1.gz, shifting older generations
+	static int Append_File(int src_fd, int dst_fd, off_t Offset, off_t End);    // Copies a range of src_fd to dst_fd using sendfile where possible
 
 };
 
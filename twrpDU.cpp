@@ -65,7 +65,7 @@ vector<string> twrpDU::get_absolute_dirs(void) {
 	return absolutedir;
 }
 
-uint64_t twrpDU::Get_Folder_Size(const string& Path) {
+uint64_t twrpDU::Get_Folder_Size(const string& Path, const volatile bool* Cancel) {
 	DIR* d;
 	struct dirent* de;
 	struct stat st;
@@ -79,8 +79,10 @@ uint64_t twrpDU::Get_Folder_Size(const string& Path) {
 	}
 
 	while ((de = readdir(d)) != NULL) {
+		if (Cancel && *Cancel)
+			break;
 		if (de->d_type == DT_DIR && !check_skip_dirs(Path + "/" + de->d_name)) {
-			dusize += Get_Folder_Size(Path + "/" + de->d_name);
+			dusize += Get_Folder_Size(Path + "/" + de->d_name, Cancel);
 		} else if (de->d_type == DT_REG) {
 			stat((Path + "/" + de->d_name).c_str(), &st);
 			dusize += (uint64_t)(st.st_size);
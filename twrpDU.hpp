@@ -37,7 +37,7 @@ class twrpDU {
 
 public:
 	twrpDU();
-	uint64_t Get_Folder_Size(const string& Path); // Gets the folder's size using stat
+	uint64_t Get_Folder_Size(const string& Path, const volatile bool* Cancel = NULL); // Gets the folder's size using stat, stopping early if *Cancel is set
 	void add_absolute_dir(const string& Path);
 	void add_relative_dir(const string& Path);
 	bool check_relative_skip_dirs(const string& dir);
@@ -40,6 +40,8 @@ extern "C"
 #include "variables.h"
 #include "twrp-functions.hpp"
 #include "twrpDigest.hpp"
+#include "twtrace.h"
+#include "twrpProgress.hpp"
 
 using namespace std;
 
@@ -53,12 +55,14 @@ int twrpDigest::computeMD5(void) {
 	FILE *file;
 	int len;
 	unsigned char buf[1024];
+	TWTRACE_SCOPE("twrpDigest::computeMD5");
 	MD5Init(&md5c);
 	file = fopen(md5fn.c_str(), "rb");
 	if (file == NULL)
 		return -1;
 	while ((len = fread(buf, 1, sizeof(buf), file)) > 0) {
 		MD5Update(&md5c, buf, len);
+		twrpProgress::Add_Bytes(len);
 	}
 	fclose(file);
 	MD5Final(md5sum, &md5c);
@@ -123,6 +127,7 @@ int twrpDigest::verify_md5digest(void) {
 	char hex[3];
 	int i, ret;
 	string md5string;
+	TWTRACE_SCOPE("twrpDigest::verify_md5digest");
 
 	ret = read_md5digest();
 	if (ret != 0)
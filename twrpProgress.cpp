@@ -0,0 +1,341 @@
+/*
+        Copyright 2014 TeamWin
+        This file is part of TWRP/TeamWin Recovery Project.
+
+        TWRP is free software: you can redistribute it and/or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        TWRP is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with TWRP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "twcommon.h"
+#include "twrpProgress.hpp"
+#ifndef BUILD_TWRPTAR_MAIN
+#include "data.hpp"
+#include "variables.h"
+#include "twrp-functions.hpp"
+#endif
+
+// Bytes processed in the current stage.  The page is shared so that the
+// tar children forked during a backup or restore can report to the
+// parent; it is mapped once and never released.
+struct Progress_Shared {
+	unsigned long long Bytes;
+};
+
+static Progress_Shared* Shared = NULL;
+
+void twrpProgress::Add_Bytes(unsigned long long Bytes) {
+	if (Shared != NULL)
+		__sync_fetch_and_add(&Shared->Bytes, Bytes);
+}
+
+#ifndef BUILD_TWRPTAR_MAIN
+
+#define PROGRESS_INTERVAL_US 500000
+// Weight of each half second sample in the running throughput
+#define PROGRESS_ALPHA 0.2
+// Stages shorter than this say little about the real throughput
+#define PROGRESS_MIN_STAGE_TIME 1.0
+
+struct Stage_Rate {
+	const char* Var;
+	double Rate;     // bytes per second, drives the estimate
+	unsigned long long Stored; // rate saved by earlier operations
+	double Bytes, Seconds;     // finished stages of this operation
+};
+
+static Stage_Rate Rates[twrpProgress::STAGE_TYPE_COUNT] = {
+	{ TW_BACKUP_AVG_IMG_RATE, 0, 0, 0, 0 },
+	{ TW_BACKUP_AVG_FILE_RATE, 0, 0, 0, 0 },
+	{ TW_BACKUP_AVG_FILE_COMP_RATE, 0, 0, 0, 0 },
+	{ TW_RESTORE_AVG_IMG_RATE, 0, 0, 0, 0 },
+	{ TW_RESTORE_AVG_FILE_RATE, 0, 0, 0, 0 },
+	{ TW_RESTORE_AVG_FILE_COMP_RATE, 0, 0, 0, 0 },
+	{ TW_MD5_AVG_RATE, 0, 0, 0, 0 },
+	{ TW_INSTALL_AVG_RATE, 0, 0, 0, 0 },
+};
+
+static const char* Stage_Names[twrpProgress::STAGE_TYPE_COUNT] = {
+	"image backup", "file backup", "compressed file backup",
+	"image restore", "file restore", "compressed file restore",
+	"MD5", "install"
+};
+
+static pthread_mutex_t Progress_Lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t Progress_Thread;
+static volatile bool Progress_Running = false;
+static unsigned long long Pending[twrpProgress::STAGE_TYPE_COUNT];
+static int Cur_Type = -1;
+static unsigned long long Cur_Bytes, Last_Fed;
+static double Op_Start, Cur_Start, Last_Sample;
+static float Last_Progress;
+// Time based advance requested by Animate_Fraction, like the updater's
+// show_progress; reported progress can still move ahead of it
+static float Anim_Start, Anim_Portion;
+static double Anim_Began, Anim_Seconds;
+
+static double Progress_Now(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1000000000.0;
+}
+
+static void Finish_Stage_Locked(void) {
+	if (Cur_Type < 0)
+		return;
+
+	// A finished stage has done all of its bytes, which also covers
+	// stages that never report progress along the way (dd, dump_image)
+	double elapsed = Progress_Now() - Cur_Start;
+	if (elapsed >= PROGRESS_MIN_STAGE_TIME && Cur_Bytes > 1) {
+		double measured = Cur_Bytes / elapsed;
+		Rates[Cur_Type].Rate = (Rates[Cur_Type].Rate + measured) / 2;
+		Rates[Cur_Type].Bytes += Cur_Bytes;
+		Rates[Cur_Type].Seconds += elapsed;
+		LOGINFO("%s: %llu bytes in %.1f seconds (%llu bytes/sec)\n", Stage_Names[Cur_Type], Cur_Bytes, elapsed, (unsigned long long)measured);
+	}
+	Cur_Type = -1;
+	Anim_Seconds = 0;
+}
+
+static void Update_Progress(void) {
+	char eta_text[32];
+	double now, eta = 0, elapsed;
+	float progress;
+	int i;
+
+	pthread_mutex_lock(&Progress_Lock);
+	now = Progress_Now();
+	if (Cur_Type >= 0) {
+		if (Anim_Seconds > 0) {
+			double step = (now - Anim_Began) / Anim_Seconds;
+			unsigned long long target = (unsigned long long)((Anim_Start + Anim_Portion * (step < 1 ? step : 1)) * Cur_Bytes);
+
+			if (Shared->Bytes < target)
+				Shared->Bytes = target;
+		}
+		unsigned long long fed = Shared->Bytes;
+		double done = fed;
+
+		// tarList reports a file only once it is archived, so a sample
+		// spans all the time since bytes last arrived, stalls included
+		if (fed > Last_Fed && now > Last_Sample) {
+			double sample = (fed - Last_Fed) / (now - Last_Sample);
+			Rates[Cur_Type].Rate = Rates[Cur_Type].Rate * (1 - PROGRESS_ALPHA) + sample * PROGRESS_ALPHA;
+			Last_Fed = fed;
+			Last_Sample = now;
+		}
+		// Nothing has reported progress for this stage, go by time
+		if (fed == 0)
+			done = Rates[Cur_Type].Rate * (now - Cur_Start);
+		if (done > Cur_Bytes * 0.99)
+			done = Cur_Bytes * 0.99;
+		eta += (Cur_Bytes - done) / Rates[Cur_Type].Rate;
+	}
+	for (i = 0; i < twrpProgress::STAGE_TYPE_COUNT; i++)
+		eta += Pending[i] / Rates[i].Rate;
+
+	// Filling the bar by time keeps its pace consistent with the estimate
+	elapsed = now - Op_Start;
+	progress = (elapsed + eta > 0) ? elapsed / (elapsed + eta) : 0;
+	if (progress > Last_Progress) {
+		Last_Progress = progress;
+		DataManager::SetProgress(progress);
+	}
+	pthread_mutex_unlock(&Progress_Lock);
+
+	snprintf(eta_text, sizeof(eta_text), "%d:%02d", (int)eta / 60, (int)eta % 60);
+	DataManager::SetValue(TW_OPERATION_ETA, (int)eta);
+	DataManager::SetValue(TW_OPERATION_ETA_TEXT, eta_text);
+}
+
+static void* Progress_Thread_Fn(void* cookie) {
+	while (Progress_Running) {
+		usleep(PROGRESS_INTERVAL_US);
+		if (Progress_Running)
+			Update_Progress();
+	}
+	return NULL;
+}
+
+void twrpProgress::Start(void) {
+	int i;
+
+	if (Progress_Running)
+		Stop(false);
+	if (Shared == NULL) {
+		void* map = mmap(NULL, sizeof(Progress_Shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (map == MAP_FAILED) {
+			LOGINFO("Unable to map progress counter, progress will be estimated.\n");
+			return;
+		}
+		Shared = (Progress_Shared*)map;
+	}
+
+	pthread_mutex_lock(&Progress_Lock);
+	for (i = 0; i < STAGE_TYPE_COUNT; i++) {
+		unsigned long long rate = 0;
+
+		DataManager::GetValue(Rates[i].Var, rate);
+		Rates[i].Rate = (rate > 0) ? rate : 1;
+		Rates[i].Stored = rate;
+		Rates[i].Bytes = Rates[i].Seconds = 0;
+		Pending[i] = 0;
+	}
+	Cur_Type = -1;
+	Shared->Bytes = 0;
+	Op_Start = Progress_Now();
+	Last_Progress = 0;
+	Progress_Running = true;
+	pthread_mutex_unlock(&Progress_Lock);
+
+	DataManager::SetProgress(0);
+	if (pthread_create(&Progress_Thread, NULL, Progress_Thread_Fn, NULL) != 0) {
+		LOGINFO("Unable to start progress thread.\n");
+		Progress_Running = false;
+	}
+}
+
+void twrpProgress::Stop(bool Success) {
+	int i;
+
+	if (!Progress_Running)
+		return;
+	pthread_mutex_lock(&Progress_Lock);
+	Finish_Stage_Locked();
+	Progress_Running = false;
+	pthread_mutex_unlock(&Progress_Lock);
+	pthread_join(Progress_Thread, NULL);
+
+	if (Success) {
+		// Save the throughput measured over whole stages, weighted 1:4
+		// against the saved value so one odd operation can't skew it
+		for (i = 0; i < STAGE_TYPE_COUNT; i++) {
+			if (Rates[i].Seconds > 0) {
+				unsigned long long measured = (unsigned long long)(Rates[i].Bytes / Rates[i].Seconds);
+
+				if (Rates[i].Stored > 0)
+					measured = (measured + Rates[i].Stored * 4) / 5;
+				DataManager::SetValue(Rates[i].Var, measured);
+			}
+		}
+		DataManager::SetProgress(1.0);
+	}
+	DataManager::SetValue(TW_OPERATION_ETA, 0);
+	DataManager::SetValue(TW_OPERATION_ETA_TEXT, "");
+}
+
+void twrpProgress::Plan(Stage_Type Type, unsigned long long Bytes) {
+	pthread_mutex_lock(&Progress_Lock);
+	Pending[Type] += Bytes;
+	pthread_mutex_unlock(&Progress_Lock);
+}
+
+void twrpProgress::Begin_Stage(Stage_Type Type, unsigned long long Bytes) {
+	if (!Progress_Running)
+		return;
+	pthread_mutex_lock(&Progress_Lock);
+	Finish_Stage_Locked();
+	if (Pending[Type] > Bytes)
+		Pending[Type] -= Bytes;
+	else
+		Pending[Type] = 0;
+	Cur_Type = Type;
+	Cur_Bytes = (Bytes > 0) ? Bytes : 1;
+	Cur_Start = Last_Sample = Progress_Now();
+	Last_Fed = 0;
+	Shared->Bytes = 0;
+	pthread_mutex_unlock(&Progress_Lock);
+}
+
+void twrpProgress::End_Stage(void) {
+	pthread_mutex_lock(&Progress_Lock);
+	Finish_Stage_Locked();
+	pthread_mutex_unlock(&Progress_Lock);
+}
+
+void twrpProgress::Set_Fraction(float Fraction) {
+	pthread_mutex_lock(&Progress_Lock);
+	if (Shared != NULL && Cur_Type >= 0 && Fraction >= 0)
+		Shared->Bytes = (unsigned long long)(Fraction * Cur_Bytes);
+	pthread_mutex_unlock(&Progress_Lock);
+}
+
+void twrpProgress::Animate_Fraction(float Start, float Portion, int Seconds) {
+	pthread_mutex_lock(&Progress_Lock);
+	if (Shared != NULL && Cur_Type >= 0) {
+		if (Start >= 0)
+			Shared->Bytes = (unsigned long long)(Start * Cur_Bytes);
+		Anim_Start = Start;
+		Anim_Portion = Portion;
+		Anim_Began = Progress_Now();
+		Anim_Seconds = Seconds;
+	}
+	pthread_mutex_unlock(&Progress_Lock);
+}
+
+unsigned long long twrpProgress::Archive_Size(string Full_FileName) {
+	char split_filename[512];
+	unsigned long long total = 0;
+	struct stat st;
+
+	if (stat(Full_FileName.c_str(), &st) == 0)
+		return st.st_size;
+	for (int index = 0; index < 1000; index++) {
+		sprintf(split_filename, "%s%03i", Full_FileName.c_str(), index);
+		if (stat(split_filename, &st) != 0)
+			break;
+		total += st.st_size;
+	}
+	return total;
+}
+
+unsigned long long twrpProgress::Restore_Data_Size(string Full_FileName) {
+	unsigned long long size = Archive_Size(Full_FileName);
+	string First_File = Full_FileName;
+	int ratio;
+
+	if (!TWFunc::Path_Exists(First_File))
+		First_File += "000";
+	// Compressed archives expand by the ratio seen in earlier backups
+	if (TWFunc::Get_File_Type(First_File) == 1) {
+		DataManager::GetValue(TW_BACKUP_AVG_COMP_RATIO, ratio);
+		if (ratio > 0 && ratio < 100)
+			size = size * 100 / ratio;
+	}
+	return size;
+}
+
+void twrpProgress::Record_Compression(unsigned long long Archive_Bytes, unsigned long long Data_Bytes) {
+	int ratio, prev_ratio;
+
+	if (Data_Bytes == 0 || Archive_Bytes == 0)
+		return;
+	ratio = (int)(Archive_Bytes * 100 / Data_Bytes);
+	if (ratio < 1)
+		ratio = 1;
+	else if (ratio > 100)
+		ratio = 100;
+	DataManager::GetValue(TW_BACKUP_AVG_COMP_RATIO, prev_ratio);
+	ratio += (prev_ratio * 4);
+	ratio /= 5;
+	DataManager::SetValue(TW_BACKUP_AVG_COMP_RATIO, ratio);
+}
+
+#endif // ndef BUILD_TWRPTAR_MAIN
@@ -0,0 +1,72 @@
+/*
+        Copyright 2014 TeamWin
+        This file is part of TWRP/TeamWin Recovery Project.
+
+        TWRP is free software: you can redistribute it and/or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        TWRP is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with TWRP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TWRPPROGRESS_HPP
+#define TWRPPROGRESS_HPP
+
+#include <string>
+
+using namespace std;
+
+// Drives ui_progress and the remaining time estimate for backup, restore,
+// MD5 and install from the bytes actually processed.  The work of an
+// operation is planned up front per stage type; each stage type keeps its
+// own moving average throughput, seeded from (and saved back to) the
+// persisted tw_*_avg_* rates.
+//
+// Add_Bytes() may be called from any thread, and from processes forked
+// after Start(), e.g. the twrpTar children.
+class twrpProgress
+{
+public:
+	enum Stage_Type {
+		BACKUP_IMAGE = 0,
+		BACKUP_FILES,
+		BACKUP_FILES_COMPRESSED,
+		RESTORE_IMAGE,
+		RESTORE_FILES,
+		RESTORE_FILES_COMPRESSED,
+		MD5,
+		INSTALL,
+		STAGE_TYPE_COUNT
+	};
+
+	static void Start(void);                                          // Begins an operation and the progress updates
+	static void Stop(bool Success);                                   // Ends the operation, saving the measured rates on success
+	static void Plan(Stage_Type Type, unsigned long long Bytes);      // Adds work expected later in this operation
+	static void Begin_Stage(Stage_Type Type, unsigned long long Bytes); // Ends the current stage and starts a planned one
+	static void End_Stage(void);                                      // Marks the current stage as complete
+	static void Add_Bytes(unsigned long long Bytes);                  // Reports progress within the current stage
+	static void Set_Fraction(float Fraction);                         // Reports progress as a fraction of the current stage
+	static void Animate_Fraction(float Start, float Portion, int Seconds); // Moves the stage from Start through Portion more over Seconds
+
+	static unsigned long long Archive_Size(string Full_FileName);     // Size of a backup file, including split archives
+	static unsigned long long Restore_Data_Size(string Full_FileName); // Expected data extracted from a backup file
+	static void Record_Compression(unsigned long long Archive_Bytes, unsigned long long Data_Bytes);
+};
+
+// Starts an operation for the lifetime of the object.  Early returns end
+// it as failed; a successful operation calls twrpProgress::Stop(true).
+class twrpProgressOperation
+{
+public:
+	twrpProgressOperation() { twrpProgress::Start(); }
+	~twrpProgressOperation() { twrpProgress::Stop(false); }
+};
+
+#endif
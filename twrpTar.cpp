@@ -40,6 +40,8 @@ extern "C" {
 #include "twcommon.h"
 #include "variables.h"
 #include "twrp-functions.hpp"
+#include "twtrace.h"
+#include "twrpProgress.hpp"
 
 using namespace std;
 
@@ -78,12 +80,14 @@ void twrpTar::setpassword(string pass) {
 int twrpTar::createTarFork() {
 	int status = 0;
 	pid_t pid, rc_pid;
+	TWTRACE_SCOPE("twrpTar::createTarFork");
 	if ((pid = fork()) == -1) {
 		LOGINFO("create tar failed to fork.\n");
 		return -1;
 	}
 	if (pid == 0) {
 		// Child process
+		TWTRACE_CHILD();
 		if (use_encryption || userdata_encryption) {
 			LOGINFO("Using encryption\n");
 			DIR* d;
@@ -271,6 +275,7 @@ int twrpTar::createTarFork() {
 				_exit(-1);
 			}
 			LOGINFO("Finished encrypted backup.\n");
+			TWTRACE_FLUSH();
 			_exit(0);
 		} else {
 			std::vector<TarListStruct> FileList;
@@ -301,6 +306,7 @@ int twrpTar::createTarFork() {
 				LOGERR("Error creating backup.\n");
 				_exit(-1);
 			}
+			TWTRACE_FLUSH();
 			_exit(0);
 		}
 	} else {
@@ -313,15 +319,19 @@ int twrpTar::createTarFork() {
 int twrpTar::extractTarFork() {
 	int status = 0;
 	pid_t pid, rc_pid;
+	TWTRACE_SCOPE("twrpTar::extractTarFork");
 
 	pid = fork();
 	if (pid >= 0) // fork was successful
 	{
 		if (pid == 0) // child process
 		{
+			TWTRACE_CHILD();
 			if (TWFunc::Path_Exists(tarfn)) {
 				LOGINFO("Single archive\n");
-				if (extract() != 0)
+				int ret = extract();
+				TWTRACE_FLUSH();
+				if (ret != 0)
 					_exit(-1);
 				else
 					_exit(0);
@@ -416,6 +426,7 @@ int twrpTar::extractTarFork() {
 					_exit(-1);
 				}
 				LOGINFO("Finished encrypted backup.\n");
+				TWTRACE_FLUSH();
 				_exit(0);
 			}
 		}
@@ -475,6 +486,7 @@ int twrpTar::Generate_TarList(string Path, std::vector<TarListStruct> *TarList,
 
 int twrpTar::extractTar() {
 	char* charRootDir = (char*) tardir.c_str();
+	TWTRACE_SCOPE("twrpTar::extractTar");
 	if (openTar() == -1)
 		return -1;
 	if (tar_extract_all(t, charRootDir) != 0) {
@@ -525,6 +537,7 @@ int twrpTar::tarList(std::vector<TarListStruct> *TarList, unsigned thread_id) {
 	string temp;
 	char actual_filename[PATH_MAX];
 	char *ptr;
+	TWTRACE_SCOPE("twrpTar::tarList");
 
 	if (split_archives) {
 		basefn = tarfn;
@@ -573,6 +586,8 @@ int twrpTar::tarList(std::vector<TarListStruct> *TarList, unsigned thread_id) {
 				LOGERR("Error adding file '%s' to '%s'\n", buf, tarfn.c_str());
 				return -1;
 			}
+			if (S_ISREG(st.st_mode))
+				twrpProgress::Add_Bytes(st.st_size);
 		}
 		i++;
 	}
@@ -831,6 +846,7 @@ int twrpTar::openTar() {
 	char* charRootDir = (char*) tardir.c_str();
 	char* charTarFile = (char*) tarfn.c_str();
 	string Password;
+	static tartype_t type = { open, close, read_tar, write };
 
 	if (Archive_Current_Type == 3) {
 		LOGINFO("Opening encrypted and compressed backup...\n");
@@ -907,7 +923,7 @@ int twrpTar::openTar() {
 				close(pipes[1]);
 				close(pipes[3]);
 				fd = pipes[2];
-				if(tar_fdopen(&t, fd, charRootDir, NULL, O_RDONLY | O_LARGEFILE, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH, TAR_GNU | TAR_STORE_SELINUX) != 0) {
+				if(tar_fdopen(&t, fd, charRootDir, &type, O_RDONLY | O_LARGEFILE, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH, TAR_GNU | TAR_STORE_SELINUX) != 0) {
 					close(fd);
 					LOGERR("tar_fdopen failed\n");
 					return -1;
@@ -952,7 +968,7 @@ int twrpTar::openTar() {
 			// Parent
 			close(oaesfd[1]); // close parent output
 			fd = oaesfd[0];   // copy parent input
-			if(tar_fdopen(&t, fd, charRootDir, NULL, O_RDONLY | O_LARGEFILE, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH, TAR_GNU | TAR_STORE_SELINUX) != 0) {
+			if(tar_fdopen(&t, fd, charRootDir, &type, O_RDONLY | O_LARGEFILE, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH, TAR_GNU | TAR_STORE_SELINUX) != 0) {
 				close(fd);
 				LOGERR("tar_fdopen failed\n");
 				return -1;
@@ -994,13 +1010,13 @@ int twrpTar::openTar() {
 			// Parent
 			close(pigzfd[1]); // close parent output
 			fd = pigzfd[0];   // copy parent input
-			if(tar_fdopen(&t, fd, charRootDir, NULL, O_RDONLY | O_LARGEFILE, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH, TAR_GNU | TAR_STORE_SELINUX) != 0) {
+			if(tar_fdopen(&t, fd, charRootDir, &type, O_RDONLY | O_LARGEFILE, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH, TAR_GNU | TAR_STORE_SELINUX) != 0) {
 				close(fd);
 				LOGERR("tar_fdopen failed\n");
 				return -1;
 			}
 		}
-	} else if (tar_open(&t, charTarFile, NULL, O_RDONLY | O_LARGEFILE, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH, TAR_GNU | TAR_STORE_SELINUX) != 0) {
+	} else if (tar_open(&t, charTarFile, &type, O_RDONLY | O_LARGEFILE, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH, TAR_GNU | TAR_STORE_SELINUX) != 0) {
 		LOGERR("Unable to open tar archive '%s'\n", charTarFile);
 		return -1;
 	}
@@ -1109,3 +1125,11 @@ int twrpTar::entryExists(string entry) {
 extern "C" ssize_t write_tar(int fd, const void *buffer, size_t size) {
 	return (ssize_t) write_libtar_buffer(fd, buffer, size);
 }
+
+// Counts the (uncompressed) tar stream as it is restored
+extern "C" ssize_t read_tar(int fd, void *buffer, size_t size) {
+	ssize_t ret = read(fd, buffer, size);
+	if (ret > 0)
+		twrpProgress::Add_Bytes(ret);
+	return ret;
+}
@@ -20,6 +20,7 @@
 #define _TWRPTAR_HEADER
 
 ssize_t write_tar(int fd, const void *buffer, size_t size);
+ssize_t read_tar(int fd, void *buffer, size_t size);
 
 #endif  // _TWRPTAR_HEADER
 
@@ -21,13 +21,21 @@
 #include "../twrpTar.hpp"
 #include "../twrpDU.hpp"
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <unistd.h>
 
 twrpDU du;
 
 void usage() {
 	printf("twrpTar <action> [options]\n\n");
 	printf("actions: -c create\n");
-	printf("         -x extract\n\n");
+	printf("         -x extract\n");
+	printf("         -b benchmark backup and restore in the -d work directory\n\n");
 	printf(" -d    target directory\n");
 	printf(" -t    output file\n");
 	printf(" -m    skip media subfolder (has data media)\n");
@@ -39,6 +47,208 @@ void usage() {
 	printf("\n\n");
 	printf("Example: twrpTar -c -d /cache -t /sdcard/test.tar\n");
 	printf("         twrpTar -x -d /cache -t /sdcard/test.tar\n");
+	printf("         twrpTar -b -d /data/local/tmp/bench\n");
+}
+
+// Benchmark mode: builds synthetic trees, backs each one up and restores
+// it with every available tar mode, and prints one JSON object per run.
+
+struct Bench_Workload {
+	const char* name;
+	int dirs;                  // directories in the tree
+	int files_per_dir;         // files in each directory
+	unsigned min_size;         // file sizes are spread over [min_size, max_size]
+	unsigned max_size;
+};
+
+static const Bench_Workload Bench_Workloads[] = {
+	{ "small-files", 64, 256, 512, 16 << 10 },
+	{ "large-files", 1, 2, 128 << 20, 128 << 20 },
+	{ "app-mix", 32, 64, 1 << 10, 4 << 20 },
+};
+
+struct Bench_Mode {
+	const char* name;
+	int use_compression;
+	int use_encryption;
+	int userdata_encryption;   // encrypts with one thread per archive
+};
+
+static const Bench_Mode Bench_Modes[] = {
+	{ "plain", 0, 0, 0 },
+	{ "compressed", 1, 0, 0 },
+#ifndef TW_EXCLUDE_ENCRYPTED_BACKUPS
+	{ "encrypted", 0, 1, 0 },
+	{ "encrypted-userdata", 0, 1, 1 },
+#endif
+};
+
+struct Bench_Sample {
+	struct timeval wall;
+	struct rusage self;
+	struct rusage children;
+};
+
+static unsigned bench_seed = 1;
+
+static unsigned Bench_Random() {
+	bench_seed = bench_seed * 1103515245 + 12345;
+	return bench_seed >> 8;
+}
+
+// Half random bytes, half repeated text, so compression has something to do
+static bool Bench_Write_File(const string& Path, unsigned Size, char* buffer, unsigned buffer_size) {
+	FILE* fp = fopen(Path.c_str(), "wb");
+	if (fp == NULL) {
+		printf("Unable to create '%s': %s\n", Path.c_str(), strerror(errno));
+		return false;
+	}
+	while (Size > 0) {
+		unsigned len = Size < buffer_size ? Size : buffer_size;
+		for (unsigned i = 0; i < len / 2; i++)
+			buffer[i] = (char)Bench_Random();
+		for (unsigned i = len / 2; i < len; i++)
+			buffer[i] = "twrp benchmark data "[i % 20];
+		if (fwrite(buffer, 1, len, fp) != len) {
+			fclose(fp);
+			return false;
+		}
+		Size -= len;
+	}
+	fclose(fp);
+	return true;
+}
+
+static bool Bench_Create_Tree(const string& Dir, const Bench_Workload& w, unsigned long long* bytes, unsigned long* files) {
+	const unsigned buffer_size = 1 << 20;
+	char* buffer = (char*)malloc(buffer_size);
+	char name[32];
+
+	if (buffer == NULL)
+		return false;
+	bench_seed = 1;
+	*bytes = 0;
+	*files = 0;
+	mkdir(Dir.c_str(), 0755);
+	for (int d = 0; d < w.dirs; d++) {
+		sprintf(name, "/dir%03d", d);
+		string Sub = Dir + name;
+		mkdir(Sub.c_str(), 0755);
+		for (int f = 0; f < w.files_per_dir; f++) {
+			unsigned size = w.min_size;
+			if (w.max_size > w.min_size)
+				size += Bench_Random() % (w.max_size - w.min_size + 1);
+			sprintf(name, "/file%04d", f);
+			if (!Bench_Write_File(Sub + name, size, buffer, buffer_size)) {
+				free(buffer);
+				return false;
+			}
+			*bytes += size;
+			(*files)++;
+		}
+	}
+	free(buffer);
+	sync();
+	return true;
+}
+
+static void Bench_Sample_Now(Bench_Sample* s) {
+	gettimeofday(&s->wall, NULL);
+	getrusage(RUSAGE_SELF, &s->self);
+	getrusage(RUSAGE_CHILDREN, &s->children);
+}
+
+static double Bench_Seconds(const struct timeval& start, const struct timeval& stop) {
+	return (stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0;
+}
+
+// createTarFork and extractTarFork do the work in forked children, so
+// CPU time is the sum of this process and its children.  ru_maxrss for
+// children is the largest child so far, not just this run.
+static void Bench_Report(const Bench_Workload& w, const Bench_Mode& m, const char* op, bool ok,
+		unsigned long long bytes, unsigned long files, const Bench_Sample& start, const Bench_Sample& stop) {
+	double seconds = Bench_Seconds(start.wall, stop.wall);
+	double user = Bench_Seconds(start.self.ru_utime, stop.self.ru_utime) + Bench_Seconds(start.children.ru_utime, stop.children.ru_utime);
+	double sys = Bench_Seconds(start.self.ru_stime, stop.self.ru_stime) + Bench_Seconds(start.children.ru_stime, stop.children.ru_stime);
+	long max_rss = stop.self.ru_maxrss > stop.children.ru_maxrss ? stop.self.ru_maxrss : stop.children.ru_maxrss;
+	if (seconds <= 0)
+		seconds = 0.000001;
+
+	printf("{\"workload\":\"%s\",\"mode\":\"%s\",\"op\":\"%s\",\"ok\":%s,"
+		"\"bytes\":%llu,\"files\":%lu,\"seconds\":%.3f,\"mb_per_sec\":%.2f,\"files_per_sec\":%.1f,"
+		"\"cpu_user\":%.3f,\"cpu_sys\":%.3f,\"max_rss_kb\":%ld}\n",
+		w.name, m.name, op, ok ? "true" : "false",
+		bytes, files, seconds, bytes / 1048576.0 / seconds, files / seconds,
+		user, sys, max_rss);
+	fflush(stdout);
+}
+
+static int Bench_Run(const string& Work_Dir, const string& Password) {
+	string Tree = Work_Dir + "/tree";
+	string Tar_Filename = Work_Dir + "/bench.tar";
+	int failures = 0;
+
+	mkdir(Work_Dir.c_str(), 0755);
+	for (unsigned i = 0; i < sizeof(Bench_Workloads) / sizeof(Bench_Workloads[0]); i++) {
+		const Bench_Workload& w = Bench_Workloads[i];
+		for (unsigned j = 0; j < sizeof(Bench_Modes) / sizeof(Bench_Modes[0]); j++) {
+			const Bench_Mode& m = Bench_Modes[j];
+			unsigned long long bytes;
+			unsigned long files;
+			Bench_Sample start, stop;
+
+			if (m.use_compression && !TWFunc::Path_Exists("/sbin/pigz"))
+				continue;
+			if (m.use_encryption && !TWFunc::Path_Exists("/sbin/openaes"))
+				continue;
+
+			TWFunc::Exec_Cmd("rm -rf '" + Tree + "' '" + Tar_Filename + "'*");
+			if (!Bench_Create_Tree(Tree, w, &bytes, &files)) {
+				printf("Unable to create the %s tree in '%s'\n", w.name, Tree.c_str());
+				return -1;
+			}
+
+			twrpTar backup;
+			backup.setdir(Tree);
+			backup.setfn(Tar_Filename);
+			backup.setsize(bytes);
+			backup.use_compression = m.use_compression;
+#ifndef TW_EXCLUDE_ENCRYPTED_BACKUPS
+			backup.use_encryption = m.use_encryption;
+			backup.userdata_encryption = m.userdata_encryption;
+			if (m.use_encryption)
+				backup.setpassword(Password);
+#endif
+			Bench_Sample_Now(&start);
+			bool ok = backup.createTarFork() == 0;
+			sync();
+			Bench_Sample_Now(&stop);
+			Bench_Report(w, m, "backup", ok, bytes, files, start, stop);
+			if (!ok) {
+				failures++;
+				continue;
+			}
+
+			TWFunc::Exec_Cmd("rm -rf '" + Tree + "'");
+			mkdir(Tree.c_str(), 0755);
+			twrpTar restore;
+			restore.setdir(Tree);
+			restore.setfn(Tar_Filename);
+#ifndef TW_EXCLUDE_ENCRYPTED_BACKUPS
+			if (m.use_encryption)
+				restore.setpassword(Password);
+#endif
+			Bench_Sample_Now(&start);
+			ok = restore.extractTarFork() == 0;
+			sync();
+			Bench_Sample_Now(&stop);
+			Bench_Report(w, m, "restore", ok, bytes, files, start, stop);
+			if (!ok)
+				failures++;
+		}
+	}
+	TWFunc::Exec_Cmd("rm -rf '" + Tree + "' '" + Tar_Filename + "'*");
+	return failures ? -1 : 0;
 }
 
 int main(int argc, char **argv) {
@@ -60,6 +270,8 @@ int main(int argc, char **argv) {
 		action = 1; // create tar
 	else if (strcmp(argv[1], "-x") == 0)
 		action = 2; // extract tar
+	else if (strcmp(argv[1], "-b") == 0)
+		action = 3; // benchmark
 	else {
 		printf("Invalid action '%s' specified.\n", argv[1]);
 		usage();
@@ -122,6 +334,21 @@ int main(int argc, char **argv) {
 		}
 	}
 
+	if (action == 3) {
+		if (Directory.empty()) {
+			printf("Benchmark needs a work directory (-d)\n");
+			usage();
+			return -1;
+		}
+#ifndef TW_EXCLUDE_ENCRYPTED_BACKUPS
+		if (Password.empty())
+			Password = "benchmark";
+		return Bench_Run(Directory, Password);
+#else
+		return Bench_Run(Directory, "");
+#endif
+	}
+
 	tar.has_data_media = has_data_media;
 	tar.setdir(Directory);
 	tar.setfn(Tar_Filename);
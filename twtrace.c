@@ -0,0 +1,164 @@
+/*
+	Copyright 2014 TeamWin
+	This file is part of TWRP/TeamWin Recovery Project.
+
+	TWRP is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	TWRP is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with TWRP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "twtrace.h"
+#include "twcommon.h"
+
+#define TWTRACE_MAX_EVENTS 4096
+#define TWTRACE_LINE_SIZE 160
+
+struct twtrace_record {
+	const char* name;
+	long long value;
+	unsigned long long ts;
+	int tid;
+	char phase;
+};
+
+int twtrace_enabled = 0;
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct twtrace_record trace_events[TWTRACE_MAX_EVENTS];
+static unsigned trace_used = 0;
+static int trace_fd = -1;
+static char trace_path[256];
+
+unsigned long long twtrace_now(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+// The file is opened with O_APPEND so that forked children writing their
+// own events through the inherited descriptor never overwrite each other
+static void trace_flush_locked(void) {
+	char chunk[TWTRACE_LINE_SIZE * 64];
+	unsigned i, len = 0;
+	int pid = getpid();
+
+	if (trace_fd < 0) {
+		trace_used = 0;
+		return;
+	}
+	for (i = 0; i < trace_used; i++) {
+		struct twtrace_record* rec = &trace_events[i];
+		int ret;
+
+		if (rec->phase == 'C')
+			ret = snprintf(chunk + len, TWTRACE_LINE_SIZE,
+				"{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%llu,\"pid\":%i,\"tid\":%i,\"args\":{\"value\":%lld}},\n",
+				rec->name, rec->ts, pid, rec->tid, rec->value);
+		else
+			ret = snprintf(chunk + len, TWTRACE_LINE_SIZE,
+				"{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":%i,\"tid\":%i},\n",
+				rec->name, rec->phase, rec->ts, pid, rec->tid);
+		if (ret > 0 && ret < TWTRACE_LINE_SIZE)
+			len += ret;
+		if (len > sizeof(chunk) - TWTRACE_LINE_SIZE || i + 1 == trace_used) {
+			if (write(trace_fd, chunk, len) != (ssize_t)len)
+				LOGINFO("twtrace: short write to '%s'\n", trace_path);
+			len = 0;
+		}
+	}
+	trace_used = 0;
+}
+
+void twtrace_start(const char* path) {
+	pthread_mutex_lock(&trace_lock);
+	if (trace_fd >= 0)
+		close(trace_fd);
+	trace_used = 0;
+	strncpy(trace_path, path, sizeof(trace_path) - 1);
+	trace_path[sizeof(trace_path) - 1] = '\0';
+	trace_fd = open(trace_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+	if (trace_fd < 0) {
+		LOGINFO("twtrace: unable to open '%s'\n", trace_path);
+	} else {
+		// chrome://tracing accepts an array missing its closing bracket,
+		// which keeps the trailing commas and child appends simple
+		write(trace_fd, "[\n", 2);
+		twtrace_enabled = 1;
+	}
+	pthread_mutex_unlock(&trace_lock);
+}
+
+void twtrace_stop(void) {
+	pthread_mutex_lock(&trace_lock);
+	twtrace_enabled = 0;
+	trace_flush_locked();
+	if (trace_fd >= 0) {
+		fsync(trace_fd);
+		close(trace_fd);
+		trace_fd = -1;
+		LOGINFO("twtrace: wrote '%s'\n", trace_path);
+	}
+	pthread_mutex_unlock(&trace_lock);
+}
+
+void twtrace_event(char phase, const char* name, long long value) {
+	struct twtrace_record* rec;
+
+	pthread_mutex_lock(&trace_lock);
+	if (twtrace_enabled) {
+		rec = &trace_events[trace_used++];
+		rec->name = name;
+		rec->value = value;
+		rec->ts = twtrace_now();
+		rec->tid = syscall(__NR_gettid);
+		rec->phase = phase;
+		if (trace_used == TWTRACE_MAX_EVENTS)
+			trace_flush_locked();
+	}
+	pthread_mutex_unlock(&trace_lock);
+}
+
+void twtrace_flush(void) {
+	pthread_mutex_lock(&trace_lock);
+	trace_flush_locked();
+	pthread_mutex_unlock(&trace_lock);
+}
+
+void twtrace_child(void) {
+	// Another thread may have held the lock at fork time and the pending
+	// events still belong to (and will be written by) the parent
+	pthread_mutex_init(&trace_lock, NULL);
+	trace_used = 0;
+}
+
+int twtrace_operation_begin(const char* operation) {
+	char path[256];
+
+	if (twtrace_enabled || access(TWTRACE_FLAG_FILE, F_OK) != 0)
+		return 0;
+	snprintf(path, sizeof(path), "%s/twtrace-%s.json", TWTRACE_OUTPUT_DIR, operation);
+	twtrace_start(path);
+	return twtrace_enabled;
+}
+
+void twtrace_operation_end(int started) {
+	if (started)
+		twtrace_stop();
+}
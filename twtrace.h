@@ -0,0 +1,106 @@
+/*
+	Copyright 2014 TeamWin
+	This file is part of TWRP/TeamWin Recovery Project.
+
+	TWRP is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	TWRP is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with TWRP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _TWTRACE_HEADER
+#define _TWTRACE_HEADER
+
+// Lightweight tracing of backup, restore, wipe and install operations.
+// Events are buffered in memory and written as a Chrome trace
+// (chrome://tracing -> Load) once the operation finishes.
+//
+// Tracing is only switched on when TWTRACE_FLAG_FILE exists.  Everything
+// is declared weak so that libtar and minzip can be instrumented even
+// when linked into binaries without twtrace.c (updater, twrpTar); there
+// the macros reduce to a single null pointer test.
+//
+// Event names are stored by pointer and must be string literals.
+
+#define TWTRACE_FLAG_FILE "/cache/recovery/twtrace"
+#define TWTRACE_OUTPUT_DIR "/tmp"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int twtrace_enabled __attribute__((weak));
+
+void twtrace_start(const char* path) __attribute__((weak));
+void twtrace_stop(void) __attribute__((weak));
+void twtrace_event(char phase, const char* name, long long value) __attribute__((weak));
+void twtrace_flush(void) __attribute__((weak));
+void twtrace_child(void) __attribute__((weak));
+int twtrace_operation_begin(const char* operation) __attribute__((weak));
+void twtrace_operation_end(int started) __attribute__((weak));
+unsigned long long twtrace_now(void) __attribute__((weak));
+
+// Time spent in a path taken once per file, summed so that an archive of
+// many thousands of files adds two counter events instead of a pair of
+// events per file.  Emitting the total also resets it.
+struct twtrace_total {
+	unsigned long long us;
+	unsigned long long count;
+};
+
+#define TWTRACE_ON() (&twtrace_enabled != 0 && twtrace_enabled)
+#define TWTRACE_BEGIN(name) do { if (TWTRACE_ON()) twtrace_event('B', (name), 0); } while (0)
+#define TWTRACE_END(name) do { if (TWTRACE_ON()) twtrace_event('E', (name), 0); } while (0)
+#define TWTRACE_COUNTER(name, value) do { if (TWTRACE_ON()) twtrace_event('C', (name), (long long)(value)); } while (0)
+// Forked children must drop the parent's pending events and flush their
+// own before calling _exit()
+#define TWTRACE_CHILD() do { if (TWTRACE_ON()) twtrace_child(); } while (0)
+#define TWTRACE_FLUSH() do { if (TWTRACE_ON()) twtrace_flush(); } while (0)
+#define TWTRACE_TOTAL_BEGIN(start) do { (start) = TWTRACE_ON() ? twtrace_now() : 0; } while (0)
+#define TWTRACE_TOTAL_END(total, start) do { if ((start) != 0) { (total).us += twtrace_now() - (start); (total).count++; } } while (0)
+#define TWTRACE_TOTAL_EMIT(total, us_name, count_name) do { \
+		if (TWTRACE_ON() && (total).count != 0) { \
+			twtrace_event('C', (us_name), (long long)(total).us); \
+			twtrace_event('C', (count_name), (long long)(total).count); \
+		} \
+		(total).us = (total).count = 0; \
+	} while (0)
+
+#ifdef __cplusplus
+}
+
+class twtrace_scope {
+public:
+	twtrace_scope(const char* name) : mName(name) { TWTRACE_BEGIN(mName); }
+	~twtrace_scope() { TWTRACE_END(mName); }
+private:
+	const char* mName;
+};
+
+// Traces a whole operation into TWTRACE_OUTPUT_DIR/twtrace-<operation>.json
+// if tracing was requested and no outer operation is already being traced
+class twtrace_operation {
+public:
+	twtrace_operation(const char* operation) {
+		mStarted = (&twtrace_operation_begin != 0) ? twtrace_operation_begin(operation) : 0;
+	}
+	~twtrace_operation() { if (mStarted) twtrace_operation_end(mStarted); }
+private:
+	int mStarted;
+};
+
+#define TWTRACE_CONCAT2(a, b) a##b
+#define TWTRACE_CONCAT(a, b) TWTRACE_CONCAT2(a, b)
+#define TWTRACE_SCOPE(name) twtrace_scope TWTRACE_CONCAT(twtrace_scope_, __LINE__)(name)
+#define TWTRACE_OPERATION(name) twtrace_operation TWTRACE_CONCAT(twtrace_operation_, __LINE__)(name)
+#endif
+
+#endif  // _TWTRACE_HEADER
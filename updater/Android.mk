@@ -6,6 +6,7 @@ BUILD_SAFESTRAP := true
 
 updater_src_files := \
 	install.c \
+	blockimg.c \
 	updater.c
 
 ifeq ($(BUILD_SAFESTRAP), true)
@@ -0,0 +1,670 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <linux/fs.h>
+
+#include "applypatch/applypatch.h"
+#include "edify/expr.h"
+#include "mincrypt/sha.h"
+#include "minzip/Zip.h"
+#include "updater.h"
+#include "blockimg.h"
+
+#define BLOCKSIZE 4096
+
+// A set of block ranges, parsed from the "<count>,<start>,<end>,..."
+// form used in transfer lists.  Each range is [pos[2i], pos[2i+1]).
+typedef struct {
+    int count;
+    int size;       // total number of blocks
+    int pos[0];
+} RangeSet;
+
+static RangeSet* parse_range(char* text) {
+    char* save;
+    char* tok = strtok_r(text, ",", &save);
+    if (tok == NULL) return NULL;
+
+    char* end;
+    long num = strtol(tok, &end, 10);
+    if (*end != '\0' || num <= 0 || num % 2 != 0 || num > 1024 * 1024) {
+        printf("bad range count \"%s\"\n", tok);
+        return NULL;
+    }
+
+    RangeSet* out = malloc(sizeof(RangeSet) + num * sizeof(int));
+    if (out == NULL) {
+        printf("failed to allocate range of %ld entries\n", num);
+        return NULL;
+    }
+    out->count = num / 2;
+    out->size = 0;
+
+    int i;
+    for (i = 0; i < num; ++i) {
+        tok = strtok_r(NULL, ",", &save);
+        long v = tok ? strtol(tok, &end, 10) : -1;
+        if (tok == NULL || *end != '\0' || v < 0 || v > INT_MAX) {
+            printf("bad range entry %d\n", i);
+            free(out);
+            return NULL;
+        }
+        out->pos[i] = v;
+        if (i % 2) {
+            if (out->pos[i] <= out->pos[i-1]) {
+                printf("empty range [%d,%d)\n", out->pos[i-1], out->pos[i]);
+                free(out);
+                return NULL;
+            }
+            out->size += out->pos[i] - out->pos[i-1];
+        }
+    }
+
+    return out;
+}
+
+static int seek_block(int fd, int block) {
+    off64_t offset = (off64_t)block * BLOCKSIZE;
+    if (lseek64(fd, offset, SEEK_SET) != offset) {
+        printf("seek to block %d failed: %s\n", block, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int read_all(int fd, uint8_t* data, size_t size) {
+    size_t so_far = 0;
+    while (so_far < size) {
+        ssize_t r = read(fd, data + so_far, size - so_far);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) {
+            printf("read failed: %s\n", r < 0 ? strerror(errno) : "unexpected EOF");
+            return -1;
+        }
+        so_far += r;
+    }
+    return 0;
+}
+
+static int write_all(int fd, const uint8_t* data, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t w = write(fd, data + written, size - written);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) {
+            printf("write failed: %s\n", w < 0 ? strerror(errno) : "no progress");
+            return -1;
+        }
+        written += w;
+    }
+    return 0;
+}
+
+// Grow *buffer to hold at least size bytes.
+static int allocate(size_t size, uint8_t** buffer, size_t* buffer_alloc) {
+    if (size <= *buffer_alloc) return 0;
+
+    free(*buffer);
+    *buffer = malloc(size);
+    if (*buffer == NULL) {
+        printf("failed to allocate %zu bytes\n", size);
+        *buffer_alloc = 0;
+        return -1;
+    }
+    *buffer_alloc = size;
+    return 0;
+}
+
+// Read all the blocks of src, in order, into buffer.
+static int read_ranges(int fd, const RangeSet* src, uint8_t* buffer) {
+    size_t p = 0;
+    int i;
+    for (i = 0; i < src->count; ++i) {
+        size_t sz = (size_t)(src->pos[i*2+1] - src->pos[i*2]) * BLOCKSIZE;
+        if (seek_block(fd, src->pos[i*2]) < 0 || read_all(fd, buffer + p, sz) < 0)
+            return -1;
+        p += sz;
+    }
+    return 0;
+}
+
+// Writes data into the blocks of a RangeSet in order, seeking to the
+// start of each range as it is reached.  Used as the sink for new data
+// and patch output, so neither has to be held in memory as a whole.
+typedef struct {
+    int fd;
+    const RangeSet* tgt;
+    int p_block;        // index of the range being written
+    size_t p_remain;    // bytes left in that range
+    bool failed;
+} RangeSinkState;
+
+static void range_sink_init(RangeSinkState* rss, int fd, const RangeSet* tgt) {
+    rss->fd = fd;
+    rss->tgt = tgt;
+    rss->p_block = 0;
+    rss->p_remain = (size_t)(tgt->pos[1] - tgt->pos[0]) * BLOCKSIZE;
+    rss->failed = seek_block(fd, tgt->pos[0]) < 0;
+}
+
+static bool range_sink_done(const RangeSinkState* rss) {
+    return rss->failed || rss->p_block >= rss->tgt->count;
+}
+
+static ssize_t RangeSinkWrite(unsigned char* data, ssize_t size, void* token) {
+    RangeSinkState* rss = (RangeSinkState*) token;
+    ssize_t written = 0;
+
+    while (size > 0 && !range_sink_done(rss)) {
+        size_t chunk = size < (ssize_t)rss->p_remain ? (size_t)size : rss->p_remain;
+        if (write_all(rss->fd, data, chunk) < 0) {
+            rss->failed = true;
+            break;
+        }
+        data += chunk;
+        size -= chunk;
+        written += chunk;
+        rss->p_remain -= chunk;
+
+        if (rss->p_remain == 0) {
+            // move to the next range
+            ++rss->p_block;
+            if (rss->p_block < rss->tgt->count) {
+                int start = rss->tgt->pos[rss->p_block*2];
+                rss->p_remain = (size_t)(rss->tgt->pos[rss->p_block*2+1] - start) * BLOCKSIZE;
+                if (seek_block(rss->fd, start) < 0)
+                    rss->failed = true;
+            }
+        }
+    }
+
+    return written;
+}
+
+// The "new" data is one long stream in the package, consumed piecewise
+// by the "new" commands in transfer list order.  A background thread
+// inflates it; each "new" command hands it a RangeSinkState and waits
+// until that range has been filled.
+typedef struct {
+    ZipArchive* za;
+    const ZipEntry* entry;
+
+    RangeSinkState* rss;
+    bool finished;      // no more data will be delivered
+    bool abort;         // the transfer list failed; stop inflating
+
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+} NewThreadInfo;
+
+static bool receive_new_data(const unsigned char* data, int size, void* cookie) {
+    NewThreadInfo* nti = (NewThreadInfo*) cookie;
+
+    while (size > 0) {
+        pthread_mutex_lock(&nti->mu);
+        while (nti->rss == NULL && !nti->abort) {
+            pthread_cond_wait(&nti->cv, &nti->mu);
+        }
+        if (nti->abort) {
+            pthread_mutex_unlock(&nti->mu);
+            return false;
+        }
+
+        ssize_t written = RangeSinkWrite((unsigned char*) data, size, nti->rss);
+        data += written;
+        size -= written;
+
+        if (range_sink_done(nti->rss)) {
+            // hand the range back to the main thread
+            bool failed = nti->rss->failed;
+            nti->rss = NULL;
+            pthread_cond_broadcast(&nti->cv);
+            if (failed) {
+                pthread_mutex_unlock(&nti->mu);
+                return false;
+            }
+        }
+        pthread_mutex_unlock(&nti->mu);
+    }
+    return true;
+}
+
+static void* unzip_new_data(void* cookie) {
+    NewThreadInfo* nti = (NewThreadInfo*) cookie;
+    mzProcessZipEntryContents(nti->za, nti->entry, receive_new_data, nti);
+
+    pthread_mutex_lock(&nti->mu);
+    nti->finished = true;
+    pthread_cond_broadcast(&nti->cv);
+    pthread_mutex_unlock(&nti->mu);
+    return NULL;
+}
+
+static char* print_sha1(const uint8_t* digest) {
+    char* buffer = malloc(SHA_DIGEST_SIZE*2 + 1);
+    const char* alphabet = "0123456789abcdef";
+    int i;
+    for (i = 0; i < SHA_DIGEST_SIZE; ++i) {
+        buffer[i*2] = alphabet[(digest[i] >> 4) & 0xf];
+        buffer[i*2+1] = alphabet[digest[i] & 0xf];
+    }
+    buffer[i*2] = '\0';
+    return buffer;
+}
+
+// block_image_update(block_device, transfer_list, new_data, patch_data)
+//
+//    Applies a transfer list to block_device.  transfer_list is the
+//    contents of the list (eg, from package_extract_file), new_data and
+//    patch_data name entries in the package.  patch_data must be stored
+//    uncompressed; patches are used in place from the mapped package.
+//
+//    The transfer list is:
+//
+//      1                       version
+//      <total blocks>          blocks written, for progress
+//      <command> <args...>     one per line
+//
+//    with the commands
+//
+//      erase <rangeset>        discard the blocks
+//      zero <rangeset>         fill the blocks with zeros
+//      new <rangeset>          fill the blocks from the next part of new_data
+//      move <src> <tgt>        copy the src blocks to the tgt blocks
+//      bsdiff <offset> <len> <src> <tgt>
+//      imgdiff <offset> <len> <src> <tgt>
+//                              patch the src blocks into the tgt blocks,
+//                              using patch_data[offset, offset+len)
+//
+//    Commands run strictly in order; the list is generated so that no
+//    command reads blocks an earlier one has already overwritten.
+Value* BlockImageUpdateFn(const char* name, State* state, int argc, Expr* argv[]) {
+    Value* blockdev_filename;
+    Value* transfer_list_value;
+    Value* new_data_fn;
+    Value* patch_data_fn;
+    bool success = false;
+
+    if (argc != 4) {
+        return ErrorAbort(state, "%s() expects 4 args, got %d", name, argc);
+    }
+    if (ReadValueArgs(state, argv, 4, &blockdev_filename, &transfer_list_value,
+                      &new_data_fn, &patch_data_fn) < 0) {
+        return NULL;
+    }
+
+    UpdaterInfo* ui = (UpdaterInfo*)(state->cookie);
+    FILE* cmd_pipe = ui->cmd_pipe;
+    ZipArchive* za = ui->package_zip;
+
+    char* transfer_list = NULL;
+    uint8_t* buffer = NULL;
+    size_t buffer_alloc = 0;
+    int fd = -1;
+    bool thread_started = false;
+    pthread_t new_data_thread;
+    NewThreadInfo nti;
+
+    if (blockdev_filename->type != VAL_STRING ||
+        new_data_fn->type != VAL_STRING || patch_data_fn->type != VAL_STRING) {
+        ErrorAbort(state, "block device, new data and patch data arguments to %s must be strings", name);
+        goto done;
+    }
+    if (transfer_list_value->type != VAL_BLOB || transfer_list_value->size < 0) {
+        ErrorAbort(state, "transfer list argument to %s must be blob", name);
+        goto done;
+    }
+
+    const ZipEntry* patch_entry = mzFindZipEntry(za, patch_data_fn->data);
+    if (patch_entry == NULL) {
+        ErrorAbort(state, "%s(): no %s in package", name, patch_data_fn->data);
+        goto done;
+    }
+    if (patch_entry->compression != 0) {
+        ErrorAbort(state, "%s(): %s must be stored uncompressed", name, patch_data_fn->data);
+        goto done;
+    }
+    const uint8_t* patch_start = (const uint8_t*) za->map.addr + mzGetZipEntryOffset(patch_entry);
+    long patch_len = mzGetZipEntryUncompLen(patch_entry);
+
+    const ZipEntry* new_entry = mzFindZipEntry(za, new_data_fn->data);
+    if (new_entry == NULL) {
+        ErrorAbort(state, "%s(): no %s in package", name, new_data_fn->data);
+        goto done;
+    }
+
+    fd = open(blockdev_filename->data, O_RDWR);
+    if (fd < 0) {
+        ErrorAbort(state, "%s(): failed to open %s: %s", name,
+                   blockdev_filename->data, strerror(errno));
+        goto done;
+    }
+
+    // Start inflating the new data; it waits for the first "new" command.
+    nti.za = za;
+    nti.entry = new_entry;
+    nti.rss = NULL;
+    nti.finished = false;
+    nti.abort = false;
+    pthread_mutex_init(&nti.mu, NULL);
+    pthread_cond_init(&nti.cv, NULL);
+    if (pthread_create(&new_data_thread, NULL, unzip_new_data, &nti) != 0) {
+        ErrorAbort(state, "%s(): failed to start new data thread", name);
+        goto done;
+    }
+    thread_started = true;
+
+    // Copy the transfer list so it can be tokenized in place.
+    transfer_list = malloc(transfer_list_value->size + 1);
+    if (transfer_list == NULL) {
+        ErrorAbort(state, "%s(): failed to allocate transfer list", name);
+        goto done;
+    }
+    memcpy(transfer_list, transfer_list_value->data, transfer_list_value->size);
+    transfer_list[transfer_list_value->size] = '\0';
+
+    char* line_save;
+    char* line = strtok_r(transfer_list, "\n", &line_save);
+    if (line == NULL || strcmp(line, "1") != 0) {
+        ErrorAbort(state, "%s(): unsupported transfer list version \"%s\"", name,
+                   line ? line : "");
+        goto done;
+    }
+    line = strtok_r(NULL, "\n", &line_save);
+    int total_blocks = line ? strtol(line, NULL, 10) : 0;
+    int blocks_so_far = 0;
+    int line_no = 2;
+
+    while ((line = strtok_r(NULL, "\n", &line_save)) != NULL) {
+        char* word_save;
+        char* style = strtok_r(line, " ", &word_save);
+        ++line_no;
+        if (style == NULL)
+            continue;
+
+        if (strcmp(style, "erase") == 0) {
+            char* word = strtok_r(NULL, " ", &word_save);
+            RangeSet* tgt = word ? parse_range(word) : NULL;
+            if (tgt == NULL) goto bad_line;
+
+            struct stat st;
+            if (fstat(fd, &st) == 0 && S_ISBLK(st.st_mode)) {
+                int i;
+                for (i = 0; i < tgt->count; ++i) {
+                    uint64_t blocks[2];
+                    blocks[0] = (uint64_t)tgt->pos[i*2] * BLOCKSIZE;
+                    blocks[1] = (uint64_t)(tgt->pos[i*2+1] - tgt->pos[i*2]) * BLOCKSIZE;
+                    // Discard is only a hint; devices without it keep the old data.
+                    ioctl(fd, BLKDISCARD, &blocks);
+                }
+            }
+            free(tgt);
+
+        } else if (strcmp(style, "zero") == 0) {
+            char* word = strtok_r(NULL, " ", &word_save);
+            RangeSet* tgt = word ? parse_range(word) : NULL;
+            if (tgt == NULL) goto bad_line;
+
+            if (allocate(BLOCKSIZE, &buffer, &buffer_alloc) < 0) {
+                free(tgt);
+                goto fail;
+            }
+            memset(buffer, 0, BLOCKSIZE);
+
+            int i, j;
+            for (i = 0; i < tgt->count; ++i) {
+                if (seek_block(fd, tgt->pos[i*2]) < 0) break;
+                for (j = tgt->pos[i*2]; j < tgt->pos[i*2+1]; ++j) {
+                    if (write_all(fd, buffer, BLOCKSIZE) < 0) break;
+                }
+                if (j < tgt->pos[i*2+1]) break;
+            }
+            blocks_so_far += tgt->size;
+            bool ok = (i == tgt->count);
+            free(tgt);
+            if (!ok) goto fail;
+
+        } else if (strcmp(style, "new") == 0) {
+            char* word = strtok_r(NULL, " ", &word_save);
+            RangeSet* tgt = word ? parse_range(word) : NULL;
+            if (tgt == NULL) goto bad_line;
+
+            RangeSinkState rss;
+            range_sink_init(&rss, fd, tgt);
+
+            pthread_mutex_lock(&nti.mu);
+            nti.rss = &rss;
+            pthread_cond_broadcast(&nti.cv);
+            while (nti.rss != NULL && !nti.finished) {
+                pthread_cond_wait(&nti.cv, &nti.mu);
+            }
+            bool ok = (nti.rss == NULL && !rss.failed);
+            nti.rss = NULL;
+            pthread_mutex_unlock(&nti.mu);
+
+            blocks_so_far += tgt->size;
+            free(tgt);
+            if (!ok) {
+                printf("ran out of new data or failed to write it\n");
+                goto fail;
+            }
+
+        } else if (strcmp(style, "move") == 0) {
+            char* word = strtok_r(NULL, " ", &word_save);
+            RangeSet* src = word ? parse_range(word) : NULL;
+            word = strtok_r(NULL, " ", &word_save);
+            RangeSet* tgt = word ? parse_range(word) : NULL;
+            if (src == NULL || tgt == NULL || src->size != tgt->size) {
+                free(src);
+                free(tgt);
+                goto bad_line;
+            }
+
+            bool ok = allocate((size_t)src->size * BLOCKSIZE, &buffer, &buffer_alloc) == 0 &&
+                      read_ranges(fd, src, buffer) == 0;
+            if (ok) {
+                RangeSinkState rss;
+                range_sink_init(&rss, fd, tgt);
+                ssize_t len = (ssize_t)tgt->size * BLOCKSIZE;
+                ok = RangeSinkWrite(buffer, len, &rss) == len && !rss.failed;
+            }
+
+            blocks_so_far += tgt->size;
+            free(src);
+            free(tgt);
+            if (!ok) goto fail;
+
+        } else if (strcmp(style, "bsdiff") == 0 || strcmp(style, "imgdiff") == 0) {
+            char* offset_str = strtok_r(NULL, " ", &word_save);
+            char* len_str = strtok_r(NULL, " ", &word_save);
+            char* word = strtok_r(NULL, " ", &word_save);
+            RangeSet* src = word ? parse_range(word) : NULL;
+            word = strtok_r(NULL, " ", &word_save);
+            RangeSet* tgt = word ? parse_range(word) : NULL;
+            long offset = offset_str ? strtol(offset_str, NULL, 10) : -1;
+            long len = len_str ? strtol(len_str, NULL, 10) : -1;
+            if (src == NULL || tgt == NULL || offset < 0 || len <= 0 ||
+                offset > patch_len || len > patch_len - offset) {
+                free(src);
+                free(tgt);
+                goto bad_line;
+            }
+
+            bool ok = allocate((size_t)src->size * BLOCKSIZE, &buffer, &buffer_alloc) == 0 &&
+                      read_ranges(fd, src, buffer) == 0;
+            if (ok) {
+                Value patch_value;
+                patch_value.type = VAL_BLOB;
+                patch_value.size = len;
+                patch_value.data = (char*)(patch_start + offset);
+
+                RangeSinkState rss;
+                range_sink_init(&rss, fd, tgt);
+
+                int r;
+                if (style[0] == 'i') {
+                    r = ApplyImagePatch(buffer, (ssize_t)src->size * BLOCKSIZE, &patch_value,
+                                        RangeSinkWrite, &rss, NULL, NULL);
+                } else {
+                    r = ApplyBSDiffPatch(buffer, (ssize_t)src->size * BLOCKSIZE, &patch_value, 0,
+                                         RangeSinkWrite, &rss, NULL);
+                }
+                // The patch has to produce exactly the target blocks.
+                ok = (r == 0 && !rss.failed && rss.p_block == tgt->count);
+                if (r == 0 && !ok) {
+                    printf("%s produced %s data than its target range\n", style,
+                           rss.failed ? "unwritable" : "less");
+                }
+            }
+
+            blocks_so_far += tgt->size;
+            free(src);
+            free(tgt);
+            if (!ok) goto fail;
+
+        } else {
+            printf("unknown transfer list command \"%s\"\n", style);
+            goto bad_line;
+        }
+
+        if (total_blocks > 0) {
+            fprintf(cmd_pipe, "set_progress %.4f\n", (double)blocks_so_far / total_blocks);
+        }
+        continue;
+
+      bad_line:
+        ErrorAbort(state, "%s(): bad transfer list command at line %d", name, line_no);
+        goto done;
+      fail:
+        ErrorAbort(state, "%s(): transfer list command at line %d failed", name, line_no);
+        goto done;
+    }
+
+    if (fsync(fd) < 0) {
+        ErrorAbort(state, "%s(): fsync of %s failed: %s", name,
+                   blockdev_filename->data, strerror(errno));
+        goto done;
+    }
+    printf("wrote %d blocks; expected %d\n", blocks_so_far, total_blocks);
+    success = true;
+
+  done:
+    if (thread_started) {
+        pthread_mutex_lock(&nti.mu);
+        nti.abort = true;
+        pthread_cond_broadcast(&nti.cv);
+        pthread_mutex_unlock(&nti.mu);
+        pthread_join(new_data_thread, NULL);
+        pthread_mutex_destroy(&nti.mu);
+        pthread_cond_destroy(&nti.cv);
+    }
+    if (fd >= 0) close(fd);
+    free(buffer);
+    free(transfer_list);
+    FreeValue(blockdev_filename);
+    FreeValue(transfer_list_value);
+    FreeValue(new_data_fn);
+    FreeValue(patch_data_fn);
+    if (!success) return NULL;
+    return StringValue(strdup("t"));
+}
+
+// range_sha1(block_device, rangeset)
+//
+//    Returns the SHA-1 of the given blocks of block_device as a hex
+//    string, to check the device before or after block_image_update.
+Value* RangeSha1Fn(const char* name, State* state, int argc, Expr* argv[]) {
+    Value* blockdev_filename;
+    Value* ranges;
+    char* result = NULL;
+    RangeSet* rs = NULL;
+    uint8_t* buffer = NULL;
+    int fd = -1;
+
+    if (argc != 2) {
+        return ErrorAbort(state, "%s() expects 2 args, got %d", name, argc);
+    }
+    if (ReadValueArgs(state, argv, 2, &blockdev_filename, &ranges) < 0) {
+        return NULL;
+    }
+
+    if (blockdev_filename->type != VAL_STRING || ranges->type != VAL_STRING) {
+        ErrorAbort(state, "arguments to %s must be strings", name);
+        goto done;
+    }
+    rs = parse_range(ranges->data);
+    if (rs == NULL) {
+        ErrorAbort(state, "%s(): bad range \"%s\"", name, ranges->data);
+        goto done;
+    }
+
+    fd = open(blockdev_filename->data, O_RDONLY);
+    if (fd < 0) {
+        ErrorAbort(state, "%s(): failed to open %s: %s", name,
+                   blockdev_filename->data, strerror(errno));
+        goto done;
+    }
+
+    buffer = malloc(BLOCKSIZE);
+    if (buffer == NULL) {
+        ErrorAbort(state, "%s(): out of memory", name);
+        goto done;
+    }
+
+    SHA_CTX ctx;
+    SHA_init(&ctx);
+    int i, j;
+    for (i = 0; i < rs->count; ++i) {
+        if (seek_block(fd, rs->pos[i*2]) < 0) break;
+        for (j = rs->pos[i*2]; j < rs->pos[i*2+1]; ++j) {
+            if (read_all(fd, buffer, BLOCKSIZE) < 0) break;
+            SHA_update(&ctx, buffer, BLOCKSIZE);
+        }
+        if (j < rs->pos[i*2+1]) break;
+    }
+    if (i < rs->count) {
+        ErrorAbort(state, "%s(): failed to read %s", name, blockdev_filename->data);
+        goto done;
+    }
+    result = print_sha1(SHA_final(&ctx));
+
+  done:
+    if (fd >= 0) close(fd);
+    free(buffer);
+    free(rs);
+    FreeValue(blockdev_filename);
+    FreeValue(ranges);
+    if (result == NULL) return NULL;
+    return StringValue(result);
+}
+
+void RegisterBlockImageFunctions() {
+    RegisterFunction("block_image_update", BlockImageUpdateFn);
+    RegisterFunction("range_sha1", RangeSha1Fn);
+}
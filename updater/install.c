@@ -402,24 +402,173 @@ Value* PackageExtractDirFn(const char* name, State* state,
 }
 
 
-// package_extract_file(package_path, destination_path)
+static bool write_raw_image_cb(const unsigned char* data,
+                               int data_len, void* ctx) {
+    int r = mtd_write_data((MtdWriteContext*)ctx, (const char *)data, data_len);
+    if (r == data_len) return true;
+    printf("%s\n", strerror(errno));
+    return false;
+}
+
+// Large writes keep eMMC from doing a read-modify-write per 32k piece
+// inflated from the package.  A multiple of any erase/page size.
+#define FLASH_CHUNK_SIZE (1024*1024)
+
+// Destination for a streamed package_extract_file: either an fd
+// (regular file or block device) fed in FLASH_CHUNK_SIZE writes, or
+// an MTD partition, whose write context buffers whole erase blocks.
+typedef struct {
+    int fd;
+    MtdWriteContext* mtd;
+    unsigned char* buffer;
+    size_t used;
+    SHA_CTX sha;
+} ExtractSink;
+
+static bool extract_sink_flush(ExtractSink* sink) {
+    size_t written = 0;
+    while (written < sink->used) {
+        ssize_t w = write(sink->fd, sink->buffer + written, sink->used - written);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) {
+            printf("write failed: %s\n", strerror(errno));
+            return false;
+        }
+        written += w;
+    }
+    sink->used = 0;
+    return true;
+}
+
+static bool extract_sink_cb(const unsigned char* data, int data_len, void* ctx) {
+    ExtractSink* sink = (ExtractSink*)ctx;
+    SHA_update(&sink->sha, data, data_len);
+
+    if (sink->mtd != NULL)
+        return write_raw_image_cb(data, data_len, sink->mtd);
+
+    while (data_len > 0) {
+        size_t n = FLASH_CHUNK_SIZE - sink->used;
+        if (n > (size_t)data_len)
+            n = data_len;
+        memcpy(sink->buffer + sink->used, data, n);
+        sink->used += n;
+        data += n;
+        data_len -= n;
+        if (sink->used == FLASH_CHUNK_SIZE && !extract_sink_flush(sink))
+            return false;
+    }
+    return true;
+}
+
+// Inflate entry onto dest_path without staging it in /tmp or memory.
+// dest_path is a file, a block device, "MTD:<partition>" or
+// "EMMC:<device>".  If sha1 is non-NULL the streamed data must match it.
+static bool extract_entry_streaming(const char* name, ZipArchive* za,
+                                    const ZipEntry* entry,
+                                    const char* dest_path, const char* sha1) {
+    ExtractSink sink;
+    bool raw = false;
+    bool success = false;
+    uint8_t expected[SHA_DIGEST_SIZE];
+
+    if (sha1 != NULL && ParseSha1(sha1, expected) != 0) {
+        printf("%s: failed to parse sha1 \"%s\"\n", name, sha1);
+        return false;
+    }
+
+    sink.fd = -1;
+    sink.mtd = NULL;
+    sink.buffer = NULL;
+    sink.used = 0;
+    SHA_init(&sink.sha);
+
+    if (strncmp(dest_path, "MTD:", 4) == 0) {
+        mtd_scan_partitions();
+        const MtdPartition* mtd = mtd_find_partition_by_name(dest_path + 4);
+        if (mtd == NULL) {
+            printf("%s: no mtd partition named \"%s\"\n", name, dest_path + 4);
+            return false;
+        }
+        sink.mtd = mtd_write_partition(mtd);
+        if (sink.mtd == NULL) {
+            printf("%s: can't write mtd partition \"%s\"\n", name, dest_path + 4);
+            return false;
+        }
+    } else {
+        struct stat st;
+        if (strncmp(dest_path, "EMMC:", 5) == 0)
+            dest_path += 5;
+        raw = (stat(dest_path, &st) == 0 && S_ISBLK(st.st_mode));
+        // Block devices are written over in place; never truncate them.
+        sink.fd = open(dest_path, raw ? O_WRONLY : (O_WRONLY | O_CREAT | O_TRUNC), 0666);
+        if (sink.fd < 0) {
+            printf("%s: can't open %s for write: %s\n",
+                    name, dest_path, strerror(errno));
+            return false;
+        }
+        sink.buffer = malloc(FLASH_CHUNK_SIZE);
+        if (sink.buffer == NULL) {
+            printf("%s: failed to allocate write buffer\n", name);
+            close(sink.fd);
+            return false;
+        }
+    }
+
+    success = mzProcessZipEntryContents(za, entry, extract_sink_cb, &sink);
+
+    if (sink.mtd != NULL) {
+        if (mtd_write_close(sink.mtd) != 0) {
+            printf("%s: error closing write of %s\n", name, dest_path);
+            success = false;
+        }
+    } else {
+        if (success)
+            success = extract_sink_flush(&sink);
+        if (success && raw && fsync(sink.fd) < 0) {
+            printf("%s: fsync of %s failed: %s\n", name, dest_path, strerror(errno));
+            success = false;
+        }
+        if (close(sink.fd) < 0)
+            success = false;
+        free(sink.buffer);
+    }
+
+    if (success && sha1 != NULL &&
+        memcmp(SHA_final(&sink.sha), expected, SHA_DIGEST_SIZE) != 0) {
+        printf("%s: %s does not match sha1 %s\n", name, dest_path, sha1);
+        success = false;
+    }
+    return success;
+}
+
+// package_extract_file(package_path, destination_path[, sha1])
 //   or
 // package_extract_file(package_path)
 //   to return the entire contents of the file as the result of this
 //   function (the char* returned is actually a FileContents*).
+//
+//   destination_path may be "MTD:<partition>" or "EMMC:<device>" (or any
+//   block device) to flash the entry straight onto a partition.  If sha1
+//   is given, the extracted data must hash to it.
 Value* PackageExtractFileFn(const char* name, State* state,
                            int argc, Expr* argv[]) {
-    if (argc != 1 && argc != 2) {
-        return ErrorAbort(state, "%s() expects 1 or 2 args, got %d",
+    if (argc < 1 || argc > 3) {
+        return ErrorAbort(state, "%s() expects 1, 2 or 3 args, got %d",
                           name, argc);
     }
     bool success = false;
-    if (argc == 2) {
+    if (argc >= 2) {
         // The two-argument version extracts to a file.
 
         char* zip_path;
         char* dest_path;
-        if (ReadArgs(state, argv, 2, &zip_path, &dest_path) < 0) return NULL;
+        char* sha1 = NULL;
+        if (argc == 3) {
+            if (ReadArgs(state, argv, 3, &zip_path, &dest_path, &sha1) < 0) return NULL;
+        } else {
+            if (ReadArgs(state, argv, 2, &zip_path, &dest_path) < 0) return NULL;
+        }
 
         ZipArchive* za = ((UpdaterInfo*)(state->cookie))->package_zip;
         const ZipEntry* entry = mzFindZipEntry(za, zip_path);
@@ -428,18 +577,12 @@ Value* PackageExtractFileFn(const char* name, State* state,
             goto done2;
         }
 
-        FILE* f = fopen(dest_path, "wb");
-        if (f == NULL) {
-            printf("%s: can't open %s for write: %s\n",
-                    name, dest_path, strerror(errno));
-            goto done2;
-        }
-        success = mzExtractZipEntryToFile(za, entry, fileno(f));
-        fclose(f);
+        success = extract_entry_streaming(name, za, entry, dest_path, sha1);
 
       done2:
         free(zip_path);
         free(dest_path);
+        free(sha1);
         return StringValue(strdup(success ? "t" : ""));
     } else {
         // The one-argument version returns the contents of the file
@@ -1008,14 +1151,6 @@ Value* FileGetPropFn(const char* name, State* state, int argc, Expr* argv[]) {
 }
 
 
-static bool write_raw_image_cb(const unsigned char* data,
-                               int data_len, void* ctx) {
-    int r = mtd_write_data((MtdWriteContext*)ctx, (const char *)data, data_len);
-    if (r == data_len) return true;
-    printf("%s\n", strerror(errno));
-    return false;
-}
-
 // write_raw_image(filename_or_blob, partition)
 Value* WriteRawImageFn(const char* name, State* state, int argc, Expr* argv[]) {
     char* result = NULL;
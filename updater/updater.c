@@ -22,6 +22,7 @@
 #include "edify/expr.h"
 #include "updater.h"
 #include "install.h"
+#include "blockimg.h"
 #include "minzip/Zip.h"
 #ifdef BUILD_SAFESTRAP
 #include "safestrap-functions.h"
@@ -121,6 +122,7 @@ int main(int argc, char** argv) {
 
     RegisterBuiltins();
     RegisterInstallFunctions();
+    RegisterBlockImageFunctions();
 #ifndef BUILD_SAFESTRAP
     RegisterDeviceExtensions();
 #endif
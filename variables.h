@@ -48,6 +48,7 @@
 #define TW_BACKUP_AVG_IMG_RATE      "tw_backup_avg_img_rate"
 #define TW_BACKUP_AVG_FILE_RATE     "tw_backup_avg_file_rate"
 #define TW_BACKUP_AVG_FILE_COMP_RATE    "tw_backup_avg_file_comp_rate"
+#define TW_BACKUP_AVG_COMP_RATIO    "tw_backup_avg_comp_ratio"
 #define TW_BACKUP_SYSTEM_SIZE       "tw_backup_system_size"
 #define TW_BACKUP_DATA_SIZE         "tw_backup_data_size"
 #define TW_BACKUP_BOOT_SIZE         "tw_backup_boot_size"
@@ -75,6 +76,10 @@
 #define TW_RESTORE_AVG_IMG_RATE     "tw_restore_avg_img_rate"
 #define TW_RESTORE_AVG_FILE_RATE    "tw_restore_avg_file_rate"
 #define TW_RESTORE_AVG_FILE_COMP_RATE    "tw_restore_avg_file_comp_rate"
+#define TW_MD5_AVG_RATE             "tw_md5_avg_rate"
+#define TW_INSTALL_AVG_RATE         "tw_install_avg_rate"
+#define TW_OPERATION_ETA            "tw_operation_eta"
+#define TW_OPERATION_ETA_TEXT       "tw_operation_eta_text"
 #define TW_RESTORE_FILE_DATE        "tw_restore_file_date"
 #define TW_VERIFY_MD5_TEXT          "tw_verify_md5_text"
 #define TW_UPDATE_SYSTEM_DETAILS_TEXT "tw_update_system_details_text"